@@ -0,0 +1,298 @@
+/*
+ * mpUtils
+ * main.cpp
+ *
+ * @author: Hendrik Schwanekamp
+ * @mail: hendrik.schwanekamp@gmx.net
+ *
+ * mpUtils = my personal Utillities
+ * A utility library for my personal c++ projects
+ *
+ * Copyright 2021 Hendrik Schwanekamp
+ *
+ */
+
+/*
+ * Stress tests the concurrent queues and synchronization primitives and compares them
+ * to their mutex based counterparts. Every benchmark checks its result and reports an error if it is wrong.
+ */
+
+#include <mpUtils/mpUtils.h>
+#include <queue>
+
+using namespace mpu;
+using namespace mpu::concurrent;
+using namespace std;
+
+// a std::queue protected by a mutex, to compare the lock free queues against
+template <typename T>
+class MutexQueue
+{
+public:
+    bool tryPush(T v)
+    {
+        std::lock_guard<std::mutex> lck(m_mtx);
+        m_queue.push(std::move(v));
+        return true;
+    }
+    bool tryPop(T& out)
+    {
+        std::lock_guard<std::mutex> lck(m_mtx);
+        if(m_queue.empty())
+            return false;
+        out = std::move(m_queue.front());
+        m_queue.pop();
+        return true;
+    }
+private:
+    std::mutex m_mtx;
+    std::queue<T> m_queue;
+};
+
+// runs f in numThreads threads with the thread index as argument and returns the time in ms
+template <typename F>
+double runThreads(int numThreads, F f)
+{
+    std::vector<std::thread> threads;
+    Latch start(1);
+    for(int t = 0; t < numThreads; t++)
+        threads.emplace_back([&, t](){ start.wait(); f(t); });
+    SimpleStopwatch sw;
+    start.countDown();
+    for(auto& t : threads)
+        t.join();
+    return sw.getSeconds() * 1000.0;
+}
+
+// producers push the numbers 1..n, consumers pop and sum them up, returns time in ms
+template <typename Queue>
+double queueBenchmark(Queue& queue, int producers, int consumers, uint64_t n)
+{
+    std::atomic<uint64_t> sum{0};
+    std::atomic<uint64_t> popped{0};
+    const uint64_t total = n * producers;
+
+    double ms = runThreads(producers + consumers, [&](int t)
+    {
+        if(t < producers)
+        {
+            for(uint64_t i = 1; i <= n; i++)
+                while(!queue.tryPush(i))
+                    std::this_thread::yield();
+        } else
+        {
+            uint64_t localSum = 0;
+            uint64_t v;
+            while(popped.load(std::memory_order_relaxed) < total)
+            {
+                if(queue.tryPop(v))
+                {
+                    localSum += v;
+                    popped.fetch_add(1, std::memory_order_relaxed);
+                } else
+                    std::this_thread::yield();
+            }
+            sum += localSum;
+        }
+    });
+
+    if(sum != producers * (n * (n+1) / 2))
+    {
+        logERROR("Benchmark") << "Queue lost or duplicated elements! Checksum: " << sum;
+    }
+    return ms;
+}
+
+// same as above, but transferring elements in blocks
+template <typename Queue>
+double bulkQueueBenchmark(Queue& queue, uint64_t n, std::size_t blockSize)
+{
+    uint64_t sum = 0;
+    double ms = runThreads(2, [&](int t)
+    {
+        std::vector<uint64_t> block(blockSize);
+        if(t == 0)
+        {
+            uint64_t next = 1;
+            while(next <= n)
+            {
+                std::size_t count = std::min<uint64_t>(blockSize, n - next + 1);
+                for(std::size_t i = 0; i < count; i++)
+                    block[i] = next + i;
+                std::size_t pushed = queue.tryPushBulk(block.begin(), count);
+                next += pushed;
+                if(pushed == 0)
+                    std::this_thread::yield();
+            }
+        } else
+        {
+            uint64_t received = 0;
+            while(received < n)
+            {
+                std::size_t count = queue.tryPopBulk(block.begin(), blockSize);
+                for(std::size_t i = 0; i < count; i++)
+                {
+                    if(block[i] != received + i + 1)
+                    {
+                        logERROR("Benchmark") << "Bulk queue delivered elements out of order!";
+                    }
+                    sum += block[i];
+                }
+                received += count;
+                if(count == 0)
+                    std::this_thread::yield();
+            }
+        }
+    });
+
+    if(sum != n * (n+1) / 2)
+    {
+        logERROR("Benchmark") << "Bulk queue lost or duplicated elements! Checksum: " << sum;
+    }
+    return ms;
+}
+
+// every thread increments a shared counter under the lock, returns time in ms
+template <typename Lock>
+double lockBenchmark(int numThreads, uint64_t n)
+{
+    Lock lock;
+    uint64_t counter = 0;
+    double ms = runThreads(numThreads, [&](int)
+    {
+        for(uint64_t i = 0; i < n; i++)
+        {
+            std::lock_guard<Lock> lck(lock);
+            counter++;
+        }
+    });
+
+    if(counter != numThreads * n)
+    {
+        logERROR("Benchmark") << "Lock did not provide mutual exclusion! Counter: " << counter;
+    }
+    return ms;
+}
+
+int main()
+{
+    Log myLog( LogLvl::ALL, ConsoleSink());
+    myLog.printHeader("concurrentBenchmark", MPU_VERSION_STRING, MPU_VERSION_COMMIT, "");
+    const int hwThreads = std::max(2u, std::thread::hardware_concurrency());
+    logINFO("Benchmark") << "Running on " << std::thread::hardware_concurrency() << " hardware threads.";
+
+    const uint64_t n = 1000000;
+
+    // queues
+    {
+        SpscQueue<uint64_t> spsc(1024);
+        MutexQueue<uint64_t> mq;
+        double lockFree = queueBenchmark(spsc, 1, 1, n);
+        double locked = queueBenchmark(mq, 1, 1, n);
+        logINFO("Benchmark") << "1 producer 1 consumer: SpscQueue " << lockFree << "ms, mutex queue " << locked
+                             << "ms (x" << locked/lockFree << ")";
+
+        SpscQueue<uint64_t> spscBulk(1024);
+        double bulk = bulkQueueBenchmark(spscBulk, n, 64);
+        logINFO("Benchmark") << "1 producer 1 consumer, blocks of 64: SpscQueue " << bulk << "ms (x" << locked/bulk << ")";
+    }
+
+    for(int threads : {2, hwThreads})
+    {
+        int producers = threads / 2;
+        int consumers = threads - producers;
+        MpmcQueue<uint64_t> mpmc(1024);
+        MutexQueue<uint64_t> mq;
+        double lockFree = queueBenchmark(mpmc, producers, consumers, n / producers);
+        double locked = queueBenchmark(mq, producers, consumers, n / producers);
+        logINFO("Benchmark") << producers << " producers " << consumers << " consumers: MpmcQueue " << lockFree
+                             << "ms, mutex queue " << locked << "ms (x" << locked/lockFree << ")";
+    }
+
+    // locks
+    for(int threads : {1, 2, hwThreads})
+    {
+        double spin = lockBenchmark<SpinLock>(threads, n / threads);
+        double mutex = lockBenchmark<std::mutex>(threads, n / threads);
+        logINFO("Benchmark") << threads << " threads: SpinLock " << spin << "ms, std::mutex " << mutex
+                             << "ms (x" << mutex/spin << ")";
+    }
+
+    // seqlock, the reader must never see a half written value
+    {
+        struct Pair {uint64_t a; uint64_t b;};
+        SeqLock<Pair> seq(Pair{0,0});
+        std::atomic<bool> done{false};
+        uint64_t reads = 0;
+        double ms = runThreads(2, [&](int t)
+        {
+            if(t == 0)
+            {
+                for(uint64_t i = 1; i <= n; i++)
+                    seq.store(Pair{i, ~i});
+                done = true;
+            } else
+            {
+                while(!done.load(std::memory_order_relaxed))
+                {
+                    Pair p = seq.load();
+                    if(p.b != ~p.a)
+                    {
+                        logERROR("Benchmark") << "SeqLock reader saw a torn value!";
+                    }
+                    reads++;
+                }
+            }
+        });
+        logINFO("Benchmark") << "SeqLock: " << n << " writes and " << reads << " consistent reads in " << ms << "ms";
+    }
+
+    // semaphore as a ping pong between two threads
+    {
+        Semaphore ping(0), pong(0);
+        const uint64_t rounds = 100000;
+        double ms = runThreads(2, [&](int t)
+        {
+            for(uint64_t i = 0; i < rounds; i++)
+            {
+                if(t == 0) { ping.release(); pong.acquire(); }
+                else       { ping.acquire(); pong.release(); }
+            }
+        });
+        if(ping.count() != 0 || pong.count() != 0)
+        {
+            logERROR("Benchmark") << "Semaphore counts are wrong after ping pong!";
+        }
+        logINFO("Benchmark") << "Semaphore ping pong: " << ms * 1000000.0 / rounds << "ns per round trip";
+    }
+
+    // barrier, all threads must be in the same phase after each arrival
+    {
+        const int rounds = 10000;
+        Barrier barrier(hwThreads);
+        std::atomic<int> counter{0};
+        std::atomic<int> serialThreads{0};
+        double ms = runThreads(hwThreads, [&](int)
+        {
+            for(int r = 0; r < rounds; r++)
+            {
+                counter++;
+                if(barrier.arriveAndWait())
+                    serialThreads++;
+                if(counter.load() < (r+1) * hwThreads)
+                {
+                    logERROR("Benchmark") << "Barrier released a thread too early!";
+                }
+                barrier.arriveAndWait();
+            }
+        });
+        if(serialThreads != rounds || barrier.phase() != 2 * rounds)
+        {
+            logERROR("Benchmark") << "Barrier phase count is wrong!";
+        }
+        logINFO("Benchmark") << "Barrier with " << hwThreads << " threads: " << ms * 1000000.0 / (2*rounds)
+                             << "ns per phase";
+    }
+
+    return 0;
+}
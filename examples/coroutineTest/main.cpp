@@ -0,0 +1,92 @@
+/*
+ * mpUtils
+ * main.cpp
+ *
+ * @author: Hendrik Schwanekamp
+ * @mail: hendrik.schwanekamp@gmx.net
+ *
+ * mpUtils = my personal Utillities
+ * A utility library for my personal c++ projects
+ *
+ * Copyright 2021 Hendrik Schwanekamp
+ *
+ */
+
+/*
+ * Compiles the coroutine Task type with C++20 and checks the different things that can be awaited inside a task.
+ * Returns 1 if any of the checks fails.
+ */
+
+#include <mpUtils/mpUtils.h>
+
+#ifndef MPU_COROUTINES_AVAILABLE
+    #error "coroutines are not available, compile with C++20"
+#endif
+
+using namespace mpu;
+using namespace std;
+
+Task<int> square(int x)
+{
+    co_await resumeOn(globalThreadPool(), TaskPriority::background);
+    co_return x * x;
+}
+
+Task<std::size_t> readAndSleep(std::string path)
+{
+    std::string data = co_await readFileAsync(path);
+    co_await sleepFor(std::chrono::milliseconds(10));
+    int s = co_await square(3);
+    co_await runAsync([](){ return 0; });
+    co_return data.size() + s;
+}
+
+Task<bool> readMissing(std::string path)
+{
+    try
+    {
+        co_await readFileAsync(path);
+    } catch(const std::exception&)
+    {
+        co_return true;
+    }
+    co_return false;
+}
+
+int main()
+{
+    Log myLog( LogLvl::ALL, ConsoleSink());
+    myLog.printHeader("coroutineTest", MPU_VERSION_STRING, MPU_VERSION_COMMIT, "");
+    logINFO("CoroutineTest") << "Reading files " << (globalFileReader().usesIoUring() ? "with io_uring." : "with the thread pool fallback.");
+
+    bool ok = true;
+    const std::string path = MPU_LIB_RESOURCE_PATH "missingTexture.png";
+    const std::size_t expected = readFile(path).size() + 9;
+
+    std::size_t size = spawn(readAndSleep(path)).get();
+    if(size != expected)
+    {
+        logERROR("CoroutineTest") << "Task returned " << size << ", expected " << expected;
+        ok = false;
+    }
+
+    if(!spawn(readMissing(MPU_LIB_RESOURCE_PATH "doesNotExist.png")).get())
+    {
+        logERROR("CoroutineTest") << "Reading a missing file did not throw.";
+        ok = false;
+    }
+
+    // many reads in flight at the same time
+    std::vector<Future<std::size_t>> futures;
+    for(int i = 0; i < 100; i++)
+        futures.push_back(spawn(readAndSleep(path)));
+    for(auto& f : futures)
+        if(f.get() != expected)
+            ok = false;
+
+    if(ok)
+        logINFO("CoroutineTest") << "All checks passed.";
+    else
+        logERROR("CoroutineTest") << "Some checks failed.";
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,146 @@
+/*
+ * mpUtils
+ * main.cpp
+ *
+ * @author: Hendrik Schwanekamp
+ * @mail: hendrik.schwanekamp@gmx.net
+ *
+ * mpUtils = my personal Utillities
+ * A utility library for my personal c++ projects
+ *
+ * Copyright 2021 Hendrik Schwanekamp
+ *
+ */
+
+/*
+ * Compares the parallel algorithms of mpUtils to their serial counterparts from the standard library
+ */
+
+#include <mpUtils/mpUtils.h>
+#include <mpUtils/Threading/parallelAlgorithms.h>
+#include <random>
+
+using namespace mpu;
+using namespace std;
+
+// runs f a few times on a fresh copy of input and returns the fastest time in ms
+template <typename T, typename F>
+double benchmark(const std::vector<T>& input, F f, int repetitions = 5)
+{
+    double best = std::numeric_limits<double>::max();
+    for(int i = 0; i < repetitions; i++)
+    {
+        std::vector<T> data = input;
+        SimpleStopwatch sw;
+        f(data);
+        best = std::min(best, sw.getSeconds() * 1000.0);
+    }
+    return best;
+}
+
+// compares the results of the parallel algorithms to the standard library for small inputs split into many blocks
+bool checkSmallInputs()
+{
+    ThreadPool pool(4);
+    const ParallelSettings settings{Schedule::automatic, 1, &pool};
+    bool ok = true;
+    for(std::size_t n = 1; n < 40; n++)
+    {
+        std::vector<uint64_t> values(n);
+        std::iota(values.begin(), values.end(), 1);
+
+        std::vector<uint64_t> expected(n);
+        std::vector<uint64_t> result(n);
+        std::partial_sum(values.begin(), values.end(), expected.begin());
+        parallel_inclusive_scan(values.begin(), values.end(), result.begin(), std::plus<uint64_t>(), settings);
+        if(result != expected)
+        {
+            logERROR("Benchmark") << "parallel_inclusive_scan failed for " << n << " elements.";
+            ok = false;
+        }
+
+        uint64_t sum = 0;
+        for(std::size_t i = 0; i < n; i++)
+        {
+            expected[i] = sum;
+            sum += values[i];
+        }
+        parallel_exclusive_scan(values.begin(), values.end(), result.begin(), uint64_t(0), std::plus<uint64_t>(), settings);
+        if(result != expected)
+        {
+            logERROR("Benchmark") << "parallel_exclusive_scan failed for " << n << " elements.";
+            ok = false;
+        }
+
+        std::vector<uint32_t> keys(values.rbegin(), values.rend());
+        parallel_radix_sort(keys.begin(), keys.end(), settings);
+        if(!std::is_sorted(keys.begin(), keys.end()))
+        {
+            logERROR("Benchmark") << "parallel_radix_sort failed for " << n << " elements.";
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+int main()
+{
+    Log myLog( LogLvl::ALL, ConsoleSink());
+    myLog.printHeader("parallelBenchmark", MPU_VERSION_STRING, MPU_VERSION_COMMIT, "");
+    logINFO("Benchmark") << "Using " << globalThreadPool().getPoolSize() << " worker threads.";
+
+    if(!checkSmallInputs())
+        return 1;
+
+    std::mt19937 rng(42);
+    for(std::size_t n : {10000ul, 1000000ul, 10000000ul})
+    {
+        std::vector<uint32_t> keys(n);
+        for(auto& k : keys)
+            k = rng();
+        std::vector<float> floatKeys(n);
+        for(auto& k : floatKeys)
+            k = std::uniform_real_distribution<float>(-1000.0f,1000.0f)(rng);
+        std::vector<uint32_t> payload(n);
+        std::iota(payload.begin(),payload.end(),0);
+
+        logINFO("Benchmark") << "--- " << n << " elements ---";
+
+        double stdSort = benchmark(keys, [](auto& d){ std::sort(d.begin(), d.end()); });
+        double stdStableSort = benchmark(keys, [](auto& d){ std::stable_sort(d.begin(), d.end()); });
+        double radixSort = benchmark(keys, [](auto& d){ parallel_radix_sort(d.begin(), d.end()); });
+        double mergeSort = benchmark(keys, [](auto& d){ parallel_merge_sort(d.begin(), d.end()); });
+        logINFO("Benchmark") << "uint32 std::sort: " << stdSort << "ms, std::stable_sort: " << stdStableSort
+                             << "ms, parallel_radix_sort: " << radixSort << "ms (x" << stdSort/radixSort
+                             << "), parallel_merge_sort: " << mergeSort << "ms (x" << stdSort/mergeSort << ")";
+
+        stdSort = benchmark(floatKeys, [](auto& d){ std::sort(d.begin(), d.end()); });
+        radixSort = benchmark(floatKeys, [](auto& d){ parallel_radix_sort(d.begin(), d.end()); });
+        logINFO("Benchmark") << "float std::sort: " << stdSort << "ms, parallel_radix_sort: " << radixSort
+                             << "ms (x" << stdSort/radixSort << ")";
+
+        std::vector<std::pair<uint32_t,uint32_t>> pairs(n);
+        for(std::size_t i = 0; i < n; i++)
+            pairs[i] = {keys[i], payload[i]};
+        stdSort = benchmark(pairs, [](auto& d){ std::sort(d.begin(), d.end(),
+                                         [](const auto& a, const auto& b){ return a.first < b.first;}); });
+        radixSort = benchmark(keys, [&](auto& d){ std::vector<uint32_t> p = payload;
+                                                   parallel_radix_sort(d.begin(), d.end(), p.begin()); });
+        logINFO("Benchmark") << "key-value std::sort: " << stdSort << "ms, parallel_radix_sort: " << radixSort
+                             << "ms (x" << stdSort/radixSort << ")";
+
+        std::vector<uint64_t> values(keys.begin(), keys.end());
+        double stdScan = benchmark(values, [](auto& d){ std::partial_sum(d.begin(), d.end(), d.begin()); });
+        double parallelScan = benchmark(values, [](auto& d){ parallel_inclusive_scan(d.begin(), d.end(), d.begin()); });
+        logINFO("Benchmark") << "inclusive scan std::partial_sum: " << stdScan << "ms, parallel_inclusive_scan: "
+                             << parallelScan << "ms (x" << stdScan/parallelScan << ")";
+
+        auto isEven = [](uint32_t k){ return k % 2 == 0; };
+        double stdPartition = benchmark(keys, [&](auto& d){ std::stable_partition(d.begin(), d.end(), isEven); });
+        double parallelPartition = benchmark(keys, [&](auto& d){ parallel_stable_partition(d.begin(), d.end(), isEven); });
+        logINFO("Benchmark") << "std::stable_partition: " << stdPartition << "ms, parallel_stable_partition: "
+                             << parallelPartition << "ms (x" << stdPartition/parallelPartition << ")";
+    }
+
+    return 0;
+}
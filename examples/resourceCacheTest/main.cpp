@@ -0,0 +1,159 @@
+/*
+ * mpUtils
+ * main.cpp
+ *
+ * @author: Hendrik Schwanekamp
+ * @mail: hendrik.schwanekamp@gmx.net
+ *
+ * mpUtils = my personal Utillities
+ * A utility library for my personal c++ projects
+ *
+ * Copyright 2021 Hendrik Schwanekamp
+ *
+ */
+
+/*
+ * Stress tests loading resources from multiple threads while they are evicted or their preloading is cancelled.
+ * load() must always return the resource. Returns 1 if any of the checks fails.
+ */
+
+#include <mpUtils/mpUtils.h>
+#include <experimental/filesystem>
+#include <fstream>
+#include <random>
+
+using namespace mpu;
+using namespace std;
+namespace fs = std::experimental::filesystem;
+
+struct TextFile
+{
+    std::string content;
+};
+using TextCache = ResourceCache<TextFile, TextFile>;
+using TextManager = ResourceManager<TextCache>;
+
+constexpr int numFiles = 100;
+constexpr int numThreads = 6;
+constexpr int iterations = 5000;
+
+std::string fileName(int i)
+{
+    return "file" + std::to_string(i) + ".txt";
+}
+
+// size of file i, so a wrong or empty resource is detected
+std::size_t fileSize(int i)
+{
+    return 100 + std::size_t(i) * 10;
+}
+
+std::unique_ptr<TextManager> createManager(const std::string& dir)
+{
+    return std::make_unique<TextManager>(TextManager::cacheCreationData<TextFile, TextFile>{
+            // both steps take a moment, so threads have to wait for each other and the eviction tick runs in between
+            [](std::string data){ std::this_thread::sleep_for(std::chrono::microseconds(50));
+                                  return std::make_unique<TextFile>(TextFile{std::move(data)}); },
+            [](std::unique_ptr<TextFile> pd){ std::this_thread::sleep_for(std::chrono::microseconds(50)); return pd; },
+            dir, std::make_unique<TextFile>(TextFile{"default"}), "text", nullptr});
+}
+
+// all threads load and preload random files, returns the number of wrong results
+int loadWhileEvicting(const std::string& dir)
+{
+    auto manager = createManager(dir);
+    auto& rm = *manager;
+    rm.setMemoryBudget(1);
+    rm.setEvictionInterval(std::chrono::milliseconds(1));
+
+    std::atomic<int> bad{0};
+    std::vector<std::thread> threads;
+    for(int t = 0; t < numThreads; t++)
+        threads.emplace_back([&, t]()
+        {
+            std::default_random_engine rng(t);
+            std::uniform_int_distribution<int> dist(0, numFiles-1);
+            for(int n = 0; n < iterations; n++)
+            {
+                const int i = dist(rng);
+                if(n % 3 == 0)
+                    rm.preload<TextFile>(fileName(i));
+                std::shared_ptr<TextFile> r = rm.load<TextFile>(fileName(i));
+                if(!r || r->content.size() != fileSize(i))
+                    bad++;
+            }
+        });
+    for(auto& t : threads)
+        t.join();
+    rm.setEvictionInterval(std::chrono::milliseconds(0));
+    return bad;
+}
+
+// preloads are cancelled while other threads load the same files, returns the number of wrong results
+int loadWhileCancelling(const std::string& dir)
+{
+    auto manager = createManager(dir);
+    auto& rm = *manager;
+
+    std::atomic<int> bad{0};
+    std::vector<std::thread> threads;
+    for(int t = 0; t < numThreads; t++)
+        threads.emplace_back([&, t]()
+        {
+            std::default_random_engine rng(t);
+            std::uniform_int_distribution<int> dist(0, numFiles-1);
+            for(int n = 0; n < iterations; n++)
+            {
+                const int i = dist(rng);
+                if(t % 2 == 0)
+                {
+                    rm.preload<TextFile>(fileName(i));
+                    rm.cancelPreload<TextFile>(fileName(i));
+                    if(n % 2 == 0)
+                        rm.tryReleaseAll();
+                } else
+                {
+                    std::shared_ptr<TextFile> r = rm.load<TextFile>(fileName(i));
+                    if(!r || r->content.size() != fileSize(i))
+                        bad++;
+                }
+            }
+        });
+    for(auto& t : threads)
+        t.join();
+    return bad;
+}
+
+int main()
+{
+    Log myLog( LogLvl::ALL, ConsoleSink());
+    myLog.printHeader("resourceCacheTest", MPU_VERSION_STRING, MPU_VERSION_COMMIT, "");
+
+    const std::string dir = (fs::temp_directory_path() / "mpUtilsResourceCacheTest").string() + "/";
+    fs::create_directories(dir);
+    for(int i = 0; i < numFiles; i++)
+        std::ofstream(dir + fileName(i), std::ios::binary) << std::string(fileSize(i), 'a' + char(i % 26));
+
+    bool ok = true;
+    int bad = loadWhileEvicting(dir);
+    if(bad != 0)
+    {
+        logERROR("ResourceCacheTest") << "load() returned " << bad << " wrong resources while evicting.";
+        ok = false;
+    }
+
+    bad = loadWhileCancelling(dir);
+    if(bad != 0)
+    {
+        logERROR("ResourceCacheTest") << "load() returned " << bad << " wrong resources while cancelling preloads.";
+        ok = false;
+    }
+
+    fs::remove_all(dir);
+
+    if(ok)
+        logINFO("ResourceCacheTest") << "All checks passed.";
+    else
+        logERROR("ResourceCacheTest") << "Some checks failed.";
+    return ok ? 0 : 1;
+}
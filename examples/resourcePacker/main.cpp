@@ -0,0 +1,92 @@
+/*
+ * mpUtils
+ * main.cpp
+ *
+ * @author: Hendrik Schwanekamp
+ * @mail: hendrik.schwanekamp@gmx.net
+ *
+ * mpUtils = my personal Utillities
+ * A utility library for my personal c++ projects
+ *
+ * Copyright 2021 Hendrik Schwanekamp
+ *
+ */
+
+/*
+ * Packs a directory into a resource archive, that can be loaded with mpu::ResourceArchive.
+ * usage: resourcePacker <input directory> <output file> [--store | --compress] [--align <bytes>] [--list]
+ *  --store     do not compress any file
+ *  --compress  compress every file, by default files are only compressed if that makes them at least 10 % smaller
+ *  --align     alignment of the data blocks in the archive, default 16
+ *  --list      print the content of the archive after writing it
+ */
+
+#include <mpUtils/mpUtils.h>
+#include <iostream>
+
+using namespace mpu;
+using namespace std;
+
+int main(int argc, char* argv[])
+{
+    Log myLog( LogLvl::ALL, ConsoleSink());
+
+    if(argc < 3)
+    {
+        cout << "usage: " << argv[0] << " <input directory> <output file> [--store | --compress] [--align <bytes>] [--list]" << endl;
+        return 1;
+    }
+
+    string inputDir = argv[1];
+    string outputFile = argv[2];
+    ArchiveCompression compression = ArchiveCompression::automatic;
+    size_t alignment = 16;
+    bool list = false;
+
+    for(int i = 3; i < argc; ++i)
+    {
+        string arg = argv[i];
+        if(arg == "--store")
+            compression = ArchiveCompression::none;
+        else if(arg == "--compress")
+            compression = ArchiveCompression::zlib;
+        else if(arg == "--align" && i+1 < argc)
+            alignment = stoul(argv[++i]);
+        else if(arg == "--list")
+            list = true;
+        else
+        {
+            logERROR("resourcePacker") << "Unknown argument " << arg;
+            return 1;
+        }
+    }
+
+    try
+    {
+        ResourceArchiveWriter writer(alignment);
+        SimpleStopwatch sw;
+        size_t files = writer.addDirectory(inputDir, compression);
+        writer.write(outputFile);
+
+        logINFO("resourcePacker") << "Packed " << files << " files from " << inputDir << " into " << outputFile << " in "
+                                  << sw.getSeconds() << "s. " << writer.originalSize() << " bytes, "
+                                  << writer.storedSize() << " bytes stored.";
+
+        if(list)
+        {
+            ResourceArchive archive(outputFile);
+            for(size_t i = 0; i < archive.numEntries(); ++i)
+            {
+                const ArchiveEntry& e = archive.entry(i);
+                cout << archive.path(e) << "\t" << e.size << "\t" << e.storedSize
+                     << (e.isCompressed() ? "\tcompressed" : "") << "\n";
+            }
+        }
+    } catch(const std::exception& e)
+    {
+        logERROR("resourcePacker") << "Packing failed: " << e.what();
+        return 1;
+    }
+
+    return 0;
+}
@@ -37,16 +37,300 @@
 #include <stdexcept>
 #include <algorithm>
 #include <cassert>
+#include <array>
+#include <deque>
+#include <chrono>
+#include <cstdint>
+#ifdef __linux__
+    #include <pthread.h>
+    #include <time.h>
+#endif
+#include "mpUtils/Threading/UniqueTask.h"
+#include "mpUtils/Threading/CancellationToken.h"
+#include "mpUtils/Threading/cpuAffinity.h"
+#include "mpUtils/Log/Log.h"
 
 
 namespace mpu {
 
+/**
+ * @brief priority lanes of the ThreadPool, tasks in a higher lane are started first
+ */
+enum class TaskPriority
+{
+    realtime = 0,   //!< frame critical work
+    normal = 1,     //!< default priority
+    background = 2  //!< work that is not needed any time soon, eg preloading of resources
+};
+
+/**
+ * @brief snapshot of the statistics of a ThreadPool, see ThreadPool::enableStats()
+ */
+struct ThreadPoolStats
+{
+    static constexpr std::size_t numBuckets = 24;
+    static constexpr std::size_t numPriorities = 3;
+
+    /**
+     * @brief histogram of durations with logarithmic buckets
+     *      bucket 0 counts durations below 1us, bucket i counts durations in [2^(i-1), 2^i) us
+     *      and the last bucket also holds everything that is even longer
+     */
+    struct Histogram
+    {
+        std::array<uint64_t, numBuckets> buckets{}; //!< number of samples in each bucket
+        uint64_t count = 0; //!< total number of samples
+        double totalSeconds = 0; //!< sum of all samples
+
+        double mean() const {return count > 0 ? totalSeconds / double(count) : 0.0;} //!< average duration in seconds
+        double percentile(double p) const; //!< upper bound of the bucket containing the p-quantile (0-1), in seconds
+        static double bucketUpperBound(std::size_t i) {return double(uint64_t(1) << i) * 1e-6;} //!< in seconds
+    };
+
+    /**
+     * @brief statistics of a single worker thread
+     */
+    struct Worker
+    {
+        double busySeconds = 0; //!< time spent running tasks
+        double idleSeconds = 0; //!< time spent waiting for tasks
+        uint64_t tasksExecuted = 0; //!< number of tasks run by this worker
+        double utilization() const {return (busySeconds+idleSeconds) > 0 ? busySeconds / (busySeconds+idleSeconds) : 0.0;}
+    };
+
+    bool enabled = false; //!< if false, statistics are not collected and all other values are stale
+    double sampledSeconds = 0; //!< time since the statistics were enabled or reset
+    std::size_t queueDepth = 0; //!< number of tasks waiting to be started
+    std::array<std::size_t, numPriorities> queueDepthPerPriority{}; //!< waiting tasks per TaskPriority
+    std::size_t maxQueueDepth = 0; //!< highest queue depth seen
+    std::size_t tasksInFlight = 0; //!< tasks that are queued or running
+    uint64_t tasksSubmitted = 0; //!< tasks added to the queue
+    uint64_t tasksCompleted = 0; //!< tasks that finished running
+    uint64_t tasksFailed = 0; //!< tasks that threw an exception
+    uint64_t starvationPromotions = 0; //!< how often a lower priority task was started because its lane was starving
+    Histogram queueLatency; //!< time from adding a task to the queue until a worker starts it
+    Histogram runTime; //!< time a task took to run
+    std::vector<Worker> workers; //!< per worker statistics, indexed by worker number
+};
+
+inline double ThreadPoolStats::Histogram::percentile(double p) const
+{
+    if (count == 0)
+        return 0.0;
+    uint64_t target = static_cast<uint64_t>(p * double(count - 1)) + 1;
+    uint64_t seen = 0;
+    for (std::size_t i = 0; i < numBuckets; ++i)
+    {
+        seen += buckets[i];
+        if (seen >= target)
+            return bucketUpperBound(i);
+    }
+    return bucketUpperBound(numBuckets-1);
+}
+
+/**
+ * @brief settings for automatic sizing of a ThreadPool, see ThreadPool::setAutoscaling()
+ */
+struct AutoscalePolicy
+{
+    std::size_t minThreads = 1; //!< the pool never shrinks below this
+    std::size_t maxThreads = 2 * (std::max)(1u, std::thread::hardware_concurrency()); //!< the pool never grows above this
+    std::chrono::microseconds targetLatency{2000}; //!< grow when a queued task waited longer than this
+    std::chrono::milliseconds idleTimeout{2000}; //!< shrink by one thread after the pool was not fully busy for this long
+    std::chrono::milliseconds interval{20}; //!< how often the pool is evaluated
+    double blockedThreshold = 0.5; //!< running tasks using less cpu time than this fraction count as blocked (eg waiting for io)
+};
+
+namespace detail {
+
+/**
+ * @brief cpu time used by a thread in ns, -1 if not supported on this platform
+ */
+inline int64_t thread_cpu_ns(std::thread& t)
+{
+#ifdef __linux__
+    clockid_t clock;
+    timespec ts;
+    if (pthread_getcpuclockid(t.native_handle(), &clock) == 0 && clock_gettime(clock, &ts) == 0)
+        return int64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+#endif
+    (void)t;
+    return -1;
+}
+
+/**
+ * @brief the counters behind ThreadPoolStats, updated by the workers without taking a lock
+ */
+struct ThreadPoolCounters
+{
+    using clock = std::chrono::steady_clock;
+
+    struct AtomicHistogram
+    {
+        std::atomic<uint64_t> buckets[ThreadPoolStats::numBuckets];
+        std::atomic<uint64_t> total_ns;
+
+        AtomicHistogram() { reset(); }
+
+        void add(int64_t ns)
+        {
+            if (ns < 0)
+                ns = 0;
+            uint64_t us = static_cast<uint64_t>(ns) / 1000;
+            std::size_t b = 0;
+            while (us != 0 && b < ThreadPoolStats::numBuckets-1)
+            {
+                us >>= 1;
+                ++b;
+            }
+            buckets[b].fetch_add(1, std::memory_order_relaxed);
+            total_ns.fetch_add(static_cast<uint64_t>(ns), std::memory_order_relaxed);
+        }
+
+        void reset()
+        {
+            for (auto& b : buckets)
+                b.store(0, std::memory_order_relaxed);
+            total_ns.store(0, std::memory_order_relaxed);
+        }
+
+        void copy_to(ThreadPoolStats::Histogram& h) const
+        {
+            h.count = 0;
+            for (std::size_t i = 0; i < ThreadPoolStats::numBuckets; ++i)
+            {
+                h.buckets[i] = buckets[i].load(std::memory_order_relaxed);
+                h.count += h.buckets[i];
+            }
+            h.totalSeconds = double(total_ns.load(std::memory_order_relaxed)) * 1e-9;
+        }
+    };
+
+    struct WorkerCounters
+    {
+        std::atomic<uint64_t> busy_ns{0};
+        std::atomic<uint64_t> idle_ns{0};
+        std::atomic<uint64_t> tasks{0};
+    };
+
+    static int64_t now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now().time_since_epoch()).count();
+    }
+
+    // worker counters live in a deque, so growing it does not move the counters of running workers
+    // it is only accessed with the queue mutex locked
+    WorkerCounters& worker(std::size_t worker_number)
+    {
+        while (workers.size() <= worker_number)
+            workers.emplace_back();
+        return workers[worker_number];
+    }
+
+    void reset()
+    {
+        queue_latency.reset();
+        run_time.reset();
+        completed.store(0, std::memory_order_relaxed);
+        failed.store(0, std::memory_order_relaxed);
+        for (auto& w : workers)
+        {
+            w.busy_ns.store(0, std::memory_order_relaxed);
+            w.idle_ns.store(0, std::memory_order_relaxed);
+            w.tasks.store(0, std::memory_order_relaxed);
+        }
+        submitted = 0;
+        starvation_promotions = 0;
+        max_queue_depth = 0;
+        start_time = now();
+    }
+
+    AtomicHistogram queue_latency;
+    AtomicHistogram run_time;
+    std::atomic<uint64_t> completed{0};
+    std::atomic<uint64_t> failed{0};
+    std::deque<WorkerCounters> workers;
+
+    // only accessed with the queue mutex locked
+    uint64_t submitted = 0;
+    uint64_t starvation_promotions = 0;
+    std::size_t max_queue_depth = 0;
+    int64_t start_time = now();
+};
+
+/**
+ * @brief a task waiting in the queue of the ThreadPool, with the time it was added if statistics are enabled
+ */
+struct QueuedTask
+{
+    UniqueTask task;
+    int64_t enqueue_time = 0;
+};
+
+/**
+ * @brief simple fifo queue stored in a growing ring buffer
+ *      Unlike std::queue (std::deque) no memory is allocated or freed during steady state operation.
+ */
+template <typename T>
+class RingQueue
+{
+public:
+    bool empty() const { return m_size == 0; }
+    std::size_t size() const { return m_size; }
+    T& front() { return m_data[m_head]; }
+
+    void push(T&& t)
+    {
+        if(m_size == m_data.size())
+            grow();
+        m_data[(m_head + m_size) & (m_data.size()-1)] = std::move(t);
+        ++m_size;
+    }
+
+    void pop()
+    {
+        m_data[m_head] = T();
+        m_head = (m_head + 1) & (m_data.size()-1);
+        --m_size;
+    }
+
+private:
+    void grow()
+    {
+        std::vector<T> newData( (std::max)(m_data.size()*2, std::size_t(16)) );
+        for(std::size_t i = 0; i < m_size; ++i)
+            newData[i] = std::move(m_data[(m_head + i) & (m_data.size()-1)]);
+        m_data = std::move(newData);
+        m_head = 0;
+    }
+
+    std::vector<T> m_data; // size is always a power of two
+    std::size_t m_head = 0;
+    std::size_t m_size = 0;
+};
+}
+
 /**
  * @brief create a simple thread pool using the given amount of threads
  * jobs can be added using the enqueue function, which will  return the result inside a std::future
- * When max queue size is reached, enqueue will block until an element gets processed.
+ * If no result is needed use post instead. It does not create a future and small tasks are stored
+ * without any heap allocation. Exceptions thrown by posted tasks are logged and discarded.
+ * When max queue size is reached, enqueue and post will block until an element gets processed.
+ * tryPost never blocks, it returns false instead if the queue is full.
  * Number of threads can be changed using setPoolSize.
  * waitUntilEmpty waits until all jobs are executed.
+ * All functions to add tasks optionally take a TaskPriority as first argument. Tasks with a higher priority
+ * are started first. To prevent starvation, a non empty lane that was passed over more than
+ * setStarvationLimit() times in a row gets to start the next task. Without a priority, TaskPriority::normal is used.
+ * post and enqueue also accept a CancellationToken after the priority. If the token is cancelled before the task
+ * was started, the task is dropped. For enqueue the future will then hold a std::future_error (broken_promise).
+ * isWorkerThread() returns true when called from one of the workers, eg to avoid waiting for tasks of the same pool.
+ * setAffinity pins the workers to cores, worker i runs on the i-th core of the list (wrapping around).
+ * enableStats(true) starts collecting queue depth, queue latency and run time histograms and per worker busy
+ * and idle times, getStats() returns a snapshot. While disabled the only overhead is checking a flag per task.
+ * setAutoscaling() lets the pool change its size on its own: it grows while queued tasks wait longer than the target
+ * latency and shrinks after an idle period. Beyond the number of cores the pool only grows if the running tasks are
+ * blocked, which is detected by comparing the cpu time of the workers to the wall clock time.
  */
 class ThreadPool {
 public:
@@ -55,22 +339,93 @@ public:
     template<class F, class... Args>
     auto enqueue(F&& f, Args&&... args)
         -> std::future<typename std::result_of<F(Args...)>::type>;
+    template<class F, class... Args>
+    void post(F&& f, Args&&... args);
+    template<class F>
+    bool tryPost(F&& f);
+
+    template<class F, class... Args>
+    auto enqueue(TaskPriority priority, F&& f, Args&&... args)
+        -> std::future<typename std::result_of<F(Args...)>::type>;
+    template<class F>
+    auto enqueue(TaskPriority priority, CancellationToken token, F&& f)
+        -> std::future<typename std::result_of<F()>::type>;
+    template<class F, class... Args>
+    void post(TaskPriority priority, F&& f, Args&&... args);
+    template<class F>
+    void post(TaskPriority priority, CancellationToken token, F&& f);
+    template<class F>
+    bool tryPost(TaskPriority priority, F&& f);
+
     void waitUntilEmpty();
     void waitUntilNothingInFlight();
     void setQueueSizeLimit(std::size_t limit);
     void setPoolSize(std::size_t limit);
     std::size_t getPoolSize() const;
+    bool isWorkerThread() const;
+    void setStarvationLimit(std::size_t limit);
+    void setAffinity(std::vector<int> cores);
+    void setAffinity(AffinityPolicy policy, const std::vector<int>& cores = availableCores());
+    void enableStats(bool enable);
+    bool statsEnabled() const;
+    ThreadPoolStats getStats();
+    void resetStats();
+    void setAutoscaling(const AutoscalePolicy& policy);
+    void disableAutoscaling();
+    bool autoscalingEnabled();
     ~ThreadPool();
 
 private:
     void emplace_back_worker (std::size_t worker_number);
+    void push_task(UniqueTask task, TaskPriority priority);
+    detail::QueuedTask pop_next_task();
+    void push_locked(UniqueTask&& task, TaskPriority priority);
+    void resize_locked(std::size_t size);
+    void autoscale_loop();
+    void autoscale_step();
+
+    // the pool the calling thread is a worker of, nullptr for threads not owned by a pool
+    static const ThreadPool*& current_pool()
+    {
+        static thread_local const ThreadPool* pool = nullptr;
+        return pool;
+    }
+
+    template<class F>
+    static F&& make_task(F&& f) { return std::forward<F>(f); }
+    template<class F, class FirstArg, class... Args>
+    static auto make_task(F&& f, FirstArg&& first, Args&&... args)
+    {
+        return std::bind(std::forward<F>(f), std::forward<FirstArg>(first), std::forward<Args>(args)...);
+    }
 
     // need to keep track of threads so we can join them
     std::vector< std::thread > workers;
     // target pool size
     std::size_t pool_size;
-    // the task queue
-    std::queue< std::function<void()> > tasks;
+    // the task queues, one per priority
+    static constexpr std::size_t num_lanes = 3;
+    detail::RingQueue< detail::QueuedTask > tasks[num_lanes];
+    // total number of queued tasks
+    std::size_t num_tasks = 0;
+    // how often a non empty lane was passed over
+    std::size_t skipped[num_lanes] = {0, 0, 0};
+    // how often a lane can be passed over before it is served
+    std::size_t starvation_limit = 16;
+    // cores the workers are pinned to, empty if workers are not pinned
+    std::vector<int> worker_cores;
+    // statistics, only allocated once they were enabled
+    std::atomic<bool> stats_enabled{false};
+    std::unique_ptr<detail::ThreadPoolCounters> stats;
+    // autoscaling
+    bool autoscale_enabled = false;
+    AutoscalePolicy autoscale_policy;
+    std::size_t autoscale_cores = 1;
+    std::thread autoscale_thread;
+    std::condition_variable autoscale_condition;
+    std::vector<int64_t> autoscale_cpu_ns; // cpu time of each worker at the last evaluation
+    int64_t autoscale_last_sample = 0;
+    int64_t autoscale_last_busy = 0;
     // queue length limit
     std::size_t max_queue_size = 100000;
     // stop signal
@@ -121,22 +476,90 @@ inline ThreadPool::ThreadPool(std::size_t threads)
 template<class F, class... Args>
 auto ThreadPool::enqueue(F&& f, Args&&... args)
     -> std::future<typename std::result_of<F(Args...)>::type>
+{
+    return enqueue(TaskPriority::normal, std::forward<F>(f), std::forward<Args>(args)...);
+}
+
+template<class F, class... Args>
+auto ThreadPool::enqueue(TaskPriority priority, F&& f, Args&&... args)
+    -> std::future<typename std::result_of<F(Args...)>::type>
 {
     using return_type = typename std::result_of<F(Args...)>::type;
 
-    auto task = std::make_shared< std::packaged_task<return_type()> >(
-            std::bind(std::forward<F>(f), std::forward<Args>(args)...)
-        );
+    // packaged task is move only and small, so it is stored directly inside the UniqueTask
+    std::packaged_task<return_type()> task(make_task(std::forward<F>(f), std::forward<Args>(args)...));
+    std::future<return_type> res = task.get_future();
+    push_task(UniqueTask(std::move(task)), priority);
+    return res;
+}
+
+template<class F>
+auto ThreadPool::enqueue(TaskPriority priority, CancellationToken token, F&& f)
+    -> std::future<typename std::result_of<F()>::type>
+{
+    using return_type = typename std::result_of<F()>::type;
+
+    // if the task is dropped the packaged task is destroyed without running, which breaks the promise
+    std::packaged_task<return_type()> task(std::forward<F>(f));
+    std::future<return_type> res = task.get_future();
+    push_task(UniqueTask([token, task = std::move(task)]() mutable
+        {
+            if (!token.isCancelled())
+                task();
+        }), priority);
+    return res;
+}
+
+// add new work item to the pool without creating a future
+template<class F, class... Args>
+void ThreadPool::post(F&& f, Args&&... args)
+{
+    push_task(UniqueTask(make_task(std::forward<F>(f), std::forward<Args>(args)...)), TaskPriority::normal);
+}
+
+template<class F, class... Args>
+void ThreadPool::post(TaskPriority priority, F&& f, Args&&... args)
+{
+    push_task(UniqueTask(make_task(std::forward<F>(f), std::forward<Args>(args)...)), priority);
+}
+
+template<class F>
+void ThreadPool::post(TaskPriority priority, CancellationToken token, F&& f)
+{
+    push_task(UniqueTask([token, f = std::forward<F>(f)]() mutable
+        {
+            if (!token.isCancelled())
+                f();
+        }), priority);
+}
+
+// add new work item to the pool, fails instead of blocking when the queue is full
+template<class F>
+bool ThreadPool::tryPost(F&& f)
+{
+    return tryPost(TaskPriority::normal, std::forward<F>(f));
+}
+
+template<class F>
+bool ThreadPool::tryPost(TaskPriority priority, F&& f)
+{
+    std::unique_lock<std::mutex> lock(queue_mutex);
+    if (stop || num_tasks >= max_queue_size)
+        return false;
 
-    std::future<return_type> res = task->get_future();
+    push_locked(UniqueTask(std::forward<F>(f)), priority);
+    return true;
+}
 
+inline void ThreadPool::push_task(UniqueTask task, TaskPriority priority)
+{
     std::unique_lock<std::mutex> lock(queue_mutex);
-    if (tasks.size () >= max_queue_size)
+    if (num_tasks >= max_queue_size)
         // wait for the queue to empty or be stopped
         condition_producers.wait(lock,
             [this]
             {
-                return tasks.size () < max_queue_size
+                return num_tasks < max_queue_size
                     || stop;
             });
 
@@ -144,19 +567,63 @@ auto ThreadPool::enqueue(F&& f, Args&&... args)
     if (stop)
         throw std::runtime_error("enqueue on stopped ThreadPool");
 
-    tasks.emplace([task](){ (*task)(); });
+    push_locked(std::move(task), priority);
+}
+
+// queue_mutex must be locked
+inline void ThreadPool::push_locked(UniqueTask&& task, TaskPriority priority)
+{
+    detail::QueuedTask queued{std::move(task), 0};
+    if (autoscale_enabled)
+        queued.enqueue_time = detail::ThreadPoolCounters::now();
+    if (stats_enabled.load(std::memory_order_relaxed))
+    {
+        queued.enqueue_time = detail::ThreadPoolCounters::now();
+        ++stats->submitted;
+        stats->max_queue_depth = (std::max)(stats->max_queue_depth, num_tasks + 1);
+    }
+
+    tasks[static_cast<std::size_t>(priority)].push(std::move(queued));
+    ++num_tasks;
     std::atomic_fetch_add_explicit(&in_flight,
         std::size_t(1),
         std::memory_order_relaxed);
     condition_consumers.notify_one();
+}
 
-    return res;
+// take the next task from the highest priority lane, unless a lower lane is starving
+// queue_mutex must be locked and at least one task must be queued
+inline detail::QueuedTask ThreadPool::pop_next_task()
+{
+    std::size_t lane = 0;
+    while (tasks[lane].empty())
+        ++lane;
+
+    for (std::size_t l = num_lanes-1; l > lane; --l)
+        if (!tasks[l].empty() && skipped[l] >= starvation_limit)
+        {
+            lane = l;
+            if (stats_enabled.load(std::memory_order_relaxed))
+                ++stats->starvation_promotions;
+            break;
+        }
+
+    for (std::size_t l = lane+1; l < num_lanes; ++l)
+        if (!tasks[l].empty())
+            ++skipped[l];
+    skipped[lane] = 0;
+
+    detail::QueuedTask task = std::move(tasks[lane].front());
+    tasks[lane].pop();
+    --num_tasks;
+    return task;
 }
 
 
 // the destructor joins all threads
 inline ThreadPool::~ThreadPool()
 {
+    disableAutoscaling();
     std::unique_lock<std::mutex> lock(queue_mutex);
     stop = true;
     condition_consumers.notify_all();
@@ -170,7 +637,7 @@ inline void ThreadPool::waitUntilEmpty()
 {
     std::unique_lock<std::mutex> lock(this->queue_mutex);
     this->condition_producers.wait(lock,
-        [this]{ return this->tasks.empty(); });
+        [this]{ return this->num_tasks == 0; });
 }
 
 inline void ThreadPool::waitUntilNothingInFlight()
@@ -198,6 +665,97 @@ inline std::size_t ThreadPool::getPoolSize() const
     return pool_size;
 }
 
+// true if called from a task running on this pool
+inline bool ThreadPool::isWorkerThread() const
+{
+    return current_pool() == this;
+}
+
+inline void ThreadPool::setStarvationLimit(std::size_t limit)
+{
+    std::unique_lock<std::mutex> lock(this->queue_mutex);
+    starvation_limit = limit;
+}
+
+// pin worker i to cores[i % cores.size()], an empty list removes the pinning
+inline void ThreadPool::setAffinity(std::vector<int> cores)
+{
+    std::unique_lock<std::mutex> lock(this->queue_mutex);
+    worker_cores = std::move(cores);
+    for (std::size_t i = 0; i != workers.size(); ++i)
+    {
+        if (!setThreadAffinity(workers[i], worker_cores.empty() ? worker_cores
+                                            : std::vector<int>{worker_cores[i % worker_cores.size()]}))
+        {
+            logWARNING("ThreadPool") << "Could not set cpu affinity of worker " << i;
+        }
+    }
+}
+
+inline void ThreadPool::setAffinity(AffinityPolicy policy, const std::vector<int>& cores)
+{
+    setAffinity(orderCores(policy, cores));
+}
+
+// start or stop collecting statistics, enabling resets all counters
+inline void ThreadPool::enableStats(bool enable)
+{
+    std::unique_lock<std::mutex> lock(this->queue_mutex);
+    if (enable && !stats_enabled.load(std::memory_order_relaxed))
+    {
+        if (!stats)
+            stats = std::make_unique<detail::ThreadPoolCounters>();
+        stats->reset();
+        for (std::size_t i = 0; i != workers.size(); ++i)
+            stats->worker(i);
+    }
+    stats_enabled.store(enable, std::memory_order_release);
+}
+
+inline bool ThreadPool::statsEnabled() const
+{
+    return stats_enabled.load(std::memory_order_relaxed);
+}
+
+inline ThreadPoolStats ThreadPool::getStats()
+{
+    ThreadPoolStats result;
+    std::unique_lock<std::mutex> lock(this->queue_mutex);
+
+    result.enabled = stats_enabled.load(std::memory_order_relaxed);
+    result.queueDepth = num_tasks;
+    for (std::size_t l = 0; l < num_lanes; ++l)
+        result.queueDepthPerPriority[l] = tasks[l].size();
+    result.tasksInFlight = in_flight.load(std::memory_order_relaxed);
+    if (!stats)
+        return result;
+
+    result.sampledSeconds = double(detail::ThreadPoolCounters::now() - stats->start_time) * 1e-9;
+    result.maxQueueDepth = stats->max_queue_depth;
+    result.tasksSubmitted = stats->submitted;
+    result.starvationPromotions = stats->starvation_promotions;
+    result.tasksCompleted = stats->completed.load(std::memory_order_relaxed);
+    result.tasksFailed = stats->failed.load(std::memory_order_relaxed);
+    stats->queue_latency.copy_to(result.queueLatency);
+    stats->run_time.copy_to(result.runTime);
+    for (std::size_t i = 0; i < (std::min)(workers.size(), stats->workers.size()); ++i)
+    {
+        ThreadPoolStats::Worker w;
+        w.busySeconds = double(stats->workers[i].busy_ns.load(std::memory_order_relaxed)) * 1e-9;
+        w.idleSeconds = double(stats->workers[i].idle_ns.load(std::memory_order_relaxed)) * 1e-9;
+        w.tasksExecuted = stats->workers[i].tasks.load(std::memory_order_relaxed);
+        result.workers.push_back(w);
+    }
+    return result;
+}
+
+inline void ThreadPool::resetStats()
+{
+    std::unique_lock<std::mutex> lock(this->queue_mutex);
+    if (stats)
+        stats->reset();
+}
+
 inline void ThreadPool::setPoolSize(std::size_t limit)
 {
     if (limit < 1)
@@ -208,7 +766,13 @@ inline void ThreadPool::setPoolSize(std::size_t limit)
     if (stop)
         return;
 
-    pool_size = limit;
+    resize_locked(limit);
+}
+
+// queue_mutex must be locked
+inline void ThreadPool::resize_locked(std::size_t size)
+{
+    pool_size = size;
     std::size_t const old_size = this->workers.size();
     if (pool_size > old_size)
     {
@@ -221,25 +785,139 @@ inline void ThreadPool::setPoolSize(std::size_t limit)
         this->condition_consumers.notify_all();
 }
 
+// start a thread that adjusts the pool size according to policy
+inline void ThreadPool::setAutoscaling(const AutoscalePolicy& policy)
+{
+    disableAutoscaling();
+    std::unique_lock<std::mutex> lock(this->queue_mutex);
+    if (stop)
+        return;
+
+    autoscale_policy = policy;
+    autoscale_policy.minThreads = (std::max)(autoscale_policy.minThreads, std::size_t(1));
+    autoscale_policy.maxThreads = (std::max)(autoscale_policy.maxThreads, autoscale_policy.minThreads);
+    autoscale_cores = (std::max)(availableCores().size(), std::size_t(1));
+    autoscale_cpu_ns.clear();
+    autoscale_last_sample = detail::ThreadPoolCounters::now();
+    autoscale_last_busy = autoscale_last_sample;
+    autoscale_enabled = true;
+
+    resize_locked((std::min)((std::max)(pool_size, autoscale_policy.minThreads), autoscale_policy.maxThreads));
+    autoscale_thread = std::thread([this]{ autoscale_loop(); });
+}
+
+inline void ThreadPool::disableAutoscaling()
+{
+    {
+        std::unique_lock<std::mutex> lock(this->queue_mutex);
+        autoscale_enabled = false;
+        autoscale_condition.notify_all();
+    }
+    if (autoscale_thread.joinable())
+        autoscale_thread.join();
+}
+
+inline bool ThreadPool::autoscalingEnabled()
+{
+    std::unique_lock<std::mutex> lock(this->queue_mutex);
+    return autoscale_enabled;
+}
+
+inline void ThreadPool::autoscale_loop()
+{
+    std::unique_lock<std::mutex> lock(this->queue_mutex);
+    while (autoscale_enabled && !stop)
+    {
+        autoscale_condition.wait_for(lock, autoscale_policy.interval);
+        if (autoscale_enabled && !stop)
+            autoscale_step();
+    }
+}
+
+// evaluate the pool and grow or shrink it, queue_mutex must be locked
+inline void ThreadPool::autoscale_step()
+{
+    const int64_t now = detail::ThreadPoolCounters::now();
+    const int64_t elapsed = (std::max)(now - autoscale_last_sample, int64_t(1));
+    autoscale_last_sample = now;
+
+    // how long has the oldest queued task been waiting
+    int64_t oldest_wait = 0;
+    for (auto& lane : tasks)
+        if (!lane.empty() && lane.front().enqueue_time != 0)
+            oldest_wait = (std::max)(oldest_wait, now - lane.front().enqueue_time);
+
+    // how many cores did the workers use since the last evaluation, -1 if unknown
+    double cpu_used = -1.0;
+    bool cpu_time_valid = autoscale_cpu_ns.size() == workers.size();
+    int64_t cpu_total = 0;
+    autoscale_cpu_ns.resize(workers.size(), -1);
+    for (std::size_t i = 0; i != workers.size(); ++i)
+    {
+        int64_t t = detail::thread_cpu_ns(workers[i]);
+        if (t < 0 || autoscale_cpu_ns[i] < 0)
+            cpu_time_valid = false;
+        cpu_total += t - autoscale_cpu_ns[i];
+        autoscale_cpu_ns[i] = t;
+    }
+    if (cpu_time_valid)
+        cpu_used = double(cpu_total) / double(elapsed);
+
+    const std::size_t running = in_flight.load(std::memory_order_relaxed) - num_tasks;
+    const bool all_busy = num_tasks > 0 || running >= pool_size;
+    if (all_busy)
+        autoscale_last_busy = now;
+
+    if (oldest_wait > std::chrono::duration_cast<std::chrono::nanoseconds>(autoscale_policy.targetLatency).count()
+        && pool_size < autoscale_policy.maxThreads)
+    {
+        // below the number of cores we grow quickly, so bursts of work are spread over all cores right away
+        // above it we only add threads while the running tasks leave cores idle because they are blocked
+        std::size_t target = pool_size;
+        if (pool_size < autoscale_cores)
+            target = (std::min)(autoscale_cores, pool_size + (std::max)(pool_size / 2, std::size_t(1)));
+        else if (cpu_used >= 0.0
+                 && cpu_used < double((std::min)(running, autoscale_cores)) * autoscale_policy.blockedThreshold)
+            target = pool_size + 1;
+        target = (std::min)(target, (std::min)(autoscale_policy.maxThreads, pool_size + num_tasks));
+        if (target > pool_size)
+            resize_locked(target);
+    }
+    else if (!all_busy && pool_size > autoscale_policy.minThreads
+             && now - autoscale_last_busy
+                > std::chrono::duration_cast<std::chrono::nanoseconds>(autoscale_policy.idleTimeout).count())
+    {
+        resize_locked(pool_size - 1);
+        autoscale_last_busy = now; // wait another idle period before shrinking again
+    }
+}
+
 inline void ThreadPool::emplace_back_worker (std::size_t worker_number)
 {
+    if (stats)
+        stats->worker(worker_number);
+
     workers.emplace_back(
         [this, worker_number]
         {
+            current_pool() = this;
             for(;;)
             {
-                std::function<void()> task;
+                detail::QueuedTask task;
                 bool notify;
+                detail::ThreadPoolCounters::WorkerCounters* counters = nullptr;
+                int64_t idle_start = stats_enabled.load(std::memory_order_acquire)
+                                     ? detail::ThreadPoolCounters::now() : 0;
 
                 {
                     std::unique_lock<std::mutex> lock(this->queue_mutex);
                     this->condition_consumers.wait(lock,
                         [this, worker_number]{
-                            return this->stop || !this->tasks.empty()
+                            return this->stop || this->num_tasks != 0
                                 || pool_size < worker_number + 1; });
 
                     // deal with downsizing of thread pool or shutdown
-                    if ((this->stop && this->tasks.empty())
+                    if ((this->stop && this->num_tasks == 0)
                         || (!this->stop && pool_size < worker_number + 1))
                     {
                         std::thread & last_thread = this->workers.back();
@@ -256,12 +934,13 @@ inline void ThreadPool::emplace_back_worker (std::size_t worker_number)
                         else
                             continue;
                     }
-                    else if (!this->tasks.empty())
+                    else if (this->num_tasks != 0)
                     {
-                        task = std::move(this->tasks.front());
-                        this->tasks.pop();
-                        notify = this->tasks.size() + 1 ==  max_queue_size
-                            || this->tasks.empty();
+                        task = pop_next_task();
+                        notify = this->num_tasks + 1 ==  max_queue_size
+                            || this->num_tasks == 0;
+                        if (stats_enabled.load(std::memory_order_relaxed))
+                            counters = &stats->worker(worker_number);
                     }
                     else
                         continue;
@@ -275,10 +954,46 @@ inline void ThreadPool::emplace_back_worker (std::size_t worker_number)
                     condition_producers.notify_all();
                 }
 
-                task();
+                int64_t start_time = 0;
+                if (counters)
+                {
+                    start_time = detail::ThreadPoolCounters::now();
+                    if (idle_start != 0)
+                        counters->idle_ns.fetch_add(uint64_t(start_time - idle_start), std::memory_order_relaxed);
+                    if (task.enqueue_time != 0)
+                        stats->queue_latency.add(start_time - task.enqueue_time);
+                }
+
+                bool failed = false;
+                try
+                {
+                    task.task();
+                } catch(const std::exception& e)
+                {
+                    failed = true;
+                    logERROR("ThreadPool") << "Exception in posted task: " << e.what();
+                } catch(...)
+                {
+                    failed = true;
+                    logERROR("ThreadPool") << "Unknown exception in posted task.";
+                }
+
+                if (counters)
+                {
+                    int64_t run_time = detail::ThreadPoolCounters::now() - start_time;
+                    stats->run_time.add(run_time);
+                    counters->busy_ns.fetch_add(uint64_t(run_time), std::memory_order_relaxed);
+                    counters->tasks.fetch_add(1, std::memory_order_relaxed);
+                    stats->completed.fetch_add(1, std::memory_order_relaxed);
+                    if (failed)
+                        stats->failed.fetch_add(1, std::memory_order_relaxed);
+                }
             }
         }
         );
+
+    if (!worker_cores.empty())
+        setThreadAffinity(workers.back(), {worker_cores[worker_number % worker_cores.size()]});
 }
 
 } // namespace progschj
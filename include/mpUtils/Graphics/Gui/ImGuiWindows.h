@@ -17,6 +17,7 @@
 #include "ImGuiElements.h"
 #include "mpUtils/ResourceManager/ResourceManager.h"
 #include "mpUtils/Log/BufferedSink.h"
+#include <cfloat>
 //--------------------
 
 // namespace
@@ -77,7 +78,7 @@ void showResourceManagerDebugWindow( ResourceManager<CacheTs...>& resourceManage
     // draw window content if visible
     if(visible)
     {
-        static constexpr char const * stateNames[] = {"none","preloading","preloaded","preloadFailed","loading",
+        static constexpr char const * stateNames[] = {"none","queued","preloading","preloaded","preloadFailed","loading",
                                                       "failed","ready","defaulted"};
 
         // setup split
@@ -140,6 +141,14 @@ void showResourceManagerDebugWindow( ResourceManager<CacheTs...>& resourceManage
                     ImGui::Text("Name: %s", resourceCache.getDebugName().c_str());
                     ImGui::Text("Loaded Elements: %i", resourceCache.numLoaded());
                     ImGui::Text("Working dir: %s", resourceCache.getWorkDir().c_str());
+                    if(resourceCache.getMemoryBudget() > 0)
+                        ImGui::Text("Memory: %.1f / %.1f MiB", resourceCache.memoryUsage() / (1024.0*1024.0),
+                                    resourceCache.getMemoryBudget() / (1024.0*1024.0));
+                    else
+                        ImGui::Text("Memory: %.1f MiB", resourceCache.memoryUsage() / (1024.0*1024.0));
+                    ResourceLoadSummary loadSummary = resourceCache.getLoadSummary(0);
+                    ImGui::Text("Loading: %.2fs, %.1f MiB read at %.1f MB/s", loadSummary.wallTime(),
+                                loadSummary.total.bytesRead / (1024.0*1024.0), loadSummary.throughput());
                     ImGui::EndTooltip();
                 }
 
@@ -174,7 +183,8 @@ void showResourceManagerDebugWindow( ResourceManager<CacheTs...>& resourceManage
 
             ImGui::BeginHorizontal("horizontal",ImGui::GetContentRegionAvail());
             ImGui::Spring();
-            ImGui::Text("%i resources loaded", resourceManager.numLoaded());
+            ImGui::Text("%i resources loaded, %.1f MiB", resourceManager.numLoaded(),
+                        resourceManager.memoryUsage() / (1024.0*1024.0));
             ImGui::Spring();
             ImGui::EndHorizontal();
         }
@@ -290,12 +300,118 @@ void showResourceManagerDebugWindow( ResourceManager<CacheTs...>& resourceManage
                     ImGui::Text("%p", std::get<1>(resourceInfo));
                     if(ImGui::IsItemHovered())
                         ImGui::SetTooltip("%p", std::get<1>(resourceInfo));
+                    ImGui::NextColumn();
+                    ImGui::Separator();
+
+                    // time spent in the stages of the last load
+                    ResourceLoadStats loadStats = resourceCache.getLoadStats(thisSelectedHandle);
+                    auto drawTiming = [](const char* name, double seconds)
+                    {
+                        ImGui::Text("%s", name);
+                        ImGui::NextColumn();
+                        ImGui::Text("%.3f ms", seconds*1000.0);
+                        ImGui::NextColumn();
+                        ImGui::Separator();
+                    };
+
+                    ImGui::Text("File size:");
+                    ImGui::NextColumn();
+                    ImGui::Text("%.1f KiB", loadStats.bytesRead / 1024.0);
+                    ImGui::NextColumn();
+                    ImGui::Separator();
+
+                    drawTiming("Read:", loadStats.readTime);
+                    drawTiming("Queued:", loadStats.queueTime);
+                    drawTiming("Preload:", loadStats.preloadTime);
+                    drawTiming("Load:", loadStats.loadTime);
+                    drawTiming("Total:", loadStats.totalTime());
+
+                    ImGui::Text("Resident size:");
+                    ImGui::NextColumn();
+                    ImGui::Text("%.1f KiB", loadStats.residentSize / 1024.0);
                     ImGui::Separator();
 
                     ImGui::Columns(1);
                 }
             };
 
+            // statistics of the loading threads
+            auto drawPoolStats = [](const char* name, ThreadPool& pool)
+            {
+                ImGui::PushID(name);
+                ImGui::Text("%s, %zu threads", name, pool.getPoolSize());
+                bool statsEnabled = pool.statsEnabled();
+                if(ImGui::Checkbox("collect statistics", &statsEnabled))
+                    pool.enableStats(statsEnabled);
+                ImGui::SameLine();
+                if(ImGui::Button("reset"))
+                    pool.resetStats();
+
+                ThreadPoolStats stats = pool.getStats();
+                ImGui::Text("queued: %zu (realtime %zu, normal %zu, background %zu), in flight: %zu", stats.queueDepth,
+                            stats.queueDepthPerPriority[0], stats.queueDepthPerPriority[1],
+                            stats.queueDepthPerPriority[2], stats.tasksInFlight);
+                if(stats.enabled)
+                {
+                    ImGui::Text("max queued: %zu, submitted: %llu, completed: %llu, failed: %llu", stats.maxQueueDepth,
+                                static_cast<unsigned long long>(stats.tasksSubmitted),
+                                static_cast<unsigned long long>(stats.tasksCompleted),
+                                static_cast<unsigned long long>(stats.tasksFailed));
+                    ImGui::Text("queue latency: avg %.3fms, p50 < %.3fms, p99 < %.3fms", stats.queueLatency.mean()*1000.0,
+                                stats.queueLatency.percentile(0.5)*1000.0, stats.queueLatency.percentile(0.99)*1000.0);
+                    ImGui::Text("run time: avg %.3fms, p50 < %.3fms, p99 < %.3fms", stats.runTime.mean()*1000.0,
+                                stats.runTime.percentile(0.5)*1000.0, stats.runTime.percentile(0.99)*1000.0);
+
+                    float runTimeHist[ThreadPoolStats::numBuckets];
+                    for(std::size_t i = 0; i < ThreadPoolStats::numBuckets; i++)
+                        runTimeHist[i] = static_cast<float>(stats.runTime.buckets[i]);
+                    ImGui::PlotHistogram("##runtimehist", runTimeHist, ThreadPoolStats::numBuckets, 0,
+                                         "run time, log2(us)", 0.0f, FLT_MAX, ImVec2(ImGui::GetContentRegionAvail().x, 40));
+
+                    for(std::size_t i = 0; i < stats.workers.size(); i++)
+                    {
+                        const auto& w = stats.workers[i];
+                        std::string label = "worker " + std::to_string(i) + ": " + std::to_string(w.tasksExecuted) + " tasks, "
+                                            + std::to_string(static_cast<int>(w.utilization()*100.0)) + "% busy";
+                        ImGui::ProgressBar(static_cast<float>(w.utilization()), ImVec2(-1,0), label.c_str());
+                    }
+                }
+                ImGui::PopID();
+            };
+
+            if(ImGui::CollapsingHeader("Loading threads"))
+            {
+                drawPoolStats("io", resourceManager.getIoThreadPool());
+                ImGui::Separator();
+                drawPoolStats("compute", resourceManager.getThreadPool());
+            }
+
+            // where loading time goes
+            if(ImGui::CollapsingHeader("Loading times"))
+            {
+                static int numSlowest = 10;
+                ResourceLoadSummary loadSummary = resourceManager.getLoadSummary(static_cast<std::size_t>(numSlowest));
+                ImGui::Text("%zu resources loaded in %.3fs", loadSummary.numResources, loadSummary.wallTime());
+                ImGui::Text("read %.1f MiB, %.1f MB/s over all, %.1f MB/s per read", loadSummary.total.bytesRead / (1024.0*1024.0),
+                            loadSummary.throughput(), loadSummary.readThroughput());
+                ImGui::Text("read: %.3fs, queued: %.3fs, preload: %.3fs, load: %.3fs", loadSummary.total.readTime,
+                            loadSummary.total.queueTime, loadSummary.total.preloadTime, loadSummary.total.loadTime);
+                ImGui::Text("resident: %.1f MiB", loadSummary.total.residentSize / (1024.0*1024.0));
+
+                ImGui::SetNextItemWidth(60);
+                ImGui::InputInt("slowest resources", &numSlowest, 0, 0);
+                numSlowest = std::max(numSlowest, 0);
+                for(const ResourceLoadRecord& record : loadSummary.slowest)
+                {
+                    ImGui::Text("%8.2f ms  %s", record.stats.totalTime()*1000.0, record.path.c_str());
+                    if(ImGui::IsItemHovered())
+                        ImGui::SetTooltip("%s\nread: %.3f ms (%.1f KiB)\nqueued: %.3f ms\npreload: %.3f ms\nload: %.3f ms",
+                                          record.cache.c_str(), record.stats.readTime*1000.0, record.stats.bytesRead / 1024.0,
+                                          record.stats.queueTime*1000.0, record.stats.preloadTime*1000.0,
+                                          record.stats.loadTime*1000.0);
+                }
+            }
+
             // now show info on the selcted resource
             ImGui::BeginChild("selected resource", ImVec2(0, 0), true);
             {
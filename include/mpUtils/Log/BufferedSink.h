@@ -19,6 +19,7 @@
 #include "Log.h"
 #include <string>
 #include <shared_mutex>
+#include <array>
 #include <atomic>
 //--------------------
 
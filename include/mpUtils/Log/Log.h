@@ -26,6 +26,7 @@
 #include <iostream>
 #include <functional>
 #include <string>
+#include <vector>
 #include "mpUtils/Misc/stringUtils.h"
 
 //--------------------
@@ -175,6 +176,7 @@ public:
     void removeSink(int index); //!< removes a given sink (be carefull)
     void close(); //!< removes all sinks and closes the logger thread (queue is flushed), is called automatically before open and on destruction
     void flush(); //!< flush the log without closing it. Quite costly. Mainly used before throwing an exception.
+    void setThreadAffinity(std::vector<int> cores); //!< restrict the logger thread to the given cores, eg to keep it away from cores used for computation
 
     // getter and setter
     void setLogLevel(LogLvl lvl) {logLvl = lvl;} //!< set the current log level
@@ -211,7 +213,9 @@ private:
     bool bShouldLoggerRun; //!< controle if the logger thread is running
 
     std::thread loggerMainThread; //!< the logger main thread
+    std::vector<int> loggerCores; //!< cores the logger thread is allowed to run on, empty for all
     void loggerMainfunc(); //!< the mainfunc of the second thread
+    void startLoggerThread(); //!< starts the logger thread, loggerMtx needs to be locked
 
     std::vector<std::function<void(const LogMessage& msg)>> printFunctions; //! the funtion used to print a message to the log
 };
@@ -282,10 +286,7 @@ void Log::addSinks(FIRST_SINK&& sink, OTHER_SINKS&&... tail)
         printFunctions.push_back(makeFuncCopyable(std::forward<FIRST_SINK>(sink)));
 
         if(!bShouldLoggerRun)
-        {
-            bShouldLoggerRun = true;
-            loggerMainThread = std::thread(&Log::loggerMainfunc, this);
-        }
+            startLoggerThread();
     }
     addSinks(std::forward<OTHER_SINKS>(tail)...);
 }
@@ -147,7 +147,7 @@ Image<storeT>::Image(int width, int height, int channels)
 template <typename storeT>
 template <typename CopyDataType>
 Image<storeT>::Image(const CopyDataType* pixels, int width, int height, int channels)
-        : m_width(width), m_height(height), m_channels(channels), m_length(width*height*channels), m_data(pixels,pixels+m_length)
+        : m_width(width), m_height(height), m_channels(channels), m_length(width*height*channels), m_data(pixels,pixels+width*height*channels)
 {
 }
 
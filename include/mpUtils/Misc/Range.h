@@ -14,6 +14,7 @@
 // includes
 //--------------------
 #include <iterator>
+#include <cstddef>
 //--------------------
 
 // this file contains device/host functions that also need to compile when using gcc
@@ -73,6 +74,19 @@ public:
     CUDAHOSTDEV const_iterator cbegin() const { return const_iterator(m_start,m_step);}
     CUDAHOSTDEV const_iterator cend() const {return const_iterator(m_stop,m_step);}
 
+    CUDAHOSTDEV T start() const {return m_start;} //!< first value of the range
+    CUDAHOSTDEV T stop() const {return m_stop;} //!< iteration stops before reaching this value
+    CUDAHOSTDEV T step() const {return m_step;} //!< step between two values
+    CUDAHOSTDEV T operator[](std::size_t i) const {return m_start + static_cast<T>(i) * m_step;} //!< returns the i-th value of the range
+    CUDAHOSTDEV std::size_t size() const //!< number of values in the range
+    {
+        if( (m_step > 0 && m_start >= m_stop) || (m_step < 0 && m_start <= m_stop) || m_step == 0)
+            return 0;
+        std::size_t n = static_cast<std::size_t>( (m_stop - m_start) / m_step ); // truncated for integral types
+        bool beforeStop = (m_step > 0) ? ((*this)[n] < m_stop) : ((*this)[n] > m_stop);
+        return beforeStop ? n+1 : n;
+    }
+
 private:
     const T m_start;
     const T m_stop;
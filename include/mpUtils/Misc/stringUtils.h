@@ -23,6 +23,7 @@
 #include <thread>
 #include <chrono>
 #include <iomanip>
+#include <memory>
 //--------------------
 
 // namespace
@@ -0,0 +1,114 @@
+/*
+ * mpUtils
+ * AsyncFileReader.h
+ *
+ * @author: Hendrik Schwanekamp
+ * @mail:   hendrik.schwanekamp@gmx.net
+ *
+ * Implements the AsyncFileReader class
+ *
+ * Copyright (c) 2021 Hendrik Schwanekamp
+ *
+ */
+
+#ifndef MPUTILS_ASYNCFILEREADER_H
+#define MPUTILS_ASYNCFILEREADER_H
+
+// includes
+//--------------------
+#include <string>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <exception>
+#include "mpUtils/external/threadPool/ThreadPool.h"
+//--------------------
+
+// namespace
+//--------------------
+namespace mpu {
+//--------------------
+
+namespace detail {
+    struct IoUring; // kernel ring buffers and in flight reads, only defined if io_uring is available
+}
+
+//-------------------------------------------------------------------
+/**
+ * class AsyncFileReader
+ *
+ * Reads whole files into memory without blocking the calling thread.
+ * On linux the reads are performed using io_uring: a single thread collects all requests that arrived since the
+ * last submission, places them in the submission queue and hands them to the kernel with one system call.
+ * Many small files are then read concurrently, bounded by the storage device and not by the number of threads.
+ * If io_uring is not available (old kernel, other operating system, disabled by the sandbox) a thread pool is used,
+ * each of its threads reads one file at a time. Either pass the pool to use, or a pool with fallbackThreads threads
+ * is created when it is first needed. If the ring fails while in use, all reads in flight fail with the error
+ * and later reads are made using the thread pool.
+ *
+ * usage:
+ * Call read() with the path of a file and a callback. Once the file is read the callback is called with the data
+ * and a nullptr, if reading failed it is called with an empty string and an exception_ptr describing the error.
+ * Callbacks are executed on the internal reader thread, so they should be short and only forward the data
+ * to where it is processed, eg by posting a task to a ThreadPool.
+ * The destructor waits until all requested reads are done and their callbacks have returned.
+ *
+ */
+class AsyncFileReader
+{
+public:
+    using Callback = std::function<void(std::string data, std::exception_ptr error)>;
+
+    explicit AsyncFileReader(unsigned int queueDepth = 256, std::size_t fallbackThreads = 4, bool useIoUring = true);
+    explicit AsyncFileReader(ThreadPool& fallbackPool, unsigned int queueDepth = 256, bool useIoUring = true); //!< reads using fallbackPool if io_uring is not available, the pool must outlive the reader
+    ~AsyncFileReader();
+
+    AsyncFileReader(const AsyncFileReader&) = delete;
+    AsyncFileReader& operator=(const AsyncFileReader&) = delete;
+
+    void read(std::string path, Callback onComplete); //!< read the file at path and call onComplete with the result
+    void waitUntilIdle(); //!< blocks until all requested reads are done
+    std::size_t pending() const {return m_pending.load(std::memory_order_relaxed);} //!< reads which did not complete yet
+    bool usesIoUring() const {return m_ringActive.load(std::memory_order_relaxed);} //!< false if the thread pool fallback is used
+
+private:
+    struct Request
+    {
+        std::string path;
+        Callback onComplete;
+    };
+
+    void initRing(unsigned int queueDepth, bool useIoUring); //!< sets up the ring and starts the reactor if possible
+    void reactorLoop(); //!< runs in m_reactor, submits requests to the ring and processes completions
+    void wakeReactor(); //!< interrupts the reactor while it waits for completions, m_mtx needs to be locked
+    void readWithFallback(std::string path, Callback onComplete); //!< read the file on a thread of the fallback pool
+    void complete(Callback& onComplete, std::string data, std::exception_ptr error); //!< calls the callback and updates the pending count
+
+    std::unique_ptr<detail::IoUring> m_ring; //!< nullptr if io_uring is not available
+    std::atomic<bool> m_ringActive{false}; //!< false if the fallback is used, only changes while m_mtx is locked
+    std::thread m_reactor; //!< thread processing the ring
+
+    std::size_t m_fallbackThreads{0}; //!< size of the fallback pool if it needs to be created
+    ThreadPool* m_fallbackPool{nullptr}; //!< used if io_uring is not available, nullptr until first needed
+    std::unique_ptr<ThreadPool> m_ownedFallbackPool; //!< the fallback pool if it was created by the reader
+
+    std::mutex m_mtx; //!< protects the request queue, the stop flag and the fallback pool
+    std::deque<Request> m_requests; //!< requests waiting for a free slot in the submission queue
+    bool m_stop{false}; //!< set by the destructor to stop the reactor once all reads are done
+
+    std::atomic<std::size_t> m_pending{0}; //!< number of reads that did not complete yet
+    std::mutex m_idleMtx;
+    std::condition_variable m_idleCv; //!< notified when m_pending reaches zero
+};
+
+/**
+ * @brief Returns a file reader shared by the whole application, it is created on first use.
+ */
+AsyncFileReader& globalFileReader();
+
+}
+#endif //MPUTILS_ASYNCFILEREADER_H
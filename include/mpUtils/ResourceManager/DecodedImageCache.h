@@ -0,0 +1,162 @@
+/*
+ * mpUtils
+ * DecodedImageCache.h
+ *
+ * @author: Hendrik Schwanekamp
+ * @mail:   hendrik.schwanekamp@gmx.net
+ *
+ * Implements the DecodedImageCache class
+ *
+ * Copyright (c) 2021 Hendrik Schwanekamp
+ *
+ */
+
+#ifndef MPUTILS_DECODEDIMAGECACHE_H
+#define MPUTILS_DECODEDIMAGECACHE_H
+
+// includes
+//--------------------
+#include <string>
+#include <memory>
+#include <atomic>
+#include <cstdint>
+#include <type_traits>
+#include "mpUtils/Misc/Image.h"
+#include "mpUtils/ResourceManager/MappedFile.h"
+//--------------------
+
+// namespace
+//--------------------
+namespace mpu {
+//--------------------
+
+namespace detail {
+
+    std::uint64_t contentHash(const void* data, std::size_t size); //!< xxHash64 of data, identifies the content of source files
+
+    /**
+     * @brief header at the start of every file of the DecodedImageCache
+     */
+    struct DecodedImageHeader
+    {
+        char magic[8];                  //!< "MPUIMG" followed by zeros
+        std::uint32_t formatVersion;    //!< version of this layout, currently 1
+        std::uint32_t decoderVersion;   //!< version of the decoder that produced the pixels
+        std::uint64_t sourceHash;       //!< contentHash() of the encoded source file
+        std::uint64_t sourceSize;       //!< size of the encoded source file
+        std::int32_t width;
+        std::int32_t height;
+        std::int32_t channels;
+        std::int32_t forceChannels;     //!< number of channels requested when decoding, 0 for the channels of the file
+        std::uint32_t pixelFormat;      //!< size of one channel in bytes, plus 16 for floating point
+        std::uint32_t reserved;
+        std::uint64_t dataOffset;       //!< position of the pixels, a multiple of the page size
+    };
+
+    static_assert(sizeof(DecodedImageHeader) == 64, "decoded image header has unexpected padding");
+}
+
+//-------------------------------------------------------------------
+/**
+ * class DecodedImageCache
+ *
+ * Stores decoded images on disk, so images only need to be decoded once. Entries are identified by a hash of the
+ * encoded file content, the version of the decoder and the requested pixel format. If the source file changes
+ * its hash changes as well and the stale entry is no longer used. Increase the decoder version whenever the way
+ * images are decoded changes, to invalidate all entries.
+ * Every entry is a raw file with a small header and the pixels starting at a page aligned offset, so the
+ * pixels can be used straight from the memory mapped file. Loading an entry only maps the file and copies
+ * the pixels into the image, which is much faster than decoding a png.
+ *
+ * usage:
+ * Create the cache with a directory (it is created if it does not exist). Call load() with the content of an image file,
+ * it returns the cached image or decodes the file and stores the result. Use find() and store() for finer control.
+ * To use the cache with a ResourceManager bind it to preloadImageCached() (see mpUtilsResources.h).
+ * Old entries are never removed automatically, call clear() to delete all of them.
+ * All functions can be called from multiple threads and processes at the same time, entries are written to a
+ * temporary file first and then renamed.
+ *
+ */
+class DecodedImageCache
+{
+public:
+    explicit DecodedImageCache(std::string directory, std::uint32_t decoderVersion = 1);
+
+    template <typename T>
+    std::unique_ptr<Image<T>> load(DataView source, int forceChannels = STBI_rgb_alpha); //!< returns the decoded image of source, from the cache if possible
+    template <typename T>
+    bool find(DataView source, Image<T>& image, int forceChannels = STBI_rgb_alpha); //!< copies the cached image of source to image, returns false if it is not in the cache
+    template <typename T>
+    void store(DataView source, const Image<T>& image, int forceChannels = STBI_rgb_alpha); //!< stores image as the decoded version of source
+
+    void clear(); //!< deletes all entries
+    const std::string& directory() const {return m_directory;} //!< the directory entries are stored in
+    std::uint32_t decoderVersion() const {return m_decoderVersion;} //!< the version of the decoder
+    std::size_t hits() const {return m_hits.load(std::memory_order_relaxed);} //!< number of images found in the cache
+    std::size_t misses() const {return m_misses.load(std::memory_order_relaxed);} //!< number of images that were not in the cache
+
+private:
+    template <typename T>
+    static constexpr std::uint32_t pixelFormat() {return sizeof(T) + (std::is_floating_point<T>::value ? 16 : 0);}
+
+    std::string entryPath(std::uint64_t sourceHash, std::uint32_t pixelFormat, int forceChannels) const; //!< file name of an entry
+    MappedFile findEntry(std::uint64_t sourceHash, std::size_t sourceSize, std::uint32_t pixelFormat, int forceChannels,
+                         detail::DecodedImageHeader& header); //!< maps the entry, returns an empty file if there is no valid entry
+    void storeEntry(std::uint64_t sourceHash, std::size_t sourceSize, std::uint32_t pixelFormat, int forceChannels,
+                    const void* pixels, int width, int height, int channels); //!< writes an entry, logs a warning on failure
+
+    std::string m_directory;
+    std::uint32_t m_decoderVersion;
+    std::atomic<std::size_t> m_hits{0};
+    std::atomic<std::size_t> m_misses{0};
+};
+
+// template function definition
+//-------------------------------------------------------------------
+
+template <typename T>
+std::unique_ptr<Image<T>> DecodedImageCache::load(DataView source, int forceChannels)
+{
+    const std::uint64_t hash = detail::contentHash(source.data(), source.size());
+
+    detail::DecodedImageHeader header;
+    MappedFile entry = findEntry(hash, source.size(), pixelFormat<T>(), forceChannels, header);
+    if(!entry.empty())
+    {
+        m_hits.fetch_add(1, std::memory_order_relaxed);
+        return std::make_unique<Image<T>>(reinterpret_cast<const T*>(entry.data() + header.dataOffset),
+                                          header.width, header.height, header.channels);
+    }
+
+    m_misses.fetch_add(1, std::memory_order_relaxed);
+    auto image = std::make_unique<Image<T>>(source.data(), static_cast<int>(source.size()), forceChannels);
+    storeEntry(hash, source.size(), pixelFormat<T>(), forceChannels, image->data(), image->width(), image->height(), image->channels());
+    return image;
+}
+
+template <typename T>
+bool DecodedImageCache::find(DataView source, Image<T>& image, int forceChannels)
+{
+    detail::DecodedImageHeader header;
+    MappedFile entry = findEntry(detail::contentHash(source.data(), source.size()), source.size(),
+                                 pixelFormat<T>(), forceChannels, header);
+    if(entry.empty())
+    {
+        m_misses.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    m_hits.fetch_add(1, std::memory_order_relaxed);
+    image = Image<T>(reinterpret_cast<const T*>(entry.data() + header.dataOffset), header.width, header.height, header.channels);
+    return true;
+}
+
+template <typename T>
+void DecodedImageCache::store(DataView source, const Image<T>& image, int forceChannels)
+{
+    storeEntry(detail::contentHash(source.data(), source.size()), source.size(), pixelFormat<T>(), forceChannels,
+               image.data(), image.width(), image.height(), image.channels());
+}
+
+}
+#endif //MPUTILS_DECODEDIMAGECACHE_H
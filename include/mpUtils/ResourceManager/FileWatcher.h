@@ -0,0 +1,87 @@
+/*
+ * mpUtils
+ * FileWatcher.h
+ *
+ * @author: Hendrik Schwanekamp
+ * @mail:   hendrik.schwanekamp@gmx.net
+ *
+ * Implements the FileWatcher class
+ *
+ * Copyright (c) 2021 Hendrik Schwanekamp
+ *
+ */
+
+#ifndef MPUTILS_FILEWATCHER_H
+#define MPUTILS_FILEWATCHER_H
+
+// includes
+//--------------------
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <mutex>
+#include <chrono>
+//--------------------
+
+// namespace
+//--------------------
+namespace mpu {
+//--------------------
+
+//-------------------------------------------------------------------
+/**
+ * class FileWatcher
+ *
+ * Reports files that were changed on disk. On linux inotify is used to watch the directories containing the files,
+ * that way files are also detected when an editor saves by writing a new file and renaming it.
+ * Changes are debounced: a file is only reported once no event arrived for it for the debounce time,
+ * so saving a file in many small writes causes only one reload.
+ * On other platforms the watcher does nothing and isAvailable() returns false.
+ *
+ * usage:
+ * Call watch() for every file you are interested in, and unwatch() once you are no longer interested.
+ * Files are reference counted, a file watched twice needs to be unwatched twice.
+ * Call poll() regularly, it returns the files that changed, exactly as they were passed to watch().
+ * All functions can be called from any thread. The ResourceManager uses the watcher for hot reloading,
+ * see ResourceManager::enableHotReload().
+ *
+ */
+class FileWatcher
+{
+public:
+    explicit FileWatcher(std::chrono::milliseconds debounce = std::chrono::milliseconds(100));
+    ~FileWatcher();
+
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    void watch(const std::string& file); //!< report changes to file, the directory of file needs to exist
+    void unwatch(const std::string& file); //!< stop reporting changes to file
+    std::vector<std::string> poll(); //!< returns all watched files that changed and were not changed again within the debounce time
+    bool isAvailable() const {return m_fd >= 0;} //!< false if files can not be watched on this platform
+
+    void setDebounce(std::chrono::milliseconds debounce); //!< time a file needs to stay unchanged before it is reported
+    std::size_t numWatched(); //!< number of files currently watched
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Directory
+    {
+        std::string path; //!< path of the directory as passed to inotify
+        std::unordered_map<std::string, std::map<std::string, int>> files; //!< file name -> watched paths and their reference count
+    };
+
+    void readEvents(); //!< reads all pending events from the inotify descriptor, m_mtx needs to be locked
+
+    int m_fd{-1}; //!< the inotify file descriptor
+    std::mutex m_mtx; //!< protects everything below
+    std::chrono::milliseconds m_debounce;
+    std::unordered_map<int, Directory> m_directories; //!< watch descriptor -> watched directory
+    std::unordered_map<std::string, int> m_watchOfDirectory; //!< directory path -> watch descriptor
+    std::unordered_map<std::string, Clock::time_point> m_changed; //!< changed files and the time of their last event
+};
+
+}
+#endif //MPUTILS_FILEWATCHER_H
@@ -0,0 +1,129 @@
+/*
+ * mpUtils
+ * MappedFile.h
+ *
+ * @author: Hendrik Schwanekamp
+ * @mail:   hendrik.schwanekamp@gmx.net
+ *
+ * Implements the MappedFile class and the DataView class
+ *
+ * Copyright (c) 2021 Hendrik Schwanekamp
+ *
+ */
+
+#ifndef MPUTILS_MAPPEDFILE_H
+#define MPUTILS_MAPPEDFILE_H
+
+// includes
+//--------------------
+#include <string>
+#include <cstddef>
+#include <stdexcept>
+//--------------------
+
+// namespace
+//--------------------
+namespace mpu {
+//--------------------
+
+//-------------------------------------------------------------------
+/**
+ * class DataView
+ *
+ * Non owning view of a block of text or binary data, eg the contents of a MappedFile.
+ * Replacement for std::string_view / std::span, which are not available in C++14.
+ *
+ * usage:
+ * Construct from a pointer and size, or explicitly from a std::string. The viewed memory needs to stay
+ * alive as long as the view is used. Use toString() to copy the data if it needs to outlive its source.
+ *
+ */
+class DataView
+{
+public:
+    static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+    DataView() = default;
+    DataView(const void* data, std::size_t size) : m_data(static_cast<const unsigned char*>(data)), m_size(size) {}
+    explicit DataView(const std::string& s) : DataView(s.data(), s.size()) {}
+
+    const unsigned char* data() const {return m_data;} //!< pointer to the first byte
+    const char* chars() const {return reinterpret_cast<const char*>(m_data);} //!< the data as characters
+    std::size_t size() const {return m_size;} //!< number of bytes in the view
+    bool empty() const {return m_size == 0;} //!< check if the view is empty
+
+    const unsigned char* begin() const {return m_data;}
+    const unsigned char* end() const {return m_data + m_size;}
+    unsigned char operator[](std::size_t i) const {return m_data[i];}
+
+    DataView subview(std::size_t offset, std::size_t count = npos) const; //!< view of count bytes starting at offset
+    std::string toString() const {return std::string(chars(), m_size);} //!< copy the data into a string
+
+private:
+    const unsigned char* m_data{nullptr};
+    std::size_t m_size{0};
+};
+
+/**
+ * @brief how a mapped file is going to be accessed, forwarded to the os as a hint for readahead
+ */
+enum class FileAccess
+{
+    normal,     //!< no special treatment
+    sequential, //!< the file is read from start to end once, pages can be read ahead aggressively
+    random      //!< the file is accessed in random order, readahead is not useful
+};
+
+//-------------------------------------------------------------------
+/**
+ * class MappedFile
+ *
+ * Maps a file read only into memory. In contrast to readFile() the content is not copied, the returned
+ * memory is backed directly by the page cache of the operating system.
+ * On systems without mmap support the file is read into an internal buffer instead.
+ *
+ * usage:
+ * Construct with the path to a file. Throws std::runtime_error if the file can not be opened or mapped.
+ * Access the contents with data() and size() or view(). The memory stays valid as long as the MappedFile exists.
+ * Pass FileAccess::sequential (the default) when the whole file is parsed from start to end, eg by an image decoder.
+ * If prefetch is true the os is asked to start reading the whole file into memory right away.
+ * A MappedFile can be moved but not copied.
+ *
+ */
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    explicit MappedFile(const std::string& path, FileAccess access = FileAccess::sequential, bool prefetch = true);
+    ~MappedFile() {close();}
+
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const unsigned char* data() const {return m_data;} //!< pointer to the mapped memory
+    std::size_t size() const {return m_size;} //!< size of the file in bytes
+    bool empty() const {return m_size == 0;} //!< check if nothing is mapped or the file is empty
+    DataView view() const {return {m_data, m_size};} //!< view of the whole file
+
+    void close(); //!< unmaps the file, all pointers into the file become invalid
+
+private:
+    const unsigned char* m_data{nullptr}; //!< start of the mapped memory
+    std::size_t m_size{0}; //!< size of the mapping
+    std::string m_buffer; //!< holds the content if mmap is not available
+};
+
+// template function definition
+//-------------------------------------------------------------------
+
+inline DataView DataView::subview(std::size_t offset, std::size_t count) const
+{
+    if(offset > m_size)
+        throw std::out_of_range("DataView::subview offset is out of range");
+    return {m_data + offset, (count < m_size - offset) ? count : m_size - offset};
+}
+
+}
+#endif //MPUTILS_MAPPEDFILE_H
@@ -0,0 +1,179 @@
+/*
+ * mpUtils
+ * ResourceArchive.h
+ *
+ * @author: Hendrik Schwanekamp
+ * @mail:   hendrik.schwanekamp@gmx.net
+ *
+ * Implements the ResourceArchive and ResourceArchiveWriter classes
+ *
+ * Copyright (c) 2021 Hendrik Schwanekamp
+ *
+ */
+
+#ifndef MPUTILS_RESOURCEARCHIVE_H
+#define MPUTILS_RESOURCEARCHIVE_H
+
+// includes
+//--------------------
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "mpUtils/ResourceManager/MappedFile.h"
+//--------------------
+
+// namespace
+//--------------------
+namespace mpu {
+//--------------------
+
+/**
+ * @brief entry of the index of a ResourceArchive, this is also the layout used in the file
+ */
+struct ArchiveEntry
+{
+    enum Flags : std::uint32_t
+    {
+        compressed = 1 //!< the data is zlib compressed
+    };
+
+    std::uint64_t hash;         //!< hash of the path, the index is sorted by hash and then by path
+    std::uint64_t offset;       //!< position of the data in the archive
+    std::uint64_t storedSize;   //!< number of bytes stored in the archive
+    std::uint64_t size;         //!< size of the data after decompression
+    std::uint32_t pathOffset;   //!< position of the path in the string table
+    std::uint32_t pathLength;   //!< length of the path
+    std::uint32_t flags;        //!< combination of Flags
+    std::uint32_t reserved;
+
+    bool isCompressed() const {return (flags & compressed) != 0;}
+};
+
+/**
+ * @brief how files added to a ResourceArchiveWriter are compressed
+ */
+enum class ArchiveCompression
+{
+    none,       //!< store the data as is, it can be used without any copy
+    zlib,       //!< always compress the data
+    automatic   //!< compress the data if that saves at least 10 %, already compressed formats (eg png) are stored as is
+};
+
+namespace detail {
+
+    /**
+     * @brief header at the start of every archive file
+     */
+    struct ArchiveHeader
+    {
+        char magic[8];              //!< "MPUPACK" followed by a zero
+        std::uint32_t version;      //!< format version, currently 1
+        std::uint32_t entryCount;   //!< number of entries in the index
+        std::uint64_t indexOffset;  //!< position of the index
+        std::uint64_t stringsOffset;//!< position of the string table containing all paths
+        std::uint64_t stringsSize;  //!< size of the string table
+        std::uint32_t alignment;    //!< alignment of all data blocks
+        std::uint32_t reserved;
+    };
+
+    static_assert(sizeof(ArchiveEntry) == 48, "archive index entry has unexpected padding");
+    static_assert(sizeof(ArchiveHeader) == 48, "archive header has unexpected padding");
+
+    constexpr char archiveMagic[8] = {'M','P','U','P','A','C','K','\0'};
+    constexpr std::uint32_t archiveVersion = 1;
+
+    std::uint64_t archivePathHash(const char* path, std::size_t length); //!< FNV-1a hash used for the archive index
+}
+
+//-------------------------------------------------------------------
+/**
+ * class ResourceArchive
+ *
+ * Read only access to a packed archive, a single file containing many resources.
+ * The archive is memory mapped, only the index is read when it is opened. Paths are found with a
+ * binary search on their hash, uncompressed data can be used directly from the mapping without copying it.
+ *
+ * File layout (all numbers little endian):
+ *  - ArchiveHeader
+ *  - index, one ArchiveEntry per file, sorted by hash and path
+ *  - string table with all paths
+ *  - data blocks, each aligned to the alignment stored in the header
+ *
+ * usage:
+ * Create archives with the ResourceArchiveWriter or the resourcePacker example program.
+ * Open an archive by passing its path to the constructor, which throws std::runtime_error if the file is not a valid archive.
+ * Use find() to look up the entry of a path, and read() or view() to access its content.
+ * To load resources from an archive pass it to ResourceCache::setArchive() or ResourceManager::setArchive().
+ * All functions are const and can be called from multiple threads at the same time.
+ *
+ */
+class ResourceArchive
+{
+public:
+    explicit ResourceArchive(const std::string& archiveFile);
+
+    const ArchiveEntry* find(const std::string& path) const; //!< returns the entry for path, or nullptr if it is not in the archive
+    bool contains(const std::string& path) const {return find(path) != nullptr;} //!< check if path is in the archive
+
+    std::string read(const ArchiveEntry& entry) const; //!< copies the content of entry, decompresses if needed
+    std::string read(const std::string& path) const; //!< content of the file at path, throws if path is not in the archive
+    DataView view(const ArchiveEntry& entry) const; //!< the data stored in the archive, for uncompressed entries this is the content
+
+    std::size_t numEntries() const {return m_numEntries;} //!< number of files in the archive
+    const ArchiveEntry& entry(std::size_t i) const {return m_index[i];} //!< access entries by index, in the order of the index
+    std::string path(const ArchiveEntry& entry) const; //!< returns the path of entry
+    const std::string& archiveFile() const {return m_archiveFile;} //!< the file this archive was loaded from
+
+private:
+    std::string m_archiveFile;
+    MappedFile m_file; //!< the mapped archive
+    const ArchiveEntry* m_index{nullptr}; //!< start of the index inside the mapping
+    std::size_t m_numEntries{0};
+    const char* m_strings{nullptr}; //!< start of the string table inside the mapping
+};
+
+//-------------------------------------------------------------------
+/**
+ * class ResourceArchiveWriter
+ *
+ * Creates archives that can be read by the ResourceArchive class.
+ *
+ * usage:
+ * Add data with add(), files with addFile(), or a whole directory tree with addDirectory().
+ * Data is compressed as it is added, according to the selected ArchiveCompression.
+ * Paths should use '/' as separator and be relative to the root of the archive. Call write() to create the archive.
+ * Everything is kept in memory until write() is called.
+ *
+ */
+class ResourceArchiveWriter
+{
+public:
+    explicit ResourceArchiveWriter(std::size_t alignment = 16); //!< alignment of data blocks, needs to be a power of two
+
+    void add(std::string path, const std::string& data, ArchiveCompression compression = ArchiveCompression::automatic); //!< add data under path
+    void addFile(std::string path, const std::string& file, ArchiveCompression compression = ArchiveCompression::automatic); //!< add the content of file under path
+    std::size_t addDirectory(const std::string& directory, ArchiveCompression compression = ArchiveCompression::automatic,
+                             const std::string& prefix = ""); //!< add all files in directory and subdirectories, paths are relative to directory with prefix prepended, returns the number of files
+
+    void write(const std::string& archiveFile) const; //!< write the archive, throws on error or if a path was added twice
+
+    std::size_t numEntries() const {return m_entries.size();} //!< number of files added so far
+    std::size_t storedSize() const; //!< sum of the stored size of all files
+    std::size_t originalSize() const; //!< sum of the size of all files before compression
+
+private:
+    struct PendingEntry
+    {
+        std::string path;
+        std::string data; //!< the data as it will be stored
+        std::uint64_t size; //!< size before compression
+        bool compressed;
+    };
+
+    std::size_t m_alignment;
+    std::vector<PendingEntry> m_entries;
+};
+
+}
+#endif //MPUTILS_RESOURCEARCHIVE_H
@@ -21,10 +21,25 @@
 #include <atomic>
 #include <mutex>
 #include <shared_mutex>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <cstring>
+#include <stdexcept>
 #include "mpUtils/ResourceManager/readData.h"
+#include "mpUtils/ResourceManager/MappedFile.h"
+#include "mpUtils/ResourceManager/ResourceArchive.h"
+#include "mpUtils/ResourceManager/ResourceKey.h"
+#include "mpUtils/ResourceManager/FileWatcher.h"
 #include "mpUtils/Log/Log.h"
 #include "mpUtils/Misc/CopyMoveAtomic.h"
 #include "mpUtils/Misc/timeUtils.h"
+#include "mpUtils/external/threadPool/ThreadPool.h"
+#include "mpUtils/Threading/CancellationToken.h"
+#include "mpUtils/Threading/concurrent/ShardedMap.h"
+#include "mpUtils/Threading/concurrent/SegmentedVector.h"
+#include "mpUtils/Threading/concurrent/futex.h"
 //--------------------
 
 // namespace
@@ -38,6 +53,7 @@ namespace mpu {
 enum class ResourceState
 {
     none,       //!< handle was created, however resource has yet to be loaded
+    queued,     //!< preloading was requested and is waiting for a worker thread
     preloading, //!< resource is currently preloading in the worker thread
     preloaded,  //!< resource finished preloading and is awaiting to be loaded
     preloadFailed,     //!< preloading failed, resource will be swapped with a default resource
@@ -47,10 +63,100 @@ enum class ResourceState
     defaulted   //!< default resource is used instead of this resource, as an error occured while loading
 };
 
+/**
+ * @brief memory usage of a loaded resource, used to decide which resources to evict
+ */
+struct ResourceUsage
+{
+    std::string path; //!< path of the resource
+    std::size_t memorySize; //!< estimated memory used by the resource
+    int64_t lastUsed; //!< time of the last call to load() in steady_clock ticks
+};
+
+/**
+ * @brief timings recorded during the last load (or asynchronous reload) of a resource, durations in seconds
+ */
+struct ResourceLoadStats
+{
+    std::size_t bytesRead{0};       //!< bytes read from the file or stored in the archive
+    double readTime{0};             //!< time spent reading or mapping the file
+    double queueTime{0};            //!< time spent waiting for a worker thread, before reading and before preloadAsync
+    double preloadTime{0};          //!< time spent in preloadAsync
+    double loadTime{0};             //!< time spent in loadSync, on the thread calling load()
+    std::size_t residentSize{0};    //!< estimated memory used by the loaded resource
+
+    double totalTime() const {return readTime + queueTime + preloadTime + loadTime;} //!< sum of all stages, without the time the resource waited for load() to be called
+};
+
+/**
+ * @brief load timings of a single resource, part of a ResourceLoadSummary
+ */
+struct ResourceLoadRecord
+{
+    std::string cache; //!< debug name of the cache the resource belongs to
+    std::string path; //!< path of the resource
+    ResourceLoadStats stats;
+};
+
+/**
+ * @brief load timings of many resources added up, eg to find out where startup time goes
+ */
+struct ResourceLoadSummary
+{
+    std::size_t numResources{0};    //!< number of resources in the summary
+    ResourceLoadStats total;        //!< stats of all resources added up
+    int64_t firstStarted{0};        //!< steady_clock ticks when the first load started
+    int64_t lastFinished{0};        //!< steady_clock ticks when the last load finished
+    std::vector<ResourceLoadRecord> slowest; //!< resources with the highest totalTime(), slowest first
+
+    double wallTime() const; //!< seconds from the first load starting until the last one finished
+    double readThroughput() const; //!< MB/s while reading, read time of parallel reads is added up
+    double throughput() const; //!< MB/s read over the wall time
+    void add(ResourceLoadRecord record, int64_t started, int64_t finished, std::size_t slowestN); //!< adds one resource, keeps only the slowestN slowest resources
+    void merge(const ResourceLoadSummary& other, std::size_t slowestN); //!< adds all resources of other, keeps only the slowestN slowest resources
+};
+
+/**
+ * @brief Estimates the memory used by a resource, used for the memory budget of the ResourceCache.
+ *      Overload it for your own resource types. The default only counts the object itself.
+ */
+template <typename T>
+std::size_t estimateResourceSize(const T& resource)
+{
+    return sizeof(resource);
+}
+
+/**
+ * @brief Stable identifier of a resource in a ResourceCache, obtained from ResourceCache::getId().
+ *      Ids stay valid for the lifetime of the cache, even if the resource is released and loaded again.
+ */
+struct ResourceId
+{
+    static constexpr unsigned int invalid = ~0u;
+    unsigned int index{invalid}; //!< position of the resource inside the cache
+
+    bool isValid() const {return index != invalid;} //!< false for default constructed ids
+    bool operator==(const ResourceId& other) const {return index == other.index;}
+    bool operator!=(const ResourceId& other) const {return index != other.index;}
+};
+
+namespace detail {
+    /**
+     * @brief a resource that loaded another resource in its preload function, it is reloaded when the other one changes
+     */
+    struct ResourceDependent
+    {
+        const void* cache; //!< the cache of the dependent resource
+        unsigned int handle; //!< handle of the dependent resource in its cache
+        std::function<void()> reload; //!< starts an asynchronous reload of the dependent resource
+    };
+}
+
 class ReloadMode
 {
 protected:
     static thread_local bool enabled;
+    static thread_local const detail::ResourceDependent* preloading; //!< resource whose preload or load function runs in this thread
 };
 
 //-------------------------------------------------------------------
@@ -66,9 +172,46 @@ protected:
  * It might be called asynchronously in a worker thread.
  * loadSync will be called with the PreloadedData object and is expected to produce a unique pointer of type T.
  * It will always be run in the thread calling the load function.
- * startTask is expected to add the passed std::function to the used threadpool for execution.
+ * startTask is expected to add the passed std::function to the used threadpool for execution, using the passed priority.
+ * If the passed CancellationToken is cancelled before the task started, it does not need to be executed.
+ * Asynchronous preloading is split in two tasks: reading the file is started with startTask, and once the data is read,
+ * preloadAsync is started with the function passed to setAddComputeTaskFunc(). Use a pool with many threads for reading
+ * and one sized to the number of cores for the compute tasks, so slow reads and heavy decoding overlap.
+ * If no compute task function is set, both steps are started with startTask.
+ * A thread calling load() on a resource that is still queued runs the preload itself. If the file was already read
+ * and the compute task did not start yet, the loading thread claims the compute task and decodes the resource itself.
+ * Otherwise it blocks on a futex until the worker is done, instead of spinning.
+ * With setReadFileFunc() reading can be handed to an asynchronous reader like the AsyncFileReader. The task started
+ * with startTask then only submits the read, and the compute task is started from the completion callback.
+ * Instead of preloadAsync a preloadAsyncView function can be passed, which takes a DataView of the file.
+ * The file is then memory mapped instead of being copied into a string, so decoders read directly from the page cache.
+ * If both functions are provided preloadAsyncView is used.
+ * With setArchive() resources are loaded from a ResourceArchive. Paths are looked up in the archive with the prefix
+ * passed to setArchive() prepended, files which are not in the archive are still loaded from workDir.
  * The default resource will be loaded whenever a resource file could not be found
  *
+ * Every path gets a ResourceId when it is first used, which stays the same for the lifetime of the cache.
+ * Get it once with getId() and pass it instead of the path to skip hashing the path and looking it up.
+ * load(id) of a resource that is ready does not take any lock.
+ * Paths known at compile time can also be passed as ResourceKey, eg load("textures/foo.png"_rid). The resource
+ * is then looked up by the hash computed at compile time, if two paths with the same hash are used std::runtime_error is thrown.
+ *
+ * For hot reloading pass a FileWatcher to setFileWatcher(). The files of all loaded resources are then watched,
+ * reloadFile() starts an asynchronous reload of the resource using a file, which reads and preloads it using
+ * the same tasks as preload(). finishReloads() calls loadSync for all finished reloads and replaces the old resources in place,
+ * call it from the thread that would call load(). When a resource is reloaded, all resources which loaded it from
+ * their preload function (eg a sprite and its sprite sheet image) are reloaded as well.
+ * The ResourceManager does all of that in ResourceManager::updateHotReload().
+ *
+ * A memory budget can be set with setMemoryBudget(). The memory used by a resource is estimated by the function passed
+ * to setSizeEstimator() or by estimateResourceSize(). enforceBudget() evicts the least recently used resources which are
+ * not used outside of the cache until the memory usage is within budget. It is not called by load(), call it
+ * regularly, eg from a timer (the ResourceManager does that automatically).
+ *
+ * The time spent in every stage of loading is recorded for each resource: reading the file, waiting for worker threads,
+ * preloadAsync and loadSync. Get it with getLoadStats() or added up for the whole cache with getLoadSummary().
+ * Synchronous reloads with forceReload() are not recorded.
+ *
  */
 template <typename T, typename PreloadDataT>
 class ResourceCache : private ReloadMode
@@ -77,27 +220,61 @@ public:
     using ResourceType = T;
     using PreloadType = PreloadDataT;
     using HandleType = unsigned int;
+    using StartTaskFunc = std::function<void(std::function<void()>, TaskPriority, CancellationToken)>;
+    using ReadFileFunc = std::function<void(std::string, std::function<void(std::string, std::exception_ptr)>)>;
+    using SizeEstimatorFunc = std::function<std::size_t(const T&)>;
 
     ResourceCache(std::function<std::unique_ptr<PreloadDataT>(std::string)> preloadAsync,
             std::function<std::unique_ptr<T>(std::unique_ptr<PreloadDataT>)> loadSync,
-            std::string workDir, std::function<void(std::function<void()>)> startTask,
-            std::unique_ptr<T> defaultResource, std::string debugName)
-            : m_asyncPreload(std::move(preloadAsync)), m_syncFinishLoad(std::move(loadSync)),
-            m_startTask(std::move(startTask)), m_workDir(std::move(workDir)),
+            std::string workDir, StartTaskFunc startTask,
+            std::unique_ptr<T> defaultResource, std::string debugName,
+            std::function<std::unique_ptr<PreloadDataT>(DataView)> preloadAsyncView = nullptr)
+            : m_asyncPreload(std::move(preloadAsync)), m_asyncPreloadView(std::move(preloadAsyncView)),
+            m_syncFinishLoad(std::move(loadSync)), m_startTask(std::move(startTask)), m_workDir(std::move(workDir)),
             m_defaultResource(std::move(defaultResource)), m_debugName(std::move(debugName))
     {
     }
 
-    void setAddTaskFunc(std::function<void(std::function<void()>)> startTask); //!< change the add task function
+    void setAddTaskFunc(StartTaskFunc startTask); //!< change the add task function, used for reading files
+    void setAddComputeTaskFunc(StartTaskFunc startTask); //!< change the function used to start preloadAsync after the file was read
+    void setReadFileFunc(ReadFileFunc readFile); //!< read files asynchronously with readFile instead of blocking a task, readFile needs to call the passed callback once done
+    void setArchive(std::shared_ptr<const ResourceArchive> archive, std::string prefix = ""); //!< load resources from archive, prefix is prepended to paths, call before preloading anything
 
-    void preload(const std::string& path); //!< start preloading a resource
-    std::shared_ptr<T> load(const std::string& path); //!< block until loading is finished
+    ResourceId getId(const std::string& path); //!< returns the id of the resource at path, it never changes for the lifetime of the cache
+    ResourceId getId(const ResourceKey& key); //!< returns the id of the resource with key, throws if a different path with the same hash was used before
+    const std::string& getPath(ResourceId id); //!< returns the path of the resource with id
 
-    bool isReady(const std::string& path); //!< check if resource is ready for use
-    bool isPreloaded(const std::string& path); //!< check if resource is done preloading
+    void preload(const std::string& path, TaskPriority priority = TaskPriority::background) {preload(getId(path), priority);} //!< start preloading a resource
+    void preload(ResourceId id, TaskPriority priority = TaskPriority::background); //!< start preloading a resource
+    void preload(const ResourceKey& key, TaskPriority priority = TaskPriority::background) {preload(getId(key), priority);} //!< start preloading a resource
+    bool cancelPreload(const std::string& path) {return cancelPreload(getId(path));} //!< drop a queued preload that did not start yet, returns true if it was cancelled
+    bool cancelPreload(ResourceId id); //!< drop a queued preload that did not start yet, returns true if it was cancelled
+    std::shared_ptr<T> load(const std::string& path) {return load(getId(path));} //!< block until loading is finished
+    std::shared_ptr<T> load(ResourceId id); //!< block until loading is finished, lock free if the resource is ready
+    std::shared_ptr<T> load(const ResourceKey& key) {return load(getId(key));} //!< block until loading is finished
+
+    bool isReady(const std::string& path) {return isReady(getId(path));} //!< check if resource is ready for use
+    bool isReady(ResourceId id); //!< check if resource is ready for use
+    bool isReady(const ResourceKey& key) {return isReady(getId(key));} //!< check if resource is ready for use
+    bool isPreloaded(const std::string& path) {return isPreloaded(getId(path));} //!< check if resource is done preloading
+    bool isPreloaded(ResourceId id); //!< check if resource is done preloading
 
     bool loadOne(); //!< syncronously loads one resource that finished preloading, use for loading screens etc. return false if there is nothing to load anymore
 
+    void setSizeEstimator(SizeEstimatorFunc estimator); //!< estimates the memory used by a resource, if not set estimateResourceSize() is used
+    void setMemoryBudget(std::size_t bytes) {m_memoryBudget = bytes;} //!< memory enforceBudget() tries to stay within, 0 means unlimited
+    std::size_t getMemoryBudget() const {return m_memoryBudget;} //!< the current memory budget, 0 means unlimited
+    std::size_t memoryUsage(); //!< estimated memory used by all loaded resources
+    std::vector<ResourceUsage> unusedResources(); //!< loaded resources that are not used outside of the cache, least recently used first
+    std::size_t evict(const std::string& path); //!< releases a resource if it is not used anymore, returns the memory freed
+    std::size_t evictUnused(std::size_t bytes); //!< evicts least recently used resources that are not used anymore until at least bytes are freed, returns the memory freed
+    std::size_t enforceBudget(); //!< evicts unused resources until the memory usage is within budget, returns the memory freed
+
+    void setFileWatcher(std::shared_ptr<FileWatcher> watcher); //!< watch the files of all loaded resources with watcher, nullptr stops watching
+    bool reloadFile(const std::string& file); //!< start reloading the resource loaded from file (workDir included), returns false if no resource uses file
+    void reloadAsync(ResourceId id); //!< reload a loaded resource in the background, the new version is used after the next finishReloads()
+    std::size_t finishReloads(); //!< replaces resources with their reloaded version and reloads resources depending on them, returns the number of replaced resources
+
     void forceReloadAll(); //!< force reload on all resources race conditions might occur if resource is simultaneously accessed in another thread
     void forceReload(const std::string& path); //!< force reload a specific resource  race conditions might occur if resources simultaneously accessed in another thread
     void tryReleaseAll(); //!< removes all resources that are not used anymore
@@ -107,37 +284,154 @@ public:
     int numLoaded(); //!< returns number of loaded resources
     HandleType getHandle(const std::string& path); //!< returns internal resource handle (for debugging)
     std::tuple<const T*,const PreloadDataT*,int,ResourceState> getResourceInfo(HandleType h); //!< get information about resource h. Returns memory addresss, preload data adress, refcount and state. (for debugging)
+    ResourceLoadStats getLoadStats(HandleType h); //!< get the timings of the last load of resource h (for debugging)
+    ResourceLoadSummary getLoadSummary(std::size_t slowestN = 10); //!< timings of all resources that were loaded added up, with the slowestN slowest resources (for debugging)
     void doForEachResource(std::function<void(const std::string&, HandleType h)> f); //!< calls f for every currently loaded resource (for debugging)
     const std::string& getWorkDir() {return m_workDir;} //!< returns the working directory
     std::string& getDebugName() {return m_debugName;} //!< returns the name shown in the debugger
 
 private:
-    HandleType getResourceHandle(const std::string& path); //!< get a handle to the the path
-    void doPreload(const std::string& path, HandleType handle); //!< function handles load from file, calling m_asyncPreload and creating the object
+    HandleType getResourceHandle(const std::string& path); //!< get a handle to the the path, creates a new entry if path is unknown
+    ResourceId registerKey(const ResourceKey& key); //!< adds the hash of key to m_keyHandles, throws on a hash collision
+    void doPreload(const std::string& path, HandleType handle, ResourceState expected); //!< function handles load from file, calling m_asyncPreload and creating the object, if the resource is in state expected
+    void doAsyncRead(const std::string& path, HandleType handle, TaskPriority priority); //!< reads the file of a queued resource and starts a compute task to call m_asyncPreload
+    bool readResource(const std::string& path, HandleType handle, std::string& data, MappedFile& file); //!< reads the file into data, or maps it into file if m_asyncPreloadView is set, returns false if preloading failed
+    void recordRead(HandleType handle, int64_t readStart, std::size_t bytes); //!< adds the time and size of a finished read to the telemetry
+    void failPreload(const std::string& path, HandleType handle, std::exception_ptr error); //!< logs error and marks the resource as failed
+    template <typename DataT>
+    void doDecode(const std::string& path, HandleType handle, DataT data); //!< calls m_asyncPreload or m_asyncPreloadView on data (a string or MappedFile) and stores the result
+    std::unique_ptr<PreloadDataT> callPreload(std::string data); //!< calls m_asyncPreload with the data
+    std::unique_ptr<PreloadDataT> callPreload(const MappedFile& file); //!< calls m_asyncPreloadView with a view of the file
+
+    struct ArchivedData //!< a resource stored in the archive
+    {
+        std::shared_ptr<const ResourceArchive> archive;
+        const ArchiveEntry* entry;
+    };
+    ArchivedData findInArchive(const std::string& path); //!< looks up path in the archive, entry is nullptr if it is not found
+    std::unique_ptr<PreloadDataT> callPreload(const ArchivedData& data); //!< calls the preload function with data from the archive
     void doReload(const std::string& path, HandleType handle); //!< synchronously reloads a resource into the same memory address as it was before
+    std::size_t estimateSize(const T& resource); //!< estimate the memory used by resource
+    struct ResourceEntry;
+    void releaseEntry(ResourceEntry& entry); //!< frees the resource of entry, m_rmtx needs to be locked exclusively
+    void watchFile(ResourceEntry& entry); //!< watch the file of entry with m_fileWatcher, unless it is loaded from the archive
+    void addDependent(ResourceEntry& entry); //!< records the resource preloading in this thread as dependent of entry
+    void doAsyncReload(HandleType handle); //!< reads the file of a resource for reloadAsync() and starts the compute task
+    template <typename DataT>
+    void doReloadDecode(HandleType handle, DataT data); //!< preloads the data of an asynchronous reload and queues it for finishReloads()
+    void endReload(HandleType handle); //!< marks an asynchronous reload as done, restarts it if the file changed again in the meantime
+    static void setState(ResourceEntry& entry, ResourceState state); //!< changes the state of entry and wakes threads waiting for it to change
+    static void notifyWaiters(ResourceEntry& entry); //!< increments the change counter of entry and wakes threads waiting on it
+    static void waitForChange(ResourceEntry& entry, uint32_t changes); //!< blocks until the change counter of entry is no longer changes
+    static void waitWhile(ResourceEntry& entry, ResourceState state); //!< blocks while entry is in state
+    static void waitWhilePreloading(ResourceEntry& entry); //!< blocks while entry is preloading, decodes it in this thread whenever the compute task did not start yet
+    void startDecode(HandleType handle, std::function<void()> decode, TaskPriority priority); //!< starts a compute task, which the thread calling load() can claim
+    static int64_t now() {return std::chrono::steady_clock::now().time_since_epoch().count();} //!< timestamp used for lru eviction and telemetry
+    static void addTime(std::atomic<int64_t>& time, int64_t since) {time.fetch_add(now() - since, std::memory_order_relaxed);} //!< adds the time passed since since to time
 
     std::string m_workDir; //!< working directory of the loader, will be prepended to all filenames
     std::string m_debugName; //!< name of this chache used for debugging and imgui
 
-    std::function<void(std::function<void()>)> m_startTask; //!< forward a task to the used tasking system
+    StartTaskFunc m_startTask; //!< forward a task to the used tasking system
+    StartTaskFunc m_startComputeTask; //!< forward a compute heavy task to the used tasking system, m_startTask is used if empty
+    ReadFileFunc m_readFile; //!< asynchronously reads a file, if empty files are read by blocking the task started with m_startTask
+    std::shared_ptr<const ResourceArchive> m_archive; //!< resources are loaded from here if they are found in it
+    std::string m_archivePrefix; //!< prepended to the path of a resource to look it up in the archive
+    SizeEstimatorFunc m_sizeEstimator; //!< estimates the memory used by a resource
+    std::atomic<std::size_t> m_memoryBudget{0}; //!< memory budget of this cache, 0 for unlimited
     std::function<std::unique_ptr<PreloadDataT>(std::string data)> m_asyncPreload;    //!< executes part of loading that can be done in any thread, string contains binary or text data
+    std::function<std::unique_ptr<PreloadDataT>(DataView data)> m_asyncPreloadView;    //!< alternative to m_asyncPreload which reads from a memory mapped file
     std::function<std::unique_ptr<T>(std::unique_ptr<PreloadDataT>)> m_syncFinishLoad;   //!< will be executed in the thread that called load()
 
-    std::unordered_map<std::string, HandleType> m_resourceHandles; //!< map resource names to handles
+    concurrent::ShardedMap<std::string, HandleType> m_resourceHandles; //!< map resource names to handles, handles are never removed
+
+    struct KeyedHandle
+    {
+        HandleType handle; //!< handle of the resource
+        const char* path; //!< path of the key that registered the hash, keys using the same literal have the same pointer
+    };
+    concurrent::ShardedMap<std::uint64_t, KeyedHandle> m_keyHandles; //!< map hashes of ResourceKeys to handles
+
+    struct DecodeTask //!< decoding of a resource that was read, run by either the compute task or a thread waiting in load()
+    {
+        std::atomic<bool> claimed{false}; //!< set by the thread that runs decode
+        CancellationToken token; //!< cancelled once claimed, so a compute task that did not start yet is dropped
+        std::function<void()> decode;
+
+        void tryRun() //!< runs decode, if nobody else did
+        {
+            if(claimed.exchange(true))
+                return;
+            token.cancel();
+            decode();
+        }
+    };
+
+    struct DependencyScope //!< marks a resource as preloading in this thread while the scope exists
+    {
+        DependencyScope(ResourceCache* cache, HandleType handle)
+            : self{cache, handle, [cache, handle](){ cache->reloadAsync(ResourceId{handle}); }}, previous(ReloadMode::preloading)
+        {
+            ReloadMode::preloading = &self;
+        }
+        ~DependencyScope() {ReloadMode::preloading = previous;}
+
+        detail::ResourceDependent self;
+        const detail::ResourceDependent* previous;
+    };
+
+    struct LoadTimings //!< telemetry of the last load, stages run in different threads so all members are atomic
+    {
+        std::atomic<int64_t> started{0}; //!< the preload was queued or started by load()
+        std::atomic<int64_t> finished{0}; //!< loading finished, 0 if the resource was never loaded
+        std::atomic<int64_t> waitingSince{0}; //!< the resource was queued for a worker thread
+        std::atomic<int64_t> readTime{0}; //!< all times are in steady_clock ticks
+        std::atomic<int64_t> queueTime{0};
+        std::atomic<int64_t> preloadTime{0};
+        std::atomic<int64_t> loadTime{0};
+        std::atomic<std::size_t> bytesRead{0};
+
+        void reset(int64_t time) //!< starts recording a new load at time
+        {
+            started.store(time, std::memory_order_relaxed);
+            finished.store(0, std::memory_order_relaxed);
+            waitingSince.store(time, std::memory_order_relaxed);
+            readTime.store(0, std::memory_order_relaxed);
+            queueTime.store(0, std::memory_order_relaxed);
+            preloadTime.store(0, std::memory_order_relaxed);
+            loadTime.store(0, std::memory_order_relaxed);
+            bytesRead.store(0, std::memory_order_relaxed);
+        }
+    };
 
     struct ResourceEntry
     {
         ResourceEntry() = default;
-        std::shared_ptr<T> resource{nullptr};
+        std::string path; //!< path of the resource, set before the handle is published and never changed
+        std::shared_ptr<T> resource{nullptr}; //!< read by load() without a lock, only replace it using std::atomic_store
         std::unique_ptr<PreloadDataT> preloadData{nullptr};
-        CopyMoveAtomic<ResourceState> state{ResourceState::none};
+        CopyMoveAtomic<ResourceState> state{ResourceState::none}; //!< change with setState() so waiting threads are woken
+        std::atomic<uint32_t> stateChanges{0}; //!< incremented on every call to setState() and when a decode task is started, threads wait on it with a futex
+        std::atomic<uint32_t> waiters{0}; //!< number of threads waiting for the state to change
+        std::shared_ptr<DecodeTask> pendingDecode{nullptr}; //!< compute task of a resource that is preloading, only access with std::atomic_load / atomic_store
+        CancellationToken preloadToken; //!< token of the last queued preload task
+        std::size_t memorySize{0}; //!< estimated memory used by resource
+        CopyMoveAtomic<int64_t> lastUsed{0}; //!< time of the last load() call, for lru eviction
+        std::atomic<bool> watched{false}; //!< the file of the resource is watched by m_fileWatcher
+        std::atomic<bool> reloadQueued{false}; //!< an asynchronous reload is running
+        std::atomic<bool> reloadRequested{false}; //!< reloadAsync() was called, while a reload was already running
+        std::vector<detail::ResourceDependent> dependents; //!< resources that loaded this one while preloading, protected by m_dependentsMtx
+        LoadTimings timings; //!< time spent in the stages of the last load
     };
-    std::vector<ResourceEntry> m_resources; //!< actual resources
-    std::vector<HandleType> m_freeHandles; //!< free handles will go here for reuse
+    ResourceLoadStats loadStatsOf(const ResourceEntry& entry); //!< converts the timings of entry, m_rmtx needs to be locked
+    concurrent::SegmentedVector<ResourceEntry> m_resources; //!< actual resources, entries never move so they can be accessed without a lock
+
+    std::shared_timed_mutex m_rmtx; //!< locked shared while loading, releasing resources locks it exclusively
+    std::mutex m_dependentsMtx; //!< protects the dependents of all resources
 
-    std::shared_timed_mutex m_rhmtx; //!< mutex to lock the resource handle map
-    std::shared_timed_mutex m_rmtx; //!< mutex for the resource vector
-    std::mutex m_freeHandlesMtx; //!< mutex for free handles buffer
+    std::shared_ptr<FileWatcher> m_fileWatcher; //!< watches the files of loaded resources, only access with std::atomic_load / atomic_store
+    std::mutex m_reloadMtx; //!< protects m_finishedReloads
+    std::vector<std::pair<HandleType, std::unique_ptr<PreloadDataT>>> m_finishedReloads; //!< reloads waiting for finishReloads()
     std::shared_timed_mutex m_reloadAllLock; //!< allow only one reload all operartion at a time
 
     std::shared_ptr<T> m_defaultResource; //!< this will be used whenever a resource is missing
@@ -145,15 +439,16 @@ private:
     template< typename A = T, typename std::enable_if<std::is_copy_constructible<A>::value,int>::type =0> std::shared_ptr<T> handleDefaultResource(HandleType h)
     {
         if(! m_resources[h].resource)
-            m_resources[h].resource = std::make_shared<T>(*m_defaultResource);
+            std::atomic_store(&m_resources[h].resource, std::make_shared<T>(*m_defaultResource));
         else
             *(m_resources[h].resource) = *m_defaultResource;
-        m_resources[h].state = ResourceState::defaulted;
+        m_resources[h].memorySize = estimateSize(*m_resources[h].resource);
+        setState(m_resources[h], ResourceState::defaulted);
         return m_resources[h].resource;
     }
     template< typename A = T, typename std::enable_if< !std::is_copy_constructible<A>::value,int>::type =0> std::shared_ptr<T> handleDefaultResource(HandleType h)
     {
-        m_resources[h].state = ResourceState::failed;
+        setState(m_resources[h], ResourceState::failed);
         return m_defaultResource;
     }
 };
@@ -161,165 +456,494 @@ private:
 // template function definition
 //-------------------------------------------------------------------
 template <typename T, typename PreloadDataT>
-void ResourceCache<T, PreloadDataT>::preload(const std::string& path)
+void ResourceCache<T, PreloadDataT>::preload(ResourceId id, TaskPriority priority)
 {
-    HandleType h = getResourceHandle(path);
+    HandleType h = id.index;
 
     std::shared_lock<std::shared_timed_mutex> sharedLck(m_rmtx);
-    if(m_resources[h].state == ResourceState::none)
+    ResourceState expected = ResourceState::none;
+    if(m_resources[h].state.compare_exchange_strong(expected,ResourceState::queued))
     {
+        // only the thread that queued the preload writes the token, cancelPreload reads it under a unique lock
+        CancellationToken token;
+        m_resources[h].preloadToken = token;
+        m_resources[h].timings.reset(now());
         sharedLck.unlock();
-        m_startTask(std::bind(&ResourceCache::doPreload,this, path, h));
+        m_startTask(std::bind(&ResourceCache::doAsyncRead, this, std::cref(m_resources[h].path), h, priority), priority, token);
     }
 }
 
 template <typename T, typename PreloadDataT>
-std::shared_ptr<T> ResourceCache<T, PreloadDataT>::load(const std::string& path)
+bool ResourceCache<T, PreloadDataT>::cancelPreload(ResourceId id)
 {
-    HandleType h = getResourceHandle(path);
+    HandleType h = id.index;
 
-    std::shared_lock<std::shared_timed_mutex> sharedLck(m_rmtx);
+    std::unique_lock<std::shared_timed_mutex> lck(m_rmtx);
+    ResourceState expected = ResourceState::queued;
+    if(m_resources[h].state.compare_exchange_strong(expected,ResourceState::none))
+    {
+        m_resources[h].preloadToken.cancel();
+        return true;
+    }
+    return false;
+}
+
+template <typename T, typename PreloadDataT>
+std::shared_ptr<T> ResourceCache<T, PreloadDataT>::load(ResourceId id)
+{
+    HandleType h = id.index;
+    ResourceEntry& entry = m_resources[h];
+    const std::string& path = entry.path;
+    entry.lastUsed.store(now(), std::memory_order_relaxed);
+    if(ReloadMode::preloading)
+        addDependent(entry);
 
-    // quick path in case resource is ready
+    // quick path in case resource is ready, entries never move so no lock is needed
+    // if the resource is released concurrently we either get the old resource or a nullptr and take the slow path
+    ResourceState currentState = entry.state;
+    if(!ReloadMode::enabled && (currentState == ResourceState::ready || currentState == ResourceState::defaulted))
+    {
+        std::shared_ptr<T> r = std::atomic_load(&entry.resource);
+        if(r)
+            return r;
+    }
+
+    std::shared_lock<std::shared_timed_mutex> sharedLck(m_rmtx);
     if(m_resources[h].state == ResourceState::ready || m_resources[h].state == ResourceState::defaulted)
     {
         if(ReloadMode::enabled)
             forceReload(path);
 
-        return m_resources[h].resource;
+        return std::atomic_load(&m_resources[h].resource);
     }
 
-    if(m_resources[h].state == ResourceState::none)
+    // m_rmtx is not held while waiting, so the resource might be released (eg by eviction) or its preloading
+    // cancelled in the meantime, then loading starts over until it reaches a final state
+    for(;;)
     {
-        // execute preloading step syncronously
-        sharedLck.unlock();
-        doPreload(path,h);
-        sharedLck.lock();
-    }
-    else if(m_resources[h].state == ResourceState::preloading)
-    {
-        // wait for preloading to finish
-        while(m_resources[h].state == ResourceState::preloading)
+        ResourceState state = m_resources[h].state;
+        if(state == ResourceState::ready || state == ResourceState::defaulted)
+        {
+            // releasing needs the exclusive lock, so the resource is still there
+            return std::atomic_load(&m_resources[h].resource);
+        }
+
+        if(state == ResourceState::none || state == ResourceState::queued)
         {
+            // execute preloading step syncronously, if it is queued the worker will find nothing left to do
             sharedLck.unlock();
-            mpu::yield();
+            doPreload(path,h,state);
             sharedLck.lock();
+            continue;
         }
-    }
 
-    ResourceState expected = ResourceState::preloaded;
-    bool failed=false;
-    if(m_resources[h].state.compare_exchange_strong(expected,ResourceState::loading))
-    {
-        std::unique_ptr<PreloadDataT> pd = std::move(m_resources[h].preloadData);
-        sharedLck.unlock();
-        try
+        if(state == ResourceState::preloading)
         {
-            std::unique_ptr<T> r = m_syncFinishLoad(std::move(pd));
+            sharedLck.unlock();
+            waitWhilePreloading(entry);
             sharedLck.lock();
-            m_resources[h].resource = std::move(r);
-            m_resources[h].state = ResourceState::ready;
-        } catch(const std::exception& e)
-        {
-            logERROR("ResourceCache") << "Error loading resource " << path << ". Exception: " << e.what();
-            if(!sharedLck.owns_lock())
-                sharedLck.lock();
-            failed = true;
+            continue;
         }
-    } else if(expected == ResourceState::loading)
-    {
-        while(m_resources[h].state == ResourceState::loading)
+
+        if(state == ResourceState::loading)
         {
             sharedLck.unlock();
-            std::this_thread::yield();
+            waitWhile(entry, ResourceState::loading);
             sharedLck.lock();
+            continue;
         }
-    }
 
-    expected = ResourceState::preloadFailed;
-    if(m_resources[h].state.compare_exchange_strong(expected,ResourceState::loading))
-    {
-        failed = true;
+        bool failed=false;
+        ResourceState expected = ResourceState::preloaded;
+        if(m_resources[h].state.compare_exchange_strong(expected,ResourceState::loading))
+        {
+            std::unique_ptr<PreloadDataT> pd = std::move(m_resources[h].preloadData);
+            sharedLck.unlock();
+            try
+            {
+                std::unique_ptr<T> r;
+                {
+                    DependencyScope scope(this, h);
+                    const int64_t loadStart = now();
+                    r = m_syncFinishLoad(std::move(pd));
+                    addTime(entry.timings.loadTime, loadStart);
+                }
+                sharedLck.lock();
+                m_resources[h].memorySize = estimateSize(*r);
+                std::shared_ptr<T> resource(std::move(r));
+                std::atomic_store(&m_resources[h].resource, resource);
+                entry.timings.finished.store(now(), std::memory_order_relaxed);
+                setState(m_resources[h], ResourceState::ready);
+                watchFile(m_resources[h]);
+                return resource;
+            } catch(const std::exception& e)
+            {
+                logERROR("ResourceCache") << "Error loading resource " << path << ". Exception: " << e.what();
+                if(!sharedLck.owns_lock())
+                    sharedLck.lock();
+                failed = true;
+            }
+        }
+
+        expected = ResourceState::preloadFailed;
+        if(m_resources[h].state.compare_exchange_strong(expected,ResourceState::loading))
+            failed = true;
+
+        if(failed || m_resources[h].state == ResourceState::failed)
+        {
+            // resource loading failed, output the default resource instead, once the file is fixed it is reloaded
+            if(failed)
+                entry.timings.finished.store(now(), std::memory_order_relaxed);
+            watchFile(m_resources[h]);
+            return handleDefaultResource(h);
+        }
+        // the state changed between reading and the compare exchange, look at it again
     }
+}
+
+template <typename T, typename PreloadDataT>
+void ResourceCache<T, PreloadDataT>::doPreload(const std::string& path, HandleType handle, ResourceState expected)
+{
+    if(!m_resources[handle].state.compare_exchange_strong(expected,ResourceState::preloading))
+        return;
+
+    LoadTimings& timings = m_resources[handle].timings;
+    if(expected == ResourceState::queued)
+        addTime(timings.queueTime, timings.waitingSince.load(std::memory_order_relaxed));
+    else
+        timings.reset(now());
 
-    if(failed || m_resources[h].state == ResourceState::failed)
+    ArchivedData archived = findInArchive(path);
+    if(archived.entry)
     {
-        // resource loading failed, output the default resource instead
-        return handleDefaultResource(h);
+        timings.bytesRead.store(archived.entry->storedSize, std::memory_order_relaxed);
+        doDecode(path, handle, std::move(archived));
+        return;
     }
 
-    assert_true(m_resources[h].state == ResourceState::ready || m_resources[h].state == ResourceState::defaulted,
-            "ResourceManager", "Resource is not ready after loading.");
-    return m_resources[h].resource;
+    std::string data;
+    MappedFile file;
+    if(!readResource(path, handle, data, file))
+        return;
+
+    if(m_asyncPreloadView)
+        doDecode(path, handle, std::move(file));
+    else
+        doDecode(path, handle, std::move(data));
 }
 
 template <typename T, typename PreloadDataT>
-void ResourceCache<T, PreloadDataT>::doPreload(const std::string& path, HandleType handle)
+void ResourceCache<T, PreloadDataT>::doAsyncRead(const std::string& path, HandleType handle, TaskPriority priority)
 {
-    ResourceState expected = ResourceState::none;
+    ResourceState expected = ResourceState::queued;
     if(!m_resources[handle].state.compare_exchange_strong(expected,ResourceState::preloading))
         return;
 
+    LoadTimings& timings = m_resources[handle].timings;
+    addTime(timings.queueTime, timings.waitingSince.load(std::memory_order_relaxed));
+
+    // the archive is already mapped, decompressing and decoding is done in the compute task
+    ArchivedData archived = findInArchive(path);
+    if(archived.entry)
+    {
+        timings.bytesRead.store(archived.entry->storedSize, std::memory_order_relaxed);
+        startDecode(handle, [this, path, handle, archived]() { doDecode(path, handle, archived); }, priority);
+        return;
+    }
+
+    // the reader batches many reads, the task only submits the read and the callback starts decoding
+    if(m_readFile && !m_asyncPreloadView)
+    {
+        const int64_t readStart = now();
+        m_readFile(m_workDir + path, [this, path, handle, priority, readStart](std::string data, std::exception_ptr error)
+        {
+            if(error)
+            {
+                failPreload(path, handle, error);
+                return;
+            }
+            recordRead(handle, readStart, data.size());
+            startDecode(handle, [this, path, handle, data = std::move(data)]() mutable { doDecode(path, handle, std::move(data)); },
+                        priority);
+        });
+        return;
+    }
+
+    std::string data;
+    MappedFile file;
+    if(!readResource(path, handle, data, file))
+        return;
+
+    // the resource stays in the preloading state until decoding is done, the compute task is only dropped if load() decodes it
+    if(m_asyncPreloadView)
+    {
+        auto shared = std::make_shared<MappedFile>(std::move(file)); // shared, because std::function needs to be copyable
+        startDecode(handle, [this, path, handle, shared]() { doDecode(path, handle, std::move(*shared)); }, priority);
+    } else
+        startDecode(handle, [this, path, handle, data = std::move(data)]() mutable { doDecode(path, handle, std::move(data)); },
+                    priority);
+}
+
+template <typename T, typename PreloadDataT>
+bool ResourceCache<T, PreloadDataT>::readResource(const std::string& path, HandleType handle, std::string& data, MappedFile& file)
+{
     try
     {
-        std::string data = readFile(m_workDir + path);
-        auto pd = m_asyncPreload(std::move(data));
-        std::shared_lock<std::shared_timed_mutex> sharedLck(m_rmtx);
-        m_resources[handle].preloadData = std::move(pd);
-        m_resources[handle].state = ResourceState::preloaded;
+        const int64_t readStart = now();
+        if(m_asyncPreloadView)
+            file = MappedFile(m_workDir + path);
+        else
+            data = readFile(m_workDir + path);
+        recordRead(handle, readStart, m_asyncPreloadView ? file.size() : data.size());
+        return true;
+    } catch(const std::exception&)
+    {
+        failPreload(path, handle, std::current_exception());
+        return false;
+    }
+}
+
+template <typename T, typename PreloadDataT>
+void ResourceCache<T, PreloadDataT>::recordRead(HandleType handle, int64_t readStart, std::size_t bytes)
+{
+    LoadTimings& timings = m_resources[handle].timings;
+    addTime(timings.readTime, readStart);
+    timings.bytesRead.store(bytes, std::memory_order_relaxed);
+}
+
+template <typename T, typename PreloadDataT>
+void ResourceCache<T, PreloadDataT>::failPreload(const std::string& path, HandleType handle, std::exception_ptr error)
+{
+    try
+    {
+        std::rethrow_exception(error);
     } catch(const std::exception& e)
     {
         logERROR("ResourceCache") << "Error preloading resource " << path << ". Exception: " << e.what();
+    }
+    std::shared_lock<std::shared_timed_mutex> sharedLck(m_rmtx);
+    setState(m_resources[handle], ResourceState::preloadFailed);
+}
+
+template <typename T, typename PreloadDataT>
+void ResourceCache<T, PreloadDataT>::startDecode(HandleType handle, std::function<void()> decode, TaskPriority priority)
+{
+    auto task = std::make_shared<DecodeTask>();
+    LoadTimings& timings = m_resources[handle].timings;
+    const int64_t queuedAt = now();
+    task->decode = [&timings, queuedAt, decode = std::move(decode)]()
+    {
+        addTime(timings.queueTime, queuedAt);
+        decode();
+    };
+    std::atomic_store(&m_resources[handle].pendingDecode, task);
+    notifyWaiters(m_resources[handle]); // threads in load() that wait for the file to be read can now decode it
+
+    const StartTaskFunc& startCompute = m_startComputeTask ? m_startComputeTask : m_startTask;
+    CancellationToken token = task->token;
+    startCompute([task]() { task->tryRun(); }, priority, std::move(token));
+}
+
+template <typename T, typename PreloadDataT>
+void ResourceCache<T, PreloadDataT>::setState(ResourceEntry& entry, ResourceState state)
+{
+    entry.state = state;
+    notifyWaiters(entry);
+}
+
+template <typename T, typename PreloadDataT>
+void ResourceCache<T, PreloadDataT>::notifyWaiters(ResourceEntry& entry)
+{
+    entry.stateChanges.fetch_add(1);
+    if(entry.waiters.load() > 0)
+        concurrent::futexWakeAll(&entry.stateChanges);
+}
+
+template <typename T, typename PreloadDataT>
+void ResourceCache<T, PreloadDataT>::waitForChange(ResourceEntry& entry, uint32_t changes)
+{
+    entry.waiters.fetch_add(1);
+    if(entry.stateChanges.load() == changes)
+        concurrent::futexWait(&entry.stateChanges, changes);
+    entry.waiters.fetch_sub(1);
+}
+
+template <typename T, typename PreloadDataT>
+void ResourceCache<T, PreloadDataT>::waitWhile(ResourceEntry& entry, ResourceState state)
+{
+    for(;;)
+    {
+        // read the counter first, a state change after this makes futexWait return immediately
+        const uint32_t changes = entry.stateChanges.load();
+        if(entry.state != state)
+            return;
+        waitForChange(entry, changes);
+    }
+}
+
+template <typename T, typename PreloadDataT>
+void ResourceCache<T, PreloadDataT>::waitWhilePreloading(ResourceEntry& entry)
+{
+    for(;;)
+    {
+        // read the counter first, the file might be read and the decode task published while we wait
+        const uint32_t changes = entry.stateChanges.load();
+        if(entry.state != ResourceState::preloading)
+            return;
+
+        // decode in this thread if the file was read and the compute task waits in the queue, otherwise wait for the worker
+        std::shared_ptr<DecodeTask> decodeTask = std::atomic_load(&entry.pendingDecode);
+        if(decodeTask && !decodeTask->claimed.load())
+            decodeTask->tryRun();
+        else
+            waitForChange(entry, changes);
+    }
+}
+
+template <typename T, typename PreloadDataT>
+std::unique_ptr<PreloadDataT> ResourceCache<T, PreloadDataT>::callPreload(std::string data)
+{
+    return m_asyncPreload(std::move(data));
+}
+
+template <typename T, typename PreloadDataT>
+std::unique_ptr<PreloadDataT> ResourceCache<T, PreloadDataT>::callPreload(const MappedFile& file)
+{
+    return m_asyncPreloadView(file.view());
+}
+
+template <typename T, typename PreloadDataT>
+typename ResourceCache<T, PreloadDataT>::ArchivedData ResourceCache<T, PreloadDataT>::findInArchive(const std::string& path)
+{
+    if(!m_archive)
+        return {nullptr, nullptr};
+    return {m_archive, m_archive->find(m_archivePrefix + path)};
+}
+
+template <typename T, typename PreloadDataT>
+std::unique_ptr<PreloadDataT> ResourceCache<T, PreloadDataT>::callPreload(const ArchivedData& data)
+{
+    // uncompressed data can be decoded straight from the mapped archive
+    if(m_asyncPreloadView && !data.entry->isCompressed())
+        return m_asyncPreloadView(data.archive->view(*data.entry));
+
+    std::string content = data.archive->read(*data.entry);
+    if(m_asyncPreloadView)
+        return m_asyncPreloadView(DataView(content));
+    return m_asyncPreload(std::move(content));
+}
+
+template <typename T, typename PreloadDataT>
+template <typename DataT>
+void ResourceCache<T, PreloadDataT>::doDecode(const std::string& path, HandleType handle, DataT data)
+{
+    std::atomic_store(&m_resources[handle].pendingDecode, std::shared_ptr<DecodeTask>());
+    DependencyScope scope(this, handle);
+    const int64_t preloadStart = now();
+    try
+    {
+        auto pd = callPreload(std::move(data));
+        addTime(m_resources[handle].timings.preloadTime, preloadStart);
         std::shared_lock<std::shared_timed_mutex> sharedLck(m_rmtx);
-        m_resources[handle].state = ResourceState::preloadFailed;
+        m_resources[handle].preloadData = std::move(pd);
+        setState(m_resources[handle], ResourceState::preloaded);
+    } catch(const std::exception&)
+    {
+        failPreload(path, handle, std::current_exception());
     }
 }
 
 template <typename T, typename PreloadDataT>
-void ResourceCache<T, PreloadDataT>::setAddTaskFunc(std::function<void(std::function<void()>)> startTask)
+void ResourceCache<T, PreloadDataT>::setAddTaskFunc(StartTaskFunc startTask)
 {
     m_startTask = std::move(startTask);
 }
 
+template <typename T, typename PreloadDataT>
+void ResourceCache<T, PreloadDataT>::setAddComputeTaskFunc(StartTaskFunc startTask)
+{
+    m_startComputeTask = std::move(startTask);
+}
+
+template <typename T, typename PreloadDataT>
+void ResourceCache<T, PreloadDataT>::setReadFileFunc(ReadFileFunc readFile)
+{
+    m_readFile = std::move(readFile);
+}
+
+template <typename T, typename PreloadDataT>
+void ResourceCache<T, PreloadDataT>::setArchive(std::shared_ptr<const ResourceArchive> archive, std::string prefix)
+{
+    m_archive = std::move(archive);
+    m_archivePrefix = std::move(prefix);
+}
+
 template <typename T, typename PreloadDataT>
 typename ResourceCache<T,PreloadDataT>::HandleType ResourceCache<T,PreloadDataT>::getResourceHandle(const std::string& path)
 {
     HandleType h;
-    std::shared_lock<std::shared_timed_mutex> sharedLckRH(m_rhmtx);
-    auto it = m_resourceHandles.find(path);
-    if(it == m_resourceHandles.end())
+    if(m_resourceHandles.find(path, h))
+        return h;
+
+    // called with the shard locked, the handle is only visible to others once the path is set
+    return m_resourceHandles.findOrInsert(path, [&]()
     {
-        sharedLckRH.unlock();
+        HandleType newHandle = static_cast<HandleType>(m_resources.grow());
+        m_resources[newHandle].path = path;
+        return newHandle;
+    });
+}
 
-        std::unique_lock<std::mutex> lck(m_freeHandlesMtx);
-        if(m_freeHandles.empty())
-        {
-            lck.unlock();
-            std::unique_lock<std::shared_timed_mutex> lckRH(m_rhmtx);
-            std::unique_lock<std::shared_timed_mutex> lckR(m_rmtx);
-            h = m_resources.size();
-            m_resources.emplace_back();
-            m_resourceHandles.emplace(path,h);
-            return h;
-        } else
-        {
-            // use free handle from stack
-            h = m_freeHandles.back();
-            m_freeHandles.pop_back();
-            return h;
-        }
-    } else
+template <typename T, typename PreloadDataT>
+ResourceId ResourceCache<T, PreloadDataT>::getId(const std::string& path)
+{
+    return ResourceId{getResourceHandle(path)};
+}
+
+template <typename T, typename PreloadDataT>
+ResourceId ResourceCache<T, PreloadDataT>::getId(const ResourceKey& key)
+{
+    KeyedHandle keyed;
+    if(!m_keyHandles.find(key.hash(), keyed))
+        return registerKey(key);
+
+    // the same literal always has the same address, only compare the paths if the key was created somewhere else
+    if(keyed.path != key.path())
     {
-        h = it->second;
+        const std::string& path = m_resources[keyed.handle].path;
+        if(path.size() != key.length() || std::memcmp(path.data(), key.path(), key.length()) != 0)
+            throw std::runtime_error("Resource path hash collision between " + path + " and " + key.toString());
     }
-    return h;
+    return ResourceId{keyed.handle};
+}
+
+template <typename T, typename PreloadDataT>
+ResourceId ResourceCache<T, PreloadDataT>::registerKey(const ResourceKey& key)
+{
+    // the only time the path is copied into a string
+    HandleType h = getResourceHandle(key.toString());
+    KeyedHandle keyed = m_keyHandles.findOrInsert(key.hash(), [&](){ return KeyedHandle{h, key.path()}; });
+    if(keyed.handle != h)
+        throw std::runtime_error("Resource path hash collision between " + m_resources[keyed.handle].path
+                                 + " and " + key.toString());
+    return ResourceId{h};
+}
+
+template <typename T, typename PreloadDataT>
+const std::string& ResourceCache<T, PreloadDataT>::getPath(ResourceId id)
+{
+    return m_resources[id.index].path;
 }
 
 template <typename T, typename PreloadDataT>
 int ResourceCache<T, PreloadDataT>::numLoaded()
 {
-    std::shared_lock<std::shared_timed_mutex> sharedLck(m_rmtx);
-    return m_resourceHandles.size();
+    int n = 0;
+    const std::size_t size = m_resources.size();
+    for(std::size_t h = 0; h < size; ++h)
+        if(m_resources[h].state != ResourceState::none)
+            ++n;
+    return n;
 }
 
 template <typename T, typename PreloadDataT>
@@ -329,7 +953,14 @@ void ResourceCache<T, PreloadDataT>::doReload(const std::string& path, ResourceC
     std::unique_ptr<T> r;
     try
     {
-        r = m_syncFinishLoad( m_asyncPreload( readFile(m_workDir + path)));
+        DependencyScope scope(this, h);
+        ArchivedData archived = findInArchive(path);
+        if(archived.entry)
+            r = m_syncFinishLoad( callPreload( archived));
+        else if(m_asyncPreloadView)
+            r = m_syncFinishLoad( callPreload( MappedFile(m_workDir + path)));
+        else
+            r = m_syncFinishLoad( callPreload( readFile(m_workDir + path)));
     } catch(const std::exception& e)
     {
         logERROR("ResourceCache") << "Error reloading resource " << path << ". Exception: " << e.what();
@@ -341,9 +972,10 @@ void ResourceCache<T, PreloadDataT>::doReload(const std::string& path, ResourceC
         handleDefaultResource(h);
     } else
     {
-        m_resources[h].state = ResourceState::loading;
+        setState(m_resources[h], ResourceState::loading);
         *(m_resources[h].resource) = std::move(*r);
-        m_resources[h].state = ResourceState::ready;
+        m_resources[h].memorySize = estimateSize(*m_resources[h].resource);
+        setState(m_resources[h], ResourceState::ready);
     }
 }
 
@@ -358,14 +990,13 @@ void ResourceCache<T, PreloadDataT>::forceReloadAll()
     ReloadMode::enabled = true;
 
     // to use multiple threads
-    std::shared_lock<std::shared_timed_mutex> sharedLckRH(m_rhmtx);
-    for(auto& handle : m_resourceHandles)
+    const std::size_t size = m_resources.size();
+    for(HandleType h = 0; h < size; ++h)
     {
-        HandleType h = handle.second;
         std::shared_lock<std::shared_timed_mutex> sharedLck(m_rmtx);
         if(m_resources[h].state == ResourceState::ready || m_resources[h].state == ResourceState::defaulted)
         {
-            doReload(handle.first,h);
+            doReload(m_resources[h].path,h);
         }
     }
 
@@ -402,29 +1033,14 @@ template <typename T, typename PreloadDataT>
 void ResourceCache<T, PreloadDataT>::tryReleaseAll()
 {
     logDEBUG("ResourceManager") << "Releasing all unused resources.";
-    std::unique_lock<std::shared_timed_mutex> lckRH(m_rhmtx);
     std::unique_lock<std::shared_timed_mutex> lckR(m_rmtx);
-    for(auto it = m_resourceHandles.cbegin(); it!=m_resourceHandles.cend(); )
+    const std::size_t size = m_resources.size();
+    for(HandleType h = 0; h < size; ++h)
     {
-        HandleType h = it->second;
         if(m_resources[h].resource.use_count() == 1 && (m_resources[h].state == ResourceState::defaulted
             ||  m_resources[h].state == ResourceState::failed || m_resources[h].state == ResourceState::ready))
         {
-            m_resources[h].state = ResourceState::none;
-            m_resources[h].resource = nullptr;
-            m_resources[h].preloadData = nullptr;
-            lckR.unlock();
-            it = m_resourceHandles.erase(it);
-            lckRH.unlock();
-
-            std::unique_lock<std::mutex> lckFreeHandles(m_freeHandlesMtx);
-            m_freeHandles.push_back(h);
-            lckFreeHandles.unlock();
-            lckRH.lock();
-            lckR.lock();
-        } else
-        {
-            it++;
+            releaseEntry(m_resources[h]);
         }
     }
 }
@@ -433,23 +1049,339 @@ template <typename T, typename PreloadDataT>
 void ResourceCache<T, PreloadDataT>::tryRelease(const std::string& path)
 {
     logDEBUG("ResourceManager") << "Trying to release " + path;
-    HandleType h = getResourceHandle(path);
+    HandleType h;
+    if(!m_resourceHandles.find(path, h))
+        return;
 
-    std::unique_lock<std::shared_timed_mutex> lckRH(m_rhmtx);
     std::unique_lock<std::shared_timed_mutex> lckR(m_rmtx);
     if(m_resources[h].resource.use_count() == 1 && (m_resources[h].state == ResourceState::defaulted
         ||  m_resources[h].state == ResourceState::failed || m_resources[h].state == ResourceState::ready))
     {
-        m_resources[h].state = ResourceState::none;
-        m_resources[h].resource = nullptr;
-        m_resources[h].preloadData = nullptr;
-        lckR.unlock();
-        m_resourceHandles.erase(path);
-        lckRH.unlock();
+        releaseEntry(m_resources[h]);
+    }
+}
+
+template <typename T, typename PreloadDataT>
+void ResourceCache<T, PreloadDataT>::releaseEntry(ResourceEntry& entry)
+{
+    // the handle stays valid, so ids held by users can load the resource again
+    entry.state = ResourceState::none;
+    std::atomic_store(&entry.resource, std::shared_ptr<T>());
+    entry.preloadData = nullptr;
+    entry.memorySize = 0;
+
+    std::shared_ptr<FileWatcher> watcher = std::atomic_load(&m_fileWatcher);
+    if(entry.watched.exchange(false) && watcher)
+        watcher->unwatch(m_workDir + entry.path);
+}
+
+template <typename T, typename PreloadDataT>
+void ResourceCache<T, PreloadDataT>::watchFile(ResourceEntry& entry)
+{
+    std::shared_ptr<FileWatcher> watcher = std::atomic_load(&m_fileWatcher);
+    if(!watcher || findInArchive(entry.path).entry)
+        return;
+    if(!entry.watched.exchange(true))
+        watcher->watch(m_workDir + entry.path);
+}
+
+template <typename T, typename PreloadDataT>
+void ResourceCache<T, PreloadDataT>::addDependent(ResourceEntry& entry)
+{
+    const detail::ResourceDependent& dependent = *ReloadMode::preloading;
+    if(dependent.cache == this && &m_resources[dependent.handle] == &entry)
+        return;
+
+    std::lock_guard<std::mutex> lck(m_dependentsMtx);
+    for(const auto& d : entry.dependents)
+        if(d.cache == dependent.cache && d.handle == dependent.handle)
+            return;
+    entry.dependents.push_back(dependent);
+}
+
+template <typename T, typename PreloadDataT>
+void ResourceCache<T, PreloadDataT>::setFileWatcher(std::shared_ptr<FileWatcher> watcher)
+{
+    std::shared_ptr<FileWatcher> previous = std::atomic_exchange(&m_fileWatcher, watcher);
+
+    std::shared_lock<std::shared_timed_mutex> sharedLck(m_rmtx);
+    const std::size_t size = m_resources.size();
+    for(HandleType h = 0; h < size; ++h)
+    {
+        ResourceEntry& entry = m_resources[h];
+        if(entry.watched.exchange(false) && previous)
+            previous->unwatch(m_workDir + entry.path);
+        const ResourceState state = entry.state;
+        if(state == ResourceState::ready || state == ResourceState::defaulted || state == ResourceState::failed)
+            watchFile(entry);
+    }
+}
+
+template <typename T, typename PreloadDataT>
+bool ResourceCache<T, PreloadDataT>::reloadFile(const std::string& file)
+{
+    if(file.compare(0, m_workDir.size(), m_workDir) != 0)
+        return false;
+
+    HandleType h;
+    if(!m_resourceHandles.find(file.substr(m_workDir.size()), h))
+        return false;
+    const ResourceState state = m_resources[h].state;
+    if(!(state == ResourceState::ready || state == ResourceState::defaulted || state == ResourceState::failed))
+        return false;
 
-        std::unique_lock<std::mutex> lckFreeHandles(m_freeHandlesMtx);
-        m_freeHandles.push_back(h);
+    logDEBUG("ResourceManager") << m_debugName << " detected a change in " << file;
+    reloadAsync(ResourceId{h});
+    return true;
+}
+
+template <typename T, typename PreloadDataT>
+void ResourceCache<T, PreloadDataT>::reloadAsync(ResourceId id)
+{
+    ResourceEntry& entry = m_resources[id.index];
+    if(entry.state == ResourceState::failed)
+    {
+        // there is no resource to replace, reset it so the next call to load() tries again
+        std::unique_lock<std::shared_timed_mutex> lck(m_rmtx);
+        ResourceState expected = ResourceState::failed;
+        if(entry.state.compare_exchange_strong(expected, ResourceState::none))
+            entry.memorySize = 0;
+        return;
     }
+    if(!(entry.state == ResourceState::ready || entry.state == ResourceState::defaulted))
+        return;
+
+    entry.reloadRequested = true;
+    if(entry.reloadQueued.exchange(true))
+        return; // the running reload checks reloadRequested once it is done
+    entry.reloadRequested = false;
+
+    HandleType h = id.index;
+    entry.timings.reset(now());
+    m_startTask([this, h](){ doAsyncReload(h); }, TaskPriority::normal, CancellationToken());
+}
+
+template <typename T, typename PreloadDataT>
+void ResourceCache<T, PreloadDataT>::doAsyncReload(HandleType handle)
+{
+    const std::string& path = m_resources[handle].path;
+    const StartTaskFunc& startCompute = m_startComputeTask ? m_startComputeTask : m_startTask;
+    LoadTimings& timings = m_resources[handle].timings;
+    addTime(timings.queueTime, timings.waitingSince.load(std::memory_order_relaxed));
+
+    ArchivedData archived = findInArchive(path);
+    if(archived.entry)
+    {
+        timings.bytesRead.store(archived.entry->storedSize, std::memory_order_relaxed);
+        startCompute([this, handle, archived](){ doReloadDecode(handle, archived); }, TaskPriority::normal, CancellationToken());
+        return;
+    }
+
+    std::string data;
+    std::shared_ptr<MappedFile> file;
+    try
+    {
+        const int64_t readStart = now();
+        if(m_asyncPreloadView)
+            file = std::make_shared<MappedFile>(m_workDir + path);
+        else
+            data = readFile(m_workDir + path);
+        addTime(timings.readTime, readStart);
+        timings.bytesRead.store(file ? file->size() : data.size(), std::memory_order_relaxed);
+    } catch(const std::exception& e)
+    {
+        logERROR("ResourceCache") << "Error reloading resource " << path << ", the old version is kept. Exception: " << e.what();
+        endReload(handle);
+        return;
+    }
+
+    if(file)
+        startCompute([this, handle, file](){ doReloadDecode(handle, std::move(*file)); }, TaskPriority::normal, CancellationToken());
+    else
+        startCompute([this, handle, data = std::move(data)]() mutable { doReloadDecode(handle, std::move(data)); },
+                     TaskPriority::normal, CancellationToken());
+}
+
+template <typename T, typename PreloadDataT>
+template <typename DataT>
+void ResourceCache<T, PreloadDataT>::doReloadDecode(HandleType handle, DataT data)
+{
+    DependencyScope scope(this, handle);
+    try
+    {
+        const int64_t preloadStart = now();
+        auto pd = callPreload(std::move(data));
+        addTime(m_resources[handle].timings.preloadTime, preloadStart);
+        std::lock_guard<std::mutex> lck(m_reloadMtx);
+        m_finishedReloads.emplace_back(handle, std::move(pd));
+    } catch(const std::exception& e)
+    {
+        logERROR("ResourceCache") << "Error reloading resource " << m_resources[handle].path
+                                  << ", the old version is kept. Exception: " << e.what();
+        endReload(handle);
+    }
+}
+
+template <typename T, typename PreloadDataT>
+void ResourceCache<T, PreloadDataT>::endReload(HandleType handle)
+{
+    m_resources[handle].reloadQueued = false;
+    if(m_resources[handle].reloadRequested)
+        reloadAsync(ResourceId{handle});
+}
+
+template <typename T, typename PreloadDataT>
+std::size_t ResourceCache<T, PreloadDataT>::finishReloads()
+{
+    std::vector<std::pair<HandleType, std::unique_ptr<PreloadDataT>>> finished;
+    {
+        std::lock_guard<std::mutex> lck(m_reloadMtx);
+        finished.swap(m_finishedReloads);
+    }
+
+    std::size_t reloaded = 0;
+    for(auto& reload : finished)
+    {
+        const HandleType h = reload.first;
+        ResourceEntry& entry = m_resources[h];
+
+        std::unique_ptr<T> r;
+        try
+        {
+            DependencyScope scope(this, h);
+            const int64_t loadStart = now();
+            r = m_syncFinishLoad(std::move(reload.second));
+            addTime(entry.timings.loadTime, loadStart);
+        } catch(const std::exception& e)
+        {
+            logERROR("ResourceCache") << "Error reloading resource " << entry.path << ", the old version is kept. Exception: " << e.what();
+            endReload(h);
+            continue;
+        }
+
+        bool replaced = false;
+        {
+            // the resource might have been released in the meantime
+            std::shared_lock<std::shared_timed_mutex> sharedLck(m_rmtx);
+            ResourceState expected = ResourceState::ready;
+            if(entry.state.compare_exchange_strong(expected, ResourceState::loading)
+               || (expected == ResourceState::defaulted && entry.state.compare_exchange_strong(expected, ResourceState::loading)))
+            {
+                // same memory address, so everyone holding the resource sees the new version
+                *(entry.resource) = std::move(*r);
+                entry.memorySize = estimateSize(*entry.resource);
+                entry.timings.finished.store(now(), std::memory_order_relaxed);
+                setState(entry, ResourceState::ready);
+                replaced = true;
+            }
+        }
+        endReload(h);
+        if(!replaced)
+            continue;
+
+        ++reloaded;
+        logINFO("ResourceManager") << m_debugName << " reloaded " << entry.path;
+
+        std::vector<detail::ResourceDependent> dependents;
+        {
+            std::lock_guard<std::mutex> lck(m_dependentsMtx);
+            dependents = entry.dependents;
+        }
+        for(const auto& d : dependents)
+            d.reload();
+    }
+    return reloaded;
+}
+
+template <typename T, typename PreloadDataT>
+void ResourceCache<T, PreloadDataT>::setSizeEstimator(SizeEstimatorFunc estimator)
+{
+    m_sizeEstimator = std::move(estimator);
+}
+
+template <typename T, typename PreloadDataT>
+std::size_t ResourceCache<T, PreloadDataT>::estimateSize(const T& resource)
+{
+    return m_sizeEstimator ? m_sizeEstimator(resource) : estimateResourceSize(resource);
+}
+
+template <typename T, typename PreloadDataT>
+std::size_t ResourceCache<T, PreloadDataT>::memoryUsage()
+{
+    std::shared_lock<std::shared_timed_mutex> sharedLck(m_rmtx);
+    std::size_t usage = 0;
+    const std::size_t size = m_resources.size();
+    for(HandleType h = 0; h < size; ++h)
+    {
+        const ResourceEntry& entry = m_resources[h];
+        if(entry.state == ResourceState::ready || entry.state == ResourceState::defaulted)
+            usage += entry.memorySize;
+    }
+    return usage;
+}
+
+template <typename T, typename PreloadDataT>
+std::vector<ResourceUsage> ResourceCache<T, PreloadDataT>::unusedResources()
+{
+    std::vector<ResourceUsage> unused;
+    {
+        std::shared_lock<std::shared_timed_mutex> sharedLck(m_rmtx);
+        const std::size_t size = m_resources.size();
+        for(HandleType h = 0; h < size; ++h)
+        {
+            const ResourceEntry& entry = m_resources[h];
+            if(entry.resource.use_count() == 1
+               && (entry.state == ResourceState::ready || entry.state == ResourceState::defaulted))
+                unused.push_back({entry.path, entry.memorySize, entry.lastUsed.load(std::memory_order_relaxed)});
+        }
+    }
+    std::sort(unused.begin(), unused.end(), [](const ResourceUsage& a, const ResourceUsage& b){ return a.lastUsed < b.lastUsed; });
+    return unused;
+}
+
+template <typename T, typename PreloadDataT>
+std::size_t ResourceCache<T, PreloadDataT>::evict(const std::string& path)
+{
+    HandleType h;
+    if(!m_resourceHandles.find(path, h))
+        return 0;
+
+    // check again, the resource might have been loaded since it was selected for eviction
+    std::unique_lock<std::shared_timed_mutex> lckR(m_rmtx);
+    if(m_resources[h].resource.use_count() != 1
+       || !(m_resources[h].state == ResourceState::ready || m_resources[h].state == ResourceState::defaulted))
+        return 0;
+
+    std::size_t freed = m_resources[h].memorySize;
+    releaseEntry(m_resources[h]);
+    return freed;
+}
+
+template <typename T, typename PreloadDataT>
+std::size_t ResourceCache<T, PreloadDataT>::evictUnused(std::size_t bytes)
+{
+    std::size_t freed = 0;
+    for(const ResourceUsage& r : unusedResources())
+    {
+        if(freed >= bytes)
+            break;
+        freed += evict(r.path);
+    }
+    return freed;
+}
+
+template <typename T, typename PreloadDataT>
+std::size_t ResourceCache<T, PreloadDataT>::enforceBudget()
+{
+    const std::size_t budget = m_memoryBudget;
+    if(budget == 0)
+        return 0;
+    const std::size_t usage = memoryUsage();
+    if(usage <= budget)
+        return 0;
+    std::size_t freed = evictUnused(usage - budget);
+    logDEBUG("ResourceManager") << m_debugName << " evicted " << freed << " bytes to stay within its memory budget.";
+    return freed;
 }
 
 template <typename T, typename PreloadDataT>
@@ -462,48 +1394,89 @@ template <typename T, typename PreloadDataT>
 std::tuple<const T*, const PreloadDataT*, int, ResourceState> ResourceCache<T, PreloadDataT>::getResourceInfo(ResourceCache::HandleType h)
 {
     std::shared_lock<std::shared_timed_mutex> sharedLck(m_rmtx);
-    return std::tuple<const T*, const PreloadDataT*, int, ResourceState>(m_resources[h].resource.get(),m_resources[h].preloadData.get(),m_resources[h].resource.use_count()-1,m_resources[h].state);
+    std::shared_ptr<T> resource = std::atomic_load(&m_resources[h].resource);
+    return std::tuple<const T*, const PreloadDataT*, int, ResourceState>(resource.get(),m_resources[h].preloadData.get(),resource ? resource.use_count()-2 : 0,m_resources[h].state);
 }
 
 template <typename T, typename PreloadDataT>
-void ResourceCache<T, PreloadDataT>::doForEachResource(std::function<void(const std::string&, HandleType)> f)
+ResourceLoadStats ResourceCache<T, PreloadDataT>::loadStatsOf(const ResourceEntry& entry)
 {
-    std::shared_lock<std::shared_timed_mutex> sharedLck(m_rhmtx);
-    for(const auto& mResource : m_resourceHandles)
+    auto seconds = [](const std::atomic<int64_t>& ticks)
     {
-        f(mResource.first,mResource.second);
-    }
+        return std::chrono::duration<double>(std::chrono::steady_clock::duration(ticks.load(std::memory_order_relaxed))).count();
+    };
+
+    ResourceLoadStats stats;
+    stats.bytesRead = entry.timings.bytesRead.load(std::memory_order_relaxed);
+    stats.readTime = seconds(entry.timings.readTime);
+    stats.queueTime = seconds(entry.timings.queueTime);
+    stats.preloadTime = seconds(entry.timings.preloadTime);
+    stats.loadTime = seconds(entry.timings.loadTime);
+    if(entry.state == ResourceState::ready || entry.state == ResourceState::defaulted)
+        stats.residentSize = entry.memorySize;
+    return stats;
 }
 
 template <typename T, typename PreloadDataT>
-bool ResourceCache<T, PreloadDataT>::isReady(const std::string& path)
+ResourceLoadStats ResourceCache<T, PreloadDataT>::getLoadStats(ResourceCache::HandleType h)
 {
-    HandleType h = getResourceHandle(path);
     std::shared_lock<std::shared_timed_mutex> sharedLck(m_rmtx);
-    return (m_resources[h].state == ResourceState::ready || m_resources[h].state == ResourceState::defaulted || m_resources[h].state == ResourceState::failed);
+    return loadStatsOf(m_resources[h]);
 }
 
 template <typename T, typename PreloadDataT>
-bool ResourceCache<T, PreloadDataT>::isPreloaded(const std::string& path)
+ResourceLoadSummary ResourceCache<T, PreloadDataT>::getLoadSummary(std::size_t slowestN)
 {
-    HandleType h = getResourceHandle(path);
+    ResourceLoadSummary summary;
     std::shared_lock<std::shared_timed_mutex> sharedLck(m_rmtx);
-    return !(m_resources[h].state == ResourceState::none || m_resources[h].state == ResourceState::preloading);
+    const std::size_t size = m_resources.size();
+    for(HandleType h = 0; h < size; ++h)
+    {
+        const ResourceEntry& entry = m_resources[h];
+        const int64_t finished = entry.timings.finished.load(std::memory_order_relaxed);
+        if(finished == 0)
+            continue;
+        summary.add({m_debugName, entry.path, loadStatsOf(entry)}, entry.timings.started.load(std::memory_order_relaxed),
+                    finished, slowestN);
+    }
+    return summary;
+}
+
+template <typename T, typename PreloadDataT>
+void ResourceCache<T, PreloadDataT>::doForEachResource(std::function<void(const std::string&, HandleType)> f)
+{
+    // no lock needed, entries never move and the path of an entry is never changed once it is in use
+    const std::size_t size = m_resources.size();
+    for(HandleType h = 0; h < size; ++h)
+    {
+        if(m_resources[h].state != ResourceState::none)
+            f(m_resources[h].path, h);
+    }
+}
+
+template <typename T, typename PreloadDataT>
+bool ResourceCache<T, PreloadDataT>::isReady(ResourceId id)
+{
+    const ResourceState state = m_resources[id.index].state;
+    return (state == ResourceState::ready || state == ResourceState::defaulted || state == ResourceState::failed);
+}
+
+template <typename T, typename PreloadDataT>
+bool ResourceCache<T, PreloadDataT>::isPreloaded(ResourceId id)
+{
+    const ResourceState state = m_resources[id.index].state;
+    return !(state == ResourceState::none || state == ResourceState::queued || state == ResourceState::preloading);
 }
 
 template <typename T, typename PreloadDataT>
 bool ResourceCache<T, PreloadDataT>::loadOne()
 {
-    std::shared_lock<std::shared_timed_mutex> sharedLckRH(m_rhmtx);
-    for(const auto& handle : m_resourceHandles)
+    const std::size_t size = m_resources.size();
+    for(HandleType h = 0; h < size; ++h)
     {
-        HandleType h = handle.second;
-        std::shared_lock<std::shared_timed_mutex> sharedLckR(m_rmtx);
         if(m_resources[h].state == ResourceState::preloaded ||  m_resources[h].state == ResourceState::preloadFailed)
         {
-            sharedLckR.unlock();
-            sharedLckRH.unlock();
-            load(handle.first);
+            load(ResourceId{h});
             return true;
         }
     }
@@ -0,0 +1,90 @@
+/*
+ * mpUtils
+ * ResourceKey.h
+ *
+ * @author: Hendrik Schwanekamp
+ * @mail:   hendrik.schwanekamp@gmx.net
+ *
+ * Implements the ResourceKey class and the _rid literal
+ *
+ * Copyright (c) 2021 Hendrik Schwanekamp
+ *
+ */
+
+#ifndef MPUTILS_RESOURCEKEY_H
+#define MPUTILS_RESOURCEKEY_H
+
+// includes
+//--------------------
+#include <string>
+#include <cstdint>
+#include <cstddef>
+//--------------------
+
+// namespace
+//--------------------
+namespace mpu {
+//--------------------
+
+namespace detail {
+    /**
+     * @brief FNV-1a 64 bit hash of a resource path, can be evaluated at compile time
+     */
+    constexpr std::uint64_t resourcePathHash(const char* path, std::size_t length)
+    {
+        std::uint64_t hash = 14695981039346656037ull;
+        for(std::size_t i = 0; i < length; ++i)
+        {
+            hash ^= static_cast<unsigned char>(path[i]);
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+}
+
+//-------------------------------------------------------------------
+/**
+ * class ResourceKey
+ *
+ * A resource path together with its hash, which is computed at compile time for string literals.
+ * Passing a key to ResourceCache::load() looks the resource up by hash, without hashing the path
+ * or creating a std::string. The key does not copy the path, it needs to outlive the key, which is always
+ * the case for string literals.
+ *
+ * usage:
+ * Write "textures/foo.png"_rid to create a key from a literal. Keys can be used in constant expressions,
+ * eg static_assert("a.png"_rid != "b.png"_rid, "hash collision");
+ * A ResourceCache reports an error if two different paths with the same hash are used.
+ *
+ */
+class ResourceKey
+{
+public:
+    constexpr ResourceKey(const char* path, std::size_t length)
+        : m_path(path), m_length(length), m_hash(detail::resourcePathHash(path, length)) {}
+    template <std::size_t N>
+    constexpr explicit ResourceKey(const char (&path)[N]) : ResourceKey(path, N-1) {}
+
+    constexpr std::uint64_t hash() const {return m_hash;} //!< FNV-1a hash of the path
+    constexpr const char* path() const {return m_path;} //!< the path, not null terminated if the key was created from part of a string
+    constexpr std::size_t length() const {return m_length;} //!< length of the path
+    std::string toString() const {return std::string(m_path, m_length);} //!< copy of the path
+
+    constexpr bool operator==(const ResourceKey& other) const {return m_hash == other.m_hash;} //!< compares only the hashes
+    constexpr bool operator!=(const ResourceKey& other) const {return m_hash != other.m_hash;} //!< compares only the hashes
+
+private:
+    const char* m_path;
+    std::size_t m_length;
+    std::uint64_t m_hash;
+};
+
+inline namespace literals {
+    constexpr ResourceKey operator"" _rid(const char* path, std::size_t length) //!< create a ResourceKey from a string literal
+    {
+        return ResourceKey(path, length);
+    }
+}
+
+}
+#endif //MPUTILS_RESOURCEKEY_H
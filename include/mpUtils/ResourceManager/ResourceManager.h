@@ -17,8 +17,11 @@
 // includes
 //--------------------
 #include "ResourceCache.h"
+#include "AsyncFileReader.h"
+#include "FileWatcher.h"
 #include "mpUtils/Misc/templateUtils.h"
 #include "mpUtils/external/threadPool/ThreadPool.h"
+#include "mpUtils/Timer/TimerService.h"
 //--------------------
 
 // namespace
@@ -35,6 +38,13 @@ namespace mpu {
  * Resource manager packs together multiple resource caches for the management of resources of different types.
  * For mpUtils classes that might be used as a resource, aliases and template instantiations,
  * as well as load and preload functions are available in mpUtilsResources.h.
+ * Preloading uses two thread pools. Files are read by an io pool which grows while its threads are blocked
+ * by the disk, and the preload functions run on a compute pool of at most one thread per core.
+ * Memory budgets can be set for each cache and for the manager as a whole. Once a budget is set, a background tick
+ * regularly evicts the least recently used resources that are no longer used outside of the manager.
+ * After enableHotReload() the files of all loaded resources are watched. Call updateHotReload() regularly
+ * (eg once per frame) from the thread that uses the resources, changed files are then reloaded in the background
+ * and swapped in during a later call, together with all resources that depend on them.
  *
  */
 template <typename ... CacheT>
@@ -55,32 +65,81 @@ public:
         std::string workingDir; //!< working directory for this kind of resources
         std::unique_ptr<T> defaultResource; //!< default resource, used if resource is missing
         std::string debugName; //!< name of ths cache used in imgui
+        std::function<std::unique_ptr<PreloadDataT>(DataView)> asyncPreloadViewFunc; //!< optional, preloads from a memory mapped file instead of asyncPreloadFunc
     };
 
     explicit ResourceManager( cacheCreationData<typename CacheT::ResourceType, typename CacheT::PreloadType> ... caches);
+    ~ResourceManager(); //!< waits for running preload tasks
 
-    template <typename T> void preload(const std::string& path); //!< preloads a resource of type T with name path
+    template <typename T> ResourceId getId(const std::string& path); //!< stable id of the resource of type T with name path, using it skips the path lookup
+    template <typename T> ResourceId getId(const ResourceKey& key); //!< stable id of the resource of type T with key, throws on hash collisions
+
+    template <typename T> void preload(const std::string& path, TaskPriority priority = TaskPriority::background); //!< preloads a resource of type T with name path
+    template <typename T> void preload(ResourceId id, TaskPriority priority = TaskPriority::background); //!< preloads the resource of type T with id
+    template <typename T> void preload(const ResourceKey& key, TaskPriority priority = TaskPriority::background); //!< preloads the resource of type T with key, eg preload<Image8>("a.png"_rid)
+    template <typename T> bool cancelPreload(const std::string& path); //!< drops a queued preload of a resource that is no longer needed
     template <typename T> std::shared_ptr<T> load(const std::string& path); //!< loads a resource of type T with name path
+    template <typename T> std::shared_ptr<T> load(ResourceId id); //!< loads the resource of type T with id, lock free if it is ready
+    template <typename T> std::shared_ptr<T> load(const ResourceKey& key); //!< loads the resource of type T with key without hashing the path at runtime, eg load<Image8>("a.png"_rid)
 
     template <typename T> bool isReady(const std::string& path); //!< check if resource is ready for use
+    template <typename T> bool isReady(ResourceId id); //!< check if resource is ready for use
     template <typename T> bool isPreloaded(const std::string& path); //!< check if resource is done preloading
+    template <typename T> bool isPreloaded(ResourceId id); //!< check if resource is done preloading
 
     bool loadOne(); //!< syncronously loads one resource that finished preloading, use for loading screens etc. return false if there is nothing to load anymore
 
     template <typename T> void forceReload(const std::string& path); //!< force reload a specific resource  race conditions might occur if resources simultaneously accessed in another thread
     template <typename T> void tryRelease(const std::string& path); //! releases resource, if it is not used anymore
+    template <typename T> void setArchive(std::shared_ptr<const ResourceArchive> archive, std::string prefix = ""); //!< load resources of type T from archive, paths are looked up with prefix prepended
     void forceReloadAll(); //!< reloads all resources
+    bool enableHotReload(std::chrono::milliseconds debounce = std::chrono::milliseconds(100)); //!< watch the files of loaded resources, returns false if that is not possible on this platform
+    void disableHotReload(); //!< stop watching files
+    std::size_t updateHotReload(); //!< starts reloading changed files and swaps in resources that finished reloading, returns the number of swapped resources
     void tryReleaseAll(); //!< removes all resources that are not used anymore
 
     int numLoaded(); //!< total number of loaded resources
 
+    template <typename T> void setSizeEstimator(std::function<std::size_t(const T&)> estimator); //!< estimates the memory used by resources of type T
+    template <typename T> void setMemoryBudget(std::size_t bytes); //!< memory budget for resources of type T, 0 means unlimited
+    void setMemoryBudget(std::size_t bytes); //!< memory budget for all resources together, 0 means unlimited
+    std::size_t getMemoryBudget() const {return m_memoryBudget;} //!< memory budget for all resources together
+    std::size_t memoryUsage(); //!< estimated memory used by all loaded resources
+    ResourceLoadSummary getLoadSummary(std::size_t slowestN = 10); //!< time spent loading the resources of all caches, with the slowestN slowest resources
+    std::size_t enforceMemoryBudget(); //!< evicts unused resources until all budgets are met, returns the memory freed. Is called regularly in the background once a budget is set
+    void setEvictionInterval(std::chrono::milliseconds interval); //!< how often the budgets are checked in the background, 0 stops the background tick
+
     template <typename T> auto& get(); //!< returns reference to the resource cache for resources of type T
 
-    int getNumThreads(); //!< number of threads that are used for background loading
-    void setNumThreads(int threads); //!< number of threads that are used for background loading
+    int getNumThreads(); //!< number of threads that are used for background decoding
+    void setNumThreads(int threads); //!< number of threads that are used for background decoding, disables automatic sizing of the pool
+    ThreadPool& getThreadPool() {return m_threadPool;} //!< the pool used for background decoding, eg to collect statistics
+    ThreadPool& getIoThreadPool() {return m_ioPool;} //!< the pool used to read files in the background
+    AsyncFileReader& getFileReader() {return m_fileReader;} //!< reads files using io_uring, if available
 
 private:
-    ThreadPool m_threadPool;
+    ThreadPool m_threadPool; //!< runs the compute heavy part of preloading
+    ThreadPool m_ioPool; //!< reads files, destroyed first as its tasks start tasks on m_threadPool
+    AsyncFileReader m_fileReader; //!< batches file reads of all caches if io_uring is available, destroyed before the pools
+
+    /**
+     * @brief state of the background tick enforcing memory budgets, shared with the timer task so a tick
+     *      dispatched while the manager is destroyed can detect that
+     */
+    struct EvictionTick
+    {
+        std::mutex mtx; //!< held while a tick runs
+        bool alive{true}; //!< false once the manager is destroyed
+        bool scheduled{false}; //!< a tick is scheduled
+        TimerService::TimerId timer{TimerService::invalidId};
+        std::chrono::milliseconds interval{250};
+    };
+    std::atomic<std::size_t> m_memoryBudget{0}; //!< budget of the whole manager
+    std::shared_ptr<EvictionTick> m_evictionTick{std::make_shared<EvictionTick>()};
+
+    std::shared_ptr<FileWatcher> m_fileWatcher; //!< watches files for hot reloading, nullptr if disabled
+    void scheduleEvictionTick(); //!< schedule the next tick, m_evictionTick->mtx needs to be locked
+    static void runEvictionTick(ResourceManager* rm, std::shared_ptr<EvictionTick> tick); //!< executed by the timer service
 
     using preloadTypes = std::tuple<typename CacheT::PreloadType ...>;
     std::tuple<std::unique_ptr<CacheT>...> m_caches;
@@ -91,27 +150,87 @@ private:
 
 template <typename... CacheT>
 ResourceManager<CacheT...>::ResourceManager( cacheCreationData<typename CacheT::ResourceType, typename CacheT::PreloadType> ... caches)
-    : m_threadPool(2), m_caches( std::make_unique<CacheT>( caches.asyncPreloadFunc,
+    : m_threadPool(1), m_ioPool(2), m_fileReader(m_ioPool), m_caches( std::make_unique<CacheT>( caches.asyncPreloadFunc,
                                                                 caches.syncLoadFunc,
                                                                 caches.workingDir,
-                                                                [](std::function<void()> f){ f();},
+                                                                [](std::function<void()> f, TaskPriority, CancellationToken){ f();},
                                                                 std::move(caches.defaultResource),
-                                                                caches.debugName) ... )
+                                                                caches.debugName,
+                                                                caches.asyncPreloadViewFunc) ... )
 {
-//    int t[] = {0, ((void)( std::get<std::unique_ptr<CacheT>>(m_caches)->setAddTaskFunc([this](std::function<void()> f)
+//    int t[] = {0, ((void)( std::get<std::unique_ptr<CacheT>>(m_caches)->setAddTaskFunc([this](std::function<void()> f, TaskPriority p, CancellationToken c)
 //                                                                                       {
-//                                                                                           this->m_threadPool.enqueue(f);
+//                                                                                           this->m_threadPool.post(p,c,f);
 //                                                                                       }) ),1)...};
 //    (void)t[0]; // silence compiler warning about t being unused
 
     // workaround for gcc bug
-    auto foo = [this](std::function<void()> f)
+    auto foo = [this](std::function<void()> f, TaskPriority priority, CancellationToken token)
+    {
+        this->m_ioPool.post(priority, std::move(token), std::move(f));
+    };
+    auto bar = [this](std::function<void()> f, TaskPriority priority, CancellationToken token)
     {
-        this->m_threadPool.enqueue(f);
+        this->m_threadPool.post(priority, std::move(token), std::move(f));
     };
 
-    int t[] = {0, ((void)( std::get<std::unique_ptr<CacheT>>(m_caches)->setAddTaskFunc(foo) ),1)...};
+    int t[] = {0, ((void)( std::get<std::unique_ptr<CacheT>>(m_caches)->setAddTaskFunc(foo),
+                           std::get<std::unique_ptr<CacheT>>(m_caches)->setAddComputeTaskFunc(bar) ),1)...};
     (void)t[0]; // silence compiler warning about t being unuse
+
+    // with io_uring the io pool only submits reads and the kernel reads many files at once,
+    // without it the reads block threads of the io pool, which grows as needed
+    if(m_fileReader.usesIoUring())
+    {
+        auto readFunc = [this](std::string path, std::function<void(std::string, std::exception_ptr)> onComplete)
+        {
+            this->m_fileReader.read(std::move(path), std::move(onComplete));
+        };
+        int r[] = {0, ((void)( std::get<std::unique_ptr<CacheT>>(m_caches)->setReadFileFunc(readFunc) ),1)...};
+        (void)r[0];
+    }
+
+    // reading is mostly waiting for the disk, so the io pool is allowed to grow beyond the number of cores when tasks block
+    AutoscalePolicy ioPolicy;
+    ioPolicy.minThreads = 2;
+    ioPolicy.maxThreads = 4 * std::max<std::size_t>(availableCores().size(), 1);
+    m_ioPool.setAutoscaling(ioPolicy);
+
+    // decoding is cpu bound, more threads than cores would only slow it down
+    AutoscalePolicy computePolicy;
+    computePolicy.maxThreads = std::max<std::size_t>(availableCores().size(), 1);
+    m_threadPool.setAutoscaling(computePolicy);
+}
+
+template <typename... CacheT>
+ResourceManager<CacheT...>::~ResourceManager()
+{
+    {
+        // waits for a running tick, one dispatched later will see that we are gone
+        std::lock_guard<std::mutex> lck(m_evictionTick->mtx);
+        m_evictionTick->alive = false;
+        if(m_evictionTick->scheduled)
+            globalTimerService().cancel(m_evictionTick->timer);
+    }
+
+    // tasks reference the caches, so they need to finish before the caches are destroyed
+    m_ioPool.waitUntilNothingInFlight();
+    m_fileReader.waitUntilIdle();
+    m_threadPool.waitUntilNothingInFlight();
+}
+
+template <typename... CacheT>
+template <typename T>
+ResourceId ResourceManager<CacheT...>::getId(const std::string& path)
+{
+    return get<T>().getId(path);
+}
+
+template <typename... CacheT>
+template <typename T>
+ResourceId ResourceManager<CacheT...>::getId(const ResourceKey& key)
+{
+    return get<T>().getId(key);
 }
 
 template <typename... CacheT>
@@ -123,9 +242,44 @@ std::shared_ptr<T> ResourceManager<CacheT...>::load(const std::string& path)
 
 template <typename... CacheT>
 template <typename T>
-void ResourceManager<CacheT...>::preload(const std::string& path)
+std::shared_ptr<T> ResourceManager<CacheT...>::load(ResourceId id)
+{
+    return get<T>().load(id);
+}
+
+template <typename... CacheT>
+template <typename T>
+std::shared_ptr<T> ResourceManager<CacheT...>::load(const ResourceKey& key)
 {
-    get<T>().preload(path);
+    return get<T>().load(key);
+}
+
+template <typename... CacheT>
+template <typename T>
+void ResourceManager<CacheT...>::preload(const std::string& path, TaskPriority priority)
+{
+    get<T>().preload(path, priority);
+}
+
+template <typename... CacheT>
+template <typename T>
+void ResourceManager<CacheT...>::preload(ResourceId id, TaskPriority priority)
+{
+    get<T>().preload(id, priority);
+}
+
+template <typename... CacheT>
+template <typename T>
+void ResourceManager<CacheT...>::preload(const ResourceKey& key, TaskPriority priority)
+{
+    get<T>().preload(key, priority);
+}
+
+template <typename... CacheT>
+template <typename T>
+bool ResourceManager<CacheT...>::cancelPreload(const std::string& path)
+{
+    return get<T>().cancelPreload(path);
 }
 
 template <typename... CacheT>
@@ -135,6 +289,13 @@ bool ResourceManager<CacheT...>::isReady(const std::string& path)
     return get<T>().isReady(path);
 }
 
+template <typename... CacheT>
+template <typename T>
+bool ResourceManager<CacheT...>::isReady(ResourceId id)
+{
+    return get<T>().isReady(id);
+}
+
 template <typename... CacheT>
 template <typename T>
 bool ResourceManager<CacheT...>::isPreloaded(const std::string& path)
@@ -142,6 +303,13 @@ bool ResourceManager<CacheT...>::isPreloaded(const std::string& path)
     return get<T>().isPreloaded(path);
 }
 
+template <typename... CacheT>
+template <typename T>
+bool ResourceManager<CacheT...>::isPreloaded(ResourceId id)
+{
+    return get<T>().isPreloaded(id);
+}
+
 template <typename... CacheT>
 template <typename T>
 void ResourceManager<CacheT...>::forceReload(const std::string& path)
@@ -156,6 +324,13 @@ void ResourceManager<CacheT...>::tryRelease(const std::string& path)
     get<T>().tryRelease(path);
 }
 
+template <typename... CacheT>
+template <typename T>
+void ResourceManager<CacheT...>::setArchive(std::shared_ptr<const ResourceArchive> archive, std::string prefix)
+{
+    get<T>().setArchive(std::move(archive), std::move(prefix));
+}
+
 template <typename... CacheT>
 int ResourceManager<CacheT...>::getNumThreads()
 {
@@ -165,7 +340,8 @@ int ResourceManager<CacheT...>::getNumThreads()
 template <typename... CacheT>
 void ResourceManager<CacheT...>::setNumThreads(int threads)
 {
-    logINFO("ResourceManager") << "Set number of loading threads to " << threads;
+    logINFO("ResourceManager") << "Set number of loading threads to " << threads << ", automatic sizing is disabled.";
+    m_threadPool.disableAutoscaling();
     m_threadPool.setPoolSize(threads);
 }
 
@@ -204,6 +380,50 @@ void ResourceManager<CacheT...>::forceReloadAll()
     (void)t[0]; // silence compiler warning about t being unused
 }
 
+template <typename... CacheT>
+bool ResourceManager<CacheT...>::enableHotReload(std::chrono::milliseconds debounce)
+{
+    if(!m_fileWatcher)
+        m_fileWatcher = std::make_shared<FileWatcher>(debounce);
+    else
+        m_fileWatcher->setDebounce(debounce);
+
+    if(!m_fileWatcher->isAvailable())
+    {
+        m_fileWatcher = nullptr;
+        return false;
+    }
+
+    int t[] = {0, ((void)( std::get<std::unique_ptr<CacheT>>(m_caches)->setFileWatcher(m_fileWatcher) ),1)...};
+    (void)t[0]; // silence compiler warning about t being unused
+    logINFO("ResourceManager") << "Hot reloading enabled, watching " << m_fileWatcher->numWatched() << " files.";
+    return true;
+}
+
+template <typename... CacheT>
+void ResourceManager<CacheT...>::disableHotReload()
+{
+    int t[] = {0, ((void)( std::get<std::unique_ptr<CacheT>>(m_caches)->setFileWatcher(nullptr) ),1)...};
+    (void)t[0]; // silence compiler warning about t being unused
+    m_fileWatcher = nullptr;
+}
+
+template <typename... CacheT>
+std::size_t ResourceManager<CacheT...>::updateHotReload()
+{
+    if(m_fileWatcher)
+    {
+        // every cache checks if the file belongs to one of its resources
+        for(const std::string& file : m_fileWatcher->poll())
+        {
+            int t[] = {0, ((void)( std::get<std::unique_ptr<CacheT>>(m_caches)->reloadFile(file) ),1)...};
+            (void)t[0]; // silence compiler warning about t being unused
+        }
+    }
+
+    return detail::varsum(std::get<std::unique_ptr<CacheT>>(m_caches)->finishReloads()...);
+}
+
 template <typename... CacheT>
 void ResourceManager<CacheT...>::tryReleaseAll()
 {
@@ -211,6 +431,131 @@ void ResourceManager<CacheT...>::tryReleaseAll()
     (void)t[0]; // silence compiler warning about t being unused
 }
 
+template <typename... CacheT>
+template <typename T>
+void ResourceManager<CacheT...>::setSizeEstimator(std::function<std::size_t(const T&)> estimator)
+{
+    get<T>().setSizeEstimator(std::move(estimator));
+}
+
+template <typename... CacheT>
+template <typename T>
+void ResourceManager<CacheT...>::setMemoryBudget(std::size_t bytes)
+{
+    get<T>().setMemoryBudget(bytes);
+    std::lock_guard<std::mutex> lck(m_evictionTick->mtx);
+    scheduleEvictionTick();
+}
+
+template <typename... CacheT>
+void ResourceManager<CacheT...>::setMemoryBudget(std::size_t bytes)
+{
+    m_memoryBudget = bytes;
+    std::lock_guard<std::mutex> lck(m_evictionTick->mtx);
+    scheduleEvictionTick();
+}
+
+template <typename... CacheT>
+std::size_t ResourceManager<CacheT...>::memoryUsage()
+{
+    return detail::varsum(std::get<std::unique_ptr<CacheT>>(m_caches)->memoryUsage()...);
+}
+
+template <typename... CacheT>
+std::size_t ResourceManager<CacheT...>::enforceMemoryBudget()
+{
+    std::size_t freed = detail::varsum(std::get<std::unique_ptr<CacheT>>(m_caches)->enforceBudget()...);
+
+    const std::size_t budget = m_memoryBudget;
+    std::size_t usage = memoryUsage();
+    if(budget == 0 || usage <= budget)
+        return freed;
+
+    // evict the least recently used resources of all caches together
+    struct Candidate
+    {
+        ResourceUsage usage;
+        std::function<std::size_t(const std::string&)> evict;
+    };
+    std::vector<Candidate> candidates;
+    auto collect = [&candidates](auto& cache)
+    {
+        for(ResourceUsage& r : cache.unusedResources())
+            candidates.push_back({std::move(r), [&cache](const std::string& path){ return cache.evict(path); }});
+    };
+    int t[] = {0, ((void)( collect(*std::get<std::unique_ptr<CacheT>>(m_caches)) ),1)...};
+    (void)t[0]; // silence compiler warning about t being unused
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b)
+    {
+        return a.usage.lastUsed < b.usage.lastUsed;
+    });
+
+    for(const Candidate& c : candidates)
+    {
+        if(usage <= budget)
+            break;
+        std::size_t f = c.evict(c.usage.path);
+        usage -= std::min(usage, f);
+        freed += f;
+    }
+    logDEBUG("ResourceManager") << "Evicted " << freed << " bytes to stay within the memory budget.";
+    return freed;
+}
+
+template <typename... CacheT>
+void ResourceManager<CacheT...>::setEvictionInterval(std::chrono::milliseconds interval)
+{
+    std::lock_guard<std::mutex> lck(m_evictionTick->mtx);
+    m_evictionTick->interval = interval;
+    if(m_evictionTick->scheduled && globalTimerService().cancel(m_evictionTick->timer))
+        m_evictionTick->scheduled = false;
+    scheduleEvictionTick();
+}
+
+template <typename... CacheT>
+void ResourceManager<CacheT...>::scheduleEvictionTick()
+{
+    EvictionTick& tick = *m_evictionTick;
+    if(!tick.alive || tick.scheduled || tick.interval.count() <= 0)
+        return;
+
+    // only tick if there is a budget to enforce
+    const std::size_t budgets = detail::varsum(std::get<std::unique_ptr<CacheT>>(m_caches)->getMemoryBudget()...);
+    if(m_memoryBudget == 0 && budgets == 0)
+        return;
+
+    // dispatched to the global pool, which outlives the manager
+    tick.scheduled = true;
+    tick.timer = globalTimerService().scheduleAfter(tick.interval,
+            [rm = this, t = m_evictionTick](){ runEvictionTick(rm, t); });
+}
+
+template <typename... CacheT>
+void ResourceManager<CacheT...>::runEvictionTick(ResourceManager* rm, std::shared_ptr<EvictionTick> tick)
+{
+    std::lock_guard<std::mutex> lck(tick->mtx);
+    if(!tick->alive)
+        return;
+    tick->scheduled = false;
+    try
+    {
+        rm->enforceMemoryBudget();
+    } catch(const std::exception& e)
+    {
+        logERROR("ResourceManager") << "Error while enforcing the memory budget: " << e.what();
+    }
+    rm->scheduleEvictionTick();
+}
+
+template <typename... CacheT>
+ResourceLoadSummary ResourceManager<CacheT...>::getLoadSummary(std::size_t slowestN)
+{
+    ResourceLoadSummary summary;
+    int t[] = {0, ((void)( summary.merge(std::get<std::unique_ptr<CacheT>>(m_caches)->getLoadSummary(slowestN), slowestN) ),1)...};
+    (void)t[0]; // silence compiler warning about t being unused
+    return summary;
+}
+
 template <typename... CacheT>
 int ResourceManager<CacheT...>::numLoaded()
 {
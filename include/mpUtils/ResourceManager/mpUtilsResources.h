@@ -15,6 +15,7 @@
 //--------------------
 #include "mpUtils/Misc/Image.h"
 #include "mpUtils/ResourceManager/ResourceCache.h"
+#include "mpUtils/ResourceManager/DecodedImageCache.h"
 //--------------------
 
 // namespace
@@ -29,19 +30,40 @@ namespace mpu {
 // example:
 // ResourceManager< ImageRC > resourceManager( {preloadImage,finalLoadImage, /*default path*/,
 //                                                      getDefaultImage(), /*name to show in ui*/} );
+// to decode images directly from a memory mapped file pass the *View function as the last member instead:
+// ResourceManager< ImageRC > resourceManager( {nullptr,finalLoadImage, /*default path*/,
+//                                                      getDefaultImage(), /*name to show in ui*/, preloadImageView} );
+// to keep decoded images on disk and skip decoding on the next run, bind a DecodedImageCache to the *Cached function:
+// ResourceManager< ImageRC > resourceManager( {nullptr,finalLoadImage, /*default path*/, getDefaultImage(), /*name to show in ui*/,
+//                                                      [&cache](DataView d){return preloadImageCached(cache,d);}} );
+
+/**
+ * @brief memory used by an image, for the memory budget of the resource manager
+ */
+template <typename T>
+std::size_t estimateResourceSize(const Image<T>& image)
+{
+    return sizeof(image) + image.length() * sizeof(T);
+}
 
 using ImageRC = ResourceCache<Image8,Image8>; //!< resource cache to use 8bit image with the resource manager
 std::unique_ptr<Image8> preloadImage(std::string data); //!< function to preload an 8bit image in the resource manager
+std::unique_ptr<Image8> preloadImageView(DataView data); //!< function to preload an 8bit image from a memory mapped file in the resource manager
+std::unique_ptr<Image8> preloadImageCached(DecodedImageCache& cache, DataView data); //!< function to preload an 8bit image from a memory mapped file, using the decoded image cache
 std::unique_ptr<Image8> finalLoadImage(std::unique_ptr<Image8> img); //!< finalize loading of a preloaded 8bit image in the resource manager
 std::unique_ptr<Image8> getDefaultImage(); //!< loads a default image to be passed to the resource manager
 
 using Image16RC = ResourceCache<Image16,Image16>; //!< resource cache to use 16bit image with the resource manager
 std::unique_ptr<Image16> preloadImage16(std::string data); //!< function to preload an 16bit image in the resource manager
+std::unique_ptr<Image16> preloadImage16View(DataView data); //!< function to preload an 16bit image from a memory mapped file in the resource manager
+std::unique_ptr<Image16> preloadImage16Cached(DecodedImageCache& cache, DataView data); //!< function to preload an 16bit image from a memory mapped file, using the decoded image cache
 std::unique_ptr<Image16> finalLoadImage16(std::unique_ptr<Image16> img); //!< finalize loading of a preloaded 16bit image in the resource manager
 std::unique_ptr<Image16> getDefaultImage16(); //!< loads a default image to be passed to the resource manager
 
 using Image32RC = ResourceCache<Image32,Image32>; //!< resource cache to use 32bit image with the resource manager
 std::unique_ptr<Image32> preloadImage32(std::string data); //!< function to preload an 32bit image in the resource manager
+std::unique_ptr<Image32> preloadImage32View(DataView data); //!< function to preload an 32bit image from a memory mapped file in the resource manager
+std::unique_ptr<Image32> preloadImage32Cached(DecodedImageCache& cache, DataView data); //!< function to preload an 32bit image from a memory mapped file, using the decoded image cache
 std::unique_ptr<Image32> finalLoadImage32(std::unique_ptr<Image32> img); //!< finalize loading of a preloaded 32bit image in the resource manager
 std::unique_ptr<Image32> getDefaultImage32(); //!< loads a default image to be passed to the resource manager
 
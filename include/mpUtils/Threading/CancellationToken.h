@@ -0,0 +1,51 @@
+/*
+ * mpUtils
+ * CancellationToken.h
+ *
+ * @author: Hendrik Schwanekamp
+ * @mail:   hendrik.schwanekamp@gmx.net
+ *
+ * Implements the CancellationToken class
+ *
+ * Copyright (c) 2021 Hendrik Schwanekamp
+ *
+ */
+
+#ifndef MPUTILS_CANCELLATIONTOKEN_H
+#define MPUTILS_CANCELLATIONTOKEN_H
+
+// includes
+//--------------------
+#include <memory>
+#include <atomic>
+//--------------------
+
+// namespace
+//--------------------
+namespace mpu {
+//--------------------
+
+//-------------------------------------------------------------------
+/**
+ * class CancellationToken
+ *
+ * A shared flag that signals that some work is no longer needed. Copies of a token share the same flag.
+ * Tasks posted to a ThreadPool together with a token are dropped without being executed if the token
+ * was cancelled before the task was started. Long running tasks can also check isCancelled() themselves
+ * to stop early.
+ *
+ */
+class CancellationToken
+{
+public:
+    CancellationToken() : m_cancelled(std::make_shared<std::atomic<bool>>(false)) {}
+
+    void cancel() {m_cancelled->store(true, std::memory_order_release);} //!< cancel all work associated with this token
+    bool isCancelled() const {return m_cancelled->load(std::memory_order_acquire);} //!< check if the token was cancelled
+
+private:
+    std::shared_ptr<std::atomic<bool>> m_cancelled;
+};
+
+}
+#endif //MPUTILS_CANCELLATIONTOKEN_H
@@ -0,0 +1,571 @@
+/*
+ * mpUtils
+ * Future.h
+ *
+ * @author: Hendrik Schwanekamp
+ * @mail:   hendrik.schwanekamp@gmx.net
+ *
+ * Implements the Future and Promise classes
+ *
+ * Copyright (c) 2021 Hendrik Schwanekamp
+ *
+ */
+
+#ifndef MPUTILS_FUTURE_H
+#define MPUTILS_FUTURE_H
+
+// includes
+//--------------------
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <future>
+#include <atomic>
+#include <vector>
+#include <type_traits>
+#include "mpUtils/Threading/UniqueTask.h"
+#include "mpUtils/Threading/globalThreadPool.h"
+#include "mpUtils/Log/Log.h"
+//--------------------
+
+// namespace
+//--------------------
+namespace mpu {
+//--------------------
+
+template <typename T> class Future;
+template <typename T> class Promise;
+
+// helper classes
+//-------------------------------------------------------------------
+namespace detail {
+
+    /**
+     * @brief stores the value of a future, without requiring it to be default constructible
+     */
+    template <typename T>
+    class FutureStorage
+    {
+    public:
+        FutureStorage() = default;
+        FutureStorage(const FutureStorage&) = delete;
+        FutureStorage& operator=(const FutureStorage&) = delete;
+        ~FutureStorage() { if(m_hasValue) reinterpret_cast<T*>(&m_buffer)->~T(); }
+
+        template <typename... Args>
+        void set(Args&&... args)
+        {
+            ::new(static_cast<void*>(&m_buffer)) T(std::forward<Args>(args)...);
+            m_hasValue = true;
+        }
+
+        T take() { return std::move(*reinterpret_cast<T*>(&m_buffer)); }
+
+    private:
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type m_buffer;
+        bool m_hasValue{false};
+    };
+
+    template <>
+    class FutureStorage<void>
+    {
+    public:
+        void set() {}
+        void take() {}
+    };
+
+    /**
+     * @brief state shared between a promise and its future
+     */
+    template <typename T>
+    class SharedState
+    {
+    public:
+        template <typename... Args>
+        void setValue(Args&&... args)
+        {
+            std::unique_lock<std::mutex> lck(m_mtx);
+            if(m_ready)
+                throw std::future_error(std::future_errc::promise_already_satisfied);
+            m_value.set(std::forward<Args>(args)...);
+            makeReady(lck);
+        }
+
+        void setException(std::exception_ptr e)
+        {
+            std::unique_lock<std::mutex> lck(m_mtx);
+            if(m_ready)
+                throw std::future_error(std::future_errc::promise_already_satisfied);
+            m_exception = std::move(e);
+            makeReady(lck);
+        }
+
+        bool isReady()
+        {
+            std::lock_guard<std::mutex> lck(m_mtx);
+            return m_ready;
+        }
+
+        void wait()
+        {
+            std::unique_lock<std::mutex> lck(m_mtx);
+            m_cv.wait(lck, [this]{ return m_ready; });
+        }
+
+        T take() //!< returns the value or rethrows the stored exception, state must be ready
+        {
+            std::lock_guard<std::mutex> lck(m_mtx);
+            if(m_exception)
+                std::rethrow_exception(m_exception);
+            return m_value.take();
+        }
+
+        void onReady(UniqueTask callback) //!< callback is called once the state is ready, immediately if it already is
+        {
+            std::unique_lock<std::mutex> lck(m_mtx);
+            if(m_ready)
+            {
+                lck.unlock();
+                callback();
+                return;
+            }
+
+            if(m_callback)
+                m_callback = UniqueTask([first = std::move(m_callback), second = std::move(callback)]() mutable
+                                        {
+                                            first();
+                                            second();
+                                        });
+            else
+                m_callback = std::move(callback);
+        }
+
+    private:
+        void makeReady(std::unique_lock<std::mutex>& lck)
+        {
+            m_ready = true;
+            UniqueTask callback = std::move(m_callback);
+            lck.unlock();
+            m_cv.notify_all();
+
+            if(callback)
+            {
+                try
+                {
+                    callback();
+                } catch(const std::exception& e)
+                {
+                    logERROR("Future") << "Exception while scheduling continuation: " << e.what();
+                }
+            }
+        }
+
+        std::mutex m_mtx;
+        std::condition_variable m_cv;
+        bool m_ready{false};
+        FutureStorage<T> m_value;
+        std::exception_ptr m_exception;
+        UniqueTask m_callback;
+    };
+
+    /**
+     * @brief gives the free functions in this file access to the shared state of a future
+     */
+    struct FutureAccess
+    {
+        template <typename T>
+        static const std::shared_ptr<SharedState<T>>& state(const Future<T>& f) { return f.m_state; }
+    };
+
+    // type of future returned by then() and runAsync(), a function returning Future<U> results in Future<U>
+    template <typename R> struct UnwrapFuture { using type = R; };
+    template <typename U> struct UnwrapFuture<Future<U>> { using type = U; };
+    template <typename R> using UnwrapFuture_t = typename UnwrapFuture<R>::type;
+
+    // result of calling a continuation with the value of a Future<T>
+    template <typename F, typename T> struct ContinuationResult { using type = std::result_of_t<F(T)>; };
+    template <typename F> struct ContinuationResult<F, void> { using type = std::result_of_t<F()>; };
+    template <typename F, typename T> using ContinuationResult_t = typename ContinuationResult<F,T>::type;
+
+    template <typename F, typename T>
+    decltype(auto) callWithValue(F& f, SharedState<T>& state) { return f(state.take()); }
+    template <typename F>
+    decltype(auto) callWithValue(F& f, SharedState<void>& state) { state.take(); return f(); }
+
+    template <typename U, typename G>
+    void fulfill(Promise<U>& promise, G& g, std::true_type /*void result*/, std::false_type)
+    {
+        g();
+        promise.setValue();
+    }
+
+    template <typename U, typename G>
+    void fulfill(Promise<U>& promise, G& g, std::false_type, std::false_type)
+    {
+        promise.setValue(g());
+    }
+
+    template <typename U, typename G>
+    void fulfill(Promise<U>& promise, G& g, std::false_type, std::true_type /*future result*/)
+    {
+        // forward the result of the returned future once it is available
+        std::shared_ptr<SharedState<U>> inner = FutureAccess::state(g());
+        if(!inner)
+            throw std::future_error(std::future_errc::no_state);
+        SharedState<U>* innerPtr = inner.get();
+        innerPtr->onReady(UniqueTask([inner = std::move(inner), promise = std::move(promise)]() mutable
+        {
+            try
+            {
+                auto take = [&]() -> U { return inner->take(); };
+                fulfill(promise, take, std::is_void<U>(), std::false_type());
+            } catch(...)
+            {
+                promise.setException(std::current_exception());
+            }
+        }));
+    }
+
+    /**
+     * @brief calls g and stores its result (or the exception thrown by it) in promise
+     */
+    template <typename U, typename G>
+    void fulfill(Promise<U>& promise, G& g)
+    {
+        using R = decltype(g());
+        try
+        {
+            fulfill(promise, g, std::is_void<R>(), std::integral_constant<bool, !std::is_same<R, UnwrapFuture_t<R>>::value>());
+        } catch(...)
+        {
+            promise.setException(std::current_exception());
+        }
+    }
+}
+
+//-------------------------------------------------------------------
+/**
+ * class Promise
+ *
+ * The sending side of a Future. Set a value or an exception exactly once. If the promise is destroyed
+ * without setting anything, the future receives a std::future_error (broken_promise).
+ *
+ */
+template <typename T>
+class Promise
+{
+public:
+    Promise() : m_state(std::make_shared<detail::SharedState<T>>()) {}
+    ~Promise();
+    Promise(Promise&& other) noexcept = default;
+    Promise& operator=(Promise&& other) noexcept;
+    Promise(const Promise&) = delete;
+    Promise& operator=(const Promise&) = delete;
+
+    Future<T> getFuture(); //!< returns the future associated with this promise, can only be called once
+
+    template <typename... Args>
+    void setValue(Args&&... args); //!< make the value available to the future (no arguments for Promise<void>)
+    void setException(std::exception_ptr e); //!< make the future rethrow e
+
+private:
+    std::shared_ptr<detail::SharedState<T>> m_state;
+    bool m_futureRetrieved{false};
+    bool m_satisfied{false};
+};
+
+//-------------------------------------------------------------------
+/**
+ * class Future
+ *
+ * A lightweight future that allows to attach continuations instead of blocking.
+ *
+ * usage:
+ * Get a future from a Promise or from runAsync(). Use then() to schedule a function that is called with the value
+ * once it is available. The function is posted to a ThreadPool, no thread waits for the value. then() returns
+ * a new future for the result of the function, which allows chains like read -> decode -> upload.
+ * If the function returns a Future<U> itself, the future returned by then() is a Future<U> that becomes
+ * ready once the inner future is ready.
+ * Exceptions are passed along the chain, continuations of a failed future are not called.
+ * Use when_all() and when_any() to combine multiple futures.
+ * get() and wait() are still available to block until the value is there.
+ * A future can only be consumed once, either by get() or then().
+ *
+ */
+template <typename T>
+class Future
+{
+public:
+    Future() = default; //!< constructs an invalid future
+    Future(Future&& other) noexcept = default;
+    Future& operator=(Future&& other) noexcept = default;
+    Future(const Future&) = delete;
+    Future& operator=(const Future&) = delete;
+
+    bool valid() const {return m_state != nullptr;} //!< check if the future refers to a shared state
+    bool isReady() const {return m_state && m_state->isReady();} //!< check if the value is available
+    void wait() const; //!< blocks until the value is available
+    T get(); //!< blocks until the value is available and returns it, rethrows exceptions. Invalidates the future.
+
+    /**
+     * @brief Posts f to pool once the value is available. f is called with the value (or without arguments
+     *      for Future<void>). Invalidates this future.
+     * @param f the continuation
+     * @param pool the ThreadPool to run f on, needs to outlive the future
+     * @param priority priority of the continuation in the pool
+     * @return future for the result of f
+     */
+    template <typename F>
+    auto then(F&& f, ThreadPool& pool = globalThreadPool(), TaskPriority priority = TaskPriority::normal)
+        -> Future<detail::UnwrapFuture_t<detail::ContinuationResult_t<std::decay_t<F>&, T>>>;
+
+private:
+    explicit Future(std::shared_ptr<detail::SharedState<T>> state) : m_state(std::move(state)) {}
+    std::shared_ptr<detail::SharedState<T>> m_state;
+
+    friend class Promise<T>;
+    friend struct detail::FutureAccess;
+};
+
+/**
+ * @brief result of when_any()
+ */
+template <typename T>
+struct WhenAnyResult
+{
+    std::size_t index; //!< index of the first future that became ready
+    std::vector<Future<T>> futures; //!< all futures passed to when_any
+};
+
+/**
+ * @brief Returns a future that becomes ready once all passed futures are ready. Its value are the passed futures,
+ *      which can be queried without blocking.
+ */
+template <typename T>
+Future<std::vector<Future<T>>> when_all(std::vector<Future<T>> futures);
+
+/**
+ * @brief Returns a future that becomes ready once one of the passed futures is ready. Its value contains the index
+ *      of that future and all the passed futures. Passing an empty vector results in an index of 0.
+ */
+template <typename T>
+Future<WhenAnyResult<T>> when_any(std::vector<Future<T>> futures);
+
+/**
+ * @brief Posts f to pool and returns a Future for its result.
+ */
+template <typename F>
+auto runAsync(F&& f, ThreadPool& pool = globalThreadPool(), TaskPriority priority = TaskPriority::normal)
+    -> Future<detail::UnwrapFuture_t<std::result_of_t<std::decay_t<F>&()>>>;
+
+/**
+ * @brief Returns a future that already holds value.
+ */
+template <typename T>
+Future<std::decay_t<T>> makeReadyFuture(T&& value);
+inline Future<void> makeReadyFuture();
+
+// template function definition
+//-------------------------------------------------------------------
+
+template <typename T>
+Promise<T>::~Promise()
+{
+    if(m_state && !m_satisfied)
+        m_state->setException(std::make_exception_ptr(std::future_error(std::future_errc::broken_promise)));
+}
+
+template <typename T>
+Promise<T>& Promise<T>::operator=(Promise&& other) noexcept
+{
+    if(this != &other)
+    {
+        Promise tmp(std::move(*this)); // breaks our old promise
+        m_state = std::move(other.m_state);
+        m_futureRetrieved = other.m_futureRetrieved;
+        m_satisfied = other.m_satisfied;
+    }
+    return *this;
+}
+
+template <typename T>
+Future<T> Promise<T>::getFuture()
+{
+    if(!m_state)
+        throw std::future_error(std::future_errc::no_state);
+    if(m_futureRetrieved)
+        throw std::future_error(std::future_errc::future_already_retrieved);
+    m_futureRetrieved = true;
+    return Future<T>(m_state);
+}
+
+template <typename T>
+template <typename... Args>
+void Promise<T>::setValue(Args&&... args)
+{
+    if(!m_state)
+        throw std::future_error(std::future_errc::no_state);
+    m_state->setValue(std::forward<Args>(args)...);
+    m_satisfied = true;
+}
+
+template <typename T>
+void Promise<T>::setException(std::exception_ptr e)
+{
+    if(!m_state)
+        throw std::future_error(std::future_errc::no_state);
+    m_state->setException(std::move(e));
+    m_satisfied = true;
+}
+
+template <typename T>
+void Future<T>::wait() const
+{
+    if(!m_state)
+        throw std::future_error(std::future_errc::no_state);
+    m_state->wait();
+}
+
+template <typename T>
+T Future<T>::get()
+{
+    wait();
+    std::shared_ptr<detail::SharedState<T>> state = std::move(m_state);
+    return state->take();
+}
+
+template <typename T>
+template <typename F>
+auto Future<T>::then(F&& f, ThreadPool& pool, TaskPriority priority)
+    -> Future<detail::UnwrapFuture_t<detail::ContinuationResult_t<std::decay_t<F>&, T>>>
+{
+    using U = detail::UnwrapFuture_t<detail::ContinuationResult_t<std::decay_t<F>&, T>>;
+    if(!m_state)
+        throw std::future_error(std::future_errc::no_state);
+
+    Promise<U> promise;
+    Future<U> result = promise.getFuture();
+
+    std::shared_ptr<detail::SharedState<T>> state = std::move(m_state);
+    detail::SharedState<T>* statePtr = state.get();
+    statePtr->onReady(UniqueTask(
+        [state = std::move(state), f = std::decay_t<F>(std::forward<F>(f)), promise = std::move(promise), &pool, priority]() mutable
+        {
+            // if posting fails the task is destroyed and the promise reports broken_promise
+            pool.post(priority, [state = std::move(state), f = std::move(f), promise = std::move(promise)]() mutable
+            {
+                auto g = [&]() -> decltype(auto) { return detail::callWithValue(f, *state); };
+                detail::fulfill(promise, g);
+            });
+        }));
+    return result;
+}
+
+template <typename T>
+Future<std::vector<Future<T>>> when_all(std::vector<Future<T>> futures)
+{
+    struct AllState
+    {
+        std::atomic<std::size_t> remaining;
+        std::vector<Future<T>> futures;
+        Promise<std::vector<Future<T>>> promise;
+    };
+
+    auto all = std::make_shared<AllState>();
+    Future<std::vector<Future<T>>> result = all->promise.getFuture();
+    if(futures.empty())
+    {
+        all->promise.setValue(std::move(futures));
+        return result;
+    }
+
+    // keep the states, the futures might be moved into the promise while we are still registering callbacks
+    std::vector<std::shared_ptr<detail::SharedState<T>>> states;
+    states.reserve(futures.size());
+    for(const auto& f : futures)
+    {
+        if(!f.valid())
+            throw std::future_error(std::future_errc::no_state);
+        states.push_back(detail::FutureAccess::state(f));
+    }
+
+    all->remaining = futures.size();
+    all->futures = std::move(futures);
+    for(auto& s : states)
+        s->onReady(UniqueTask([all]()
+        {
+            if(all->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                all->promise.setValue(std::move(all->futures));
+        }));
+    return result;
+}
+
+template <typename T>
+Future<WhenAnyResult<T>> when_any(std::vector<Future<T>> futures)
+{
+    struct AnyState
+    {
+        std::atomic<bool> done{false};
+        std::vector<Future<T>> futures;
+        Promise<WhenAnyResult<T>> promise;
+    };
+
+    auto any = std::make_shared<AnyState>();
+    Future<WhenAnyResult<T>> result = any->promise.getFuture();
+    if(futures.empty())
+    {
+        any->promise.setValue(WhenAnyResult<T>{0, std::move(futures)});
+        return result;
+    }
+
+    std::vector<std::shared_ptr<detail::SharedState<T>>> states;
+    states.reserve(futures.size());
+    for(const auto& f : futures)
+    {
+        if(!f.valid())
+            throw std::future_error(std::future_errc::no_state);
+        states.push_back(detail::FutureAccess::state(f));
+    }
+
+    any->futures = std::move(futures);
+    for(std::size_t i = 0; i < states.size(); ++i)
+        states[i]->onReady(UniqueTask([any, i]()
+        {
+            if(!any->done.exchange(true, std::memory_order_acq_rel))
+                any->promise.setValue(WhenAnyResult<T>{i, std::move(any->futures)});
+        }));
+    return result;
+}
+
+template <typename F>
+auto runAsync(F&& f, ThreadPool& pool, TaskPriority priority)
+    -> Future<detail::UnwrapFuture_t<std::result_of_t<std::decay_t<F>&()>>>
+{
+    using U = detail::UnwrapFuture_t<std::result_of_t<std::decay_t<F>&()>>;
+    Promise<U> promise;
+    Future<U> result = promise.getFuture();
+    pool.post(priority, [f = std::decay_t<F>(std::forward<F>(f)), promise = std::move(promise)]() mutable
+    {
+        detail::fulfill(promise, f);
+    });
+    return result;
+}
+
+template <typename T>
+Future<std::decay_t<T>> makeReadyFuture(T&& value)
+{
+    Promise<std::decay_t<T>> promise;
+    promise.setValue(std::forward<T>(value));
+    return promise.getFuture();
+}
+
+inline Future<void> makeReadyFuture()
+{
+    Promise<void> promise;
+    promise.setValue();
+    return promise.getFuture();
+}
+
+}
+#endif //MPUTILS_FUTURE_H
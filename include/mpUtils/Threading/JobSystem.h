@@ -0,0 +1,209 @@
+/*
+ * mpUtils
+ * JobSystem.h
+ *
+ * @author: Hendrik Schwanekamp
+ * @mail:   hendrik.schwanekamp@gmx.net
+ *
+ * Implements the JobSystem and JobCounter classes
+ *
+ * Copyright (c) 2021 Hendrik Schwanekamp
+ *
+ */
+
+#ifndef MPUTILS_JOBSYSTEM_H
+#define MPUTILS_JOBSYSTEM_H
+
+// includes
+//--------------------
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <algorithm>
+#include "mpUtils/Threading/UniqueTask.h"
+#include "mpUtils/Threading/concurrent/MpmcQueue.h"
+#include "mpUtils/Threading/concurrent/Semaphore.h"
+#include "mpUtils/Threading/concurrent/futex.h"
+//--------------------
+
+// namespace
+//--------------------
+namespace mpu {
+//--------------------
+
+//-------------------------------------------------------------------
+/**
+ * class JobCounter
+ *
+ * Sync point for jobs of the JobSystem. Every job submitted with a counter increments it,
+ * and decrements it once it finished. Wait on the counter with JobSystem::waitFor().
+ * A counter can be reused as soon as it reached zero. It must outlive all jobs using it.
+ *
+ */
+class JobCounter
+{
+public:
+    JobCounter() = default;
+    JobCounter(const JobCounter&) = delete;
+    JobCounter& operator=(const JobCounter&) = delete;
+
+    bool isDone() const {return m_value.load(std::memory_order_acquire) == 0;} //!< check if all jobs are done
+    uint32_t value() const {return m_value.load(std::memory_order_relaxed);} //!< number of unfinished jobs
+
+private:
+    friend class JobSystem;
+    void add(uint32_t n) {m_value.fetch_add(n, std::memory_order_relaxed);}
+    void decrement()
+    {
+        if(m_value.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            concurrent::futexWakeAll(&m_value);
+    }
+
+    std::atomic<uint32_t> m_value{0};
+};
+
+//-------------------------------------------------------------------
+/**
+ * class JobSystem
+ *
+ * Runs small jobs on a set of dedicated worker threads, meant for per frame cpu work
+ * like transform updates, culling or sprite batching.
+ * Compared to the ThreadPool there are no futures and no mutex: jobs are kept in a lock free queue,
+ * and synchronization is done with JobCounters. A thread waiting on a counter does not block,
+ * it runs queued jobs until the counter reaches zero ("help while wait"), so the main thread takes part in the work.
+ *
+ * usage:
+ * Submit a single job with run(counter, f) or a whole batch with runBatch(counter, n, f), which calls f(i) for all
+ * i in [0,n) split into jobs of grainSize indices and wakes the workers only once. Then call waitFor(counter).
+ * Jobs can submit more jobs. Small callables are stored without memory allocation.
+ *
+ * All jobs are also tracked per frame. endFrame() waits until every job submitted since beginFrame() finished.
+ * syncWithFrameLoop(window) calls beginFrame() and endFrame() from the frameBegin / frameEnd callbacks of a Window,
+ * so jobs of one frame never overlap the rendering of the next one (eg Renderer2D::render()).
+ *
+ * Exceptions thrown by jobs are logged and discarded.
+ *
+ */
+class JobSystem
+{
+public:
+    explicit JobSystem(std::size_t numThreads = std::max(2u, std::thread::hardware_concurrency()) - 1,
+                       std::size_t queueCapacity = 4096); //!< numThreads workers are started in addition to the calling thread
+    ~JobSystem(); //!< waits for all jobs and stops the workers
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    template <typename F>
+    void run(JobCounter& counter, F&& f); //!< run f() as a job, counter is decremented when it finishes
+    template <typename F>
+    void run(F&& f); //!< run f() as a job, only tracked by the frame
+
+    template <typename F>
+    void runBatch(JobCounter& counter, std::size_t count, F&& f, std::size_t grainSize = 0); //!< call f(i) for all i in [0,count), grainSize 0 selects automatically
+    template <typename F>
+    void runBatch(std::size_t count, F&& f, std::size_t grainSize = 0); //!< call f(i) for all i in [0,count), only tracked by the frame
+
+    void waitFor(const JobCounter& counter); //!< runs queued jobs until counter reaches zero
+
+    void beginFrame(); //!< start a new frame, the previous one must have ended
+    void endFrame(); //!< runs queued jobs until all jobs submitted during this frame are done
+    template <typename WindowT>
+    void syncWithFrameLoop(WindowT& window); //!< call beginFrame() and endFrame() from the frame callbacks of window, window must outlive the job system
+
+    std::size_t numThreads() const {return m_workers.size();} //!< number of worker threads
+
+private:
+    struct Job
+    {
+        UniqueTask task;
+        JobCounter* counter{nullptr};
+    };
+
+    void submit(UniqueTask&& task, JobCounter* counter); //!< push a single job and wake one worker
+    void push(UniqueTask&& task, JobCounter* counter); //!< push a single job without waking a worker
+    void execute(Job& job);
+    bool runOne(); //!< run one queued job, returns false if the queue is empty
+    void workerLoop();
+
+    template <typename F>
+    void submitBatch(JobCounter* counter, std::size_t count, F&& f, std::size_t grainSize);
+
+    concurrent::MpmcQueue<Job> m_queue;
+    concurrent::Semaphore m_jobsAvailable;
+    JobCounter m_frameCounter;
+    std::atomic<bool> m_frameRunning{false};
+    std::atomic<bool> m_stop{false};
+    std::vector<std::thread> m_workers;
+    std::function<void()> m_detachFromWindow;
+};
+
+// template function definition
+//-------------------------------------------------------------------
+
+template <typename F>
+void JobSystem::run(JobCounter& counter, F&& f)
+{
+    submit(UniqueTask(std::forward<F>(f)), &counter);
+}
+
+template <typename F>
+void JobSystem::run(F&& f)
+{
+    submit(UniqueTask(std::forward<F>(f)), nullptr);
+}
+
+template <typename F>
+void JobSystem::runBatch(JobCounter& counter, std::size_t count, F&& f, std::size_t grainSize)
+{
+    submitBatch(&counter, count, std::forward<F>(f), grainSize);
+}
+
+template <typename F>
+void JobSystem::runBatch(std::size_t count, F&& f, std::size_t grainSize)
+{
+    submitBatch(nullptr, count, std::forward<F>(f), grainSize);
+}
+
+template <typename F>
+void JobSystem::submitBatch(JobCounter* counter, std::size_t count, F&& f, std::size_t grainSize)
+{
+    if(count == 0)
+        return;
+    if(grainSize == 0)
+        grainSize = std::max<std::size_t>(1, count / ((m_workers.size() + 1) * 4));
+    const std::size_t numJobs = (count + grainSize - 1) / grainSize;
+
+    // all jobs of the batch share one copy of f
+    auto func = std::make_shared<std::decay_t<F>>(std::forward<F>(f));
+    for(std::size_t j = 0; j < numJobs; ++j)
+    {
+        const std::size_t begin = j * grainSize;
+        const std::size_t end = std::min(count, begin + grainSize);
+        push(UniqueTask([func, begin, end]()
+        {
+            for(std::size_t i = begin; i < end; ++i)
+                (*func)(i);
+        }), counter);
+    }
+    m_jobsAvailable.release(static_cast<uint32_t>(std::min(numJobs, m_workers.size())));
+}
+
+template <typename WindowT>
+void JobSystem::syncWithFrameLoop(WindowT& window)
+{
+    if(m_detachFromWindow)
+        m_detachFromWindow();
+
+    int beginId = window.addFrameBeginCallback([this](){ beginFrame(); });
+    int endId = window.addFrameEndCallback([this](){ endFrame(); });
+    m_detachFromWindow = [&window, beginId, endId]()
+    {
+        window.removeFrameBeginCallback(beginId);
+        window.removeFrameEndCallback(endId);
+    };
+}
+
+}
+#endif //MPUTILS_JOBSYSTEM_H
@@ -0,0 +1,409 @@
+/*
+ * mpUtils
+ * Pipeline.h
+ *
+ * @author: Hendrik Schwanekamp
+ * @mail:   hendrik.schwanekamp@gmx.net
+ *
+ * Implements the Pipeline class
+ *
+ * Copyright (c) 2021 Hendrik Schwanekamp
+ *
+ */
+
+#ifndef MPUTILS_PIPELINE_H
+#define MPUTILS_PIPELINE_H
+
+// includes
+//--------------------
+#include <deque>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <exception>
+#include <type_traits>
+#include <utility>
+//--------------------
+
+// namespace
+//--------------------
+namespace mpu {
+//--------------------
+
+/**
+ * @brief how the items passing through a stage of a Pipeline are processed
+ */
+enum class StageMode
+{
+    serial,         //!< one worker, items are processed one after another in the order they arrive
+    parallel,       //!< multiple workers, items leave the stage in the order they are finished
+    parallelOrdered //!< multiple workers, items leave the stage in the order they arrived
+};
+
+template <typename In, typename Out = In> class Pipeline;
+
+// helper classes
+//-------------------------------------------------------------------
+namespace detail {
+
+    /**
+     * @brief type returned by a stage function F called with an item of type T
+     */
+    template <typename F, typename T>
+    using StageResult_t = std::decay_t<decltype(std::declval<F&>()(std::declval<T>()))>;
+
+    /**
+     * @brief interface of the queues between the stages of a pipeline
+     */
+    class PipelineChannelBase
+    {
+    public:
+        virtual ~PipelineChannelBase() = default;
+        virtual void close() = 0; //!< no more items will be pushed, consumers finish once the channel is empty
+        virtual void cancel() = 0; //!< drop all items, all waiting threads return
+    };
+
+    /**
+     * @brief bounded blocking fifo queue that connects two stages of a pipeline
+     */
+    template <typename T>
+    class PipelineChannel : public PipelineChannelBase
+    {
+    public:
+        explicit PipelineChannel(std::size_t capacity) : m_capacity(capacity > 0 ? capacity : 1) {}
+
+        bool push(T&& item) //!< blocks while the channel is full, returns false if it was cancelled
+        {
+            std::unique_lock<std::mutex> lck(m_mtx);
+            m_notFull.wait(lck, [this]{ return m_items.size() < m_capacity || m_cancelled; });
+            if(m_cancelled)
+                return false;
+            m_items.push_back(std::move(item));
+            m_notEmpty.notify_one();
+            return true;
+        }
+
+        bool pop(T& item, uint64_t& sequence) //!< blocks while the channel is empty, returns false once it is closed and empty or cancelled
+        {
+            std::unique_lock<std::mutex> lck(m_mtx);
+            m_notEmpty.wait(lck, [this]{ return !m_items.empty() || m_closed || m_cancelled; });
+            if(m_cancelled || m_items.empty())
+                return false;
+            item = std::move(m_items.front());
+            m_items.pop_front();
+            sequence = m_numPopped++;
+            m_notFull.notify_one();
+            return true;
+        }
+
+        void close() override
+        {
+            std::lock_guard<std::mutex> lck(m_mtx);
+            m_closed = true;
+            m_notEmpty.notify_all();
+        }
+
+        void cancel() override
+        {
+            std::lock_guard<std::mutex> lck(m_mtx);
+            m_cancelled = true;
+            m_items.clear();
+            m_notEmpty.notify_all();
+            m_notFull.notify_all();
+        }
+
+    private:
+        const std::size_t m_capacity;
+        std::deque<T> m_items;
+        uint64_t m_numPopped{0};
+        bool m_closed{false};
+        bool m_cancelled{false};
+        std::mutex m_mtx;
+        std::condition_variable m_notFull;
+        std::condition_variable m_notEmpty;
+    };
+
+    /**
+     * @brief lets the workers of an ordered stage pass on their results in the order of the sequence numbers
+     */
+    class PipelineOrderGate
+    {
+    public:
+        bool waitForTurn(uint64_t sequence); //!< blocks until it is the turn of sequence, returns false if the pipeline was cancelled
+        void done(); //!< passes the turn to the next sequence number
+        void cancel(); //!< wakes all waiting threads
+
+    private:
+        uint64_t m_next{0};
+        bool m_cancelled{false};
+        std::mutex m_mtx;
+        std::condition_variable m_cv;
+    };
+
+    /**
+     * @brief threads, channels and error state shared by all stages of a pipeline
+     */
+    class PipelineState
+    {
+    public:
+        explicit PipelineState(std::size_t capacity) : capacity(capacity) {}
+        ~PipelineState(); //!< cancels and joins all threads
+
+        void fail(std::exception_ptr e); //!< store the first exception and cancel the pipeline
+        void cancel(); //!< cancel all channels and order gates
+        void addChannel(std::shared_ptr<PipelineChannelBase> channel); //!< register a channel, it is cancelled right away if the pipeline was cancelled
+        void addGate(std::shared_ptr<PipelineOrderGate> gate); //!< register an order gate, it is cancelled right away if the pipeline was cancelled
+        std::shared_ptr<PipelineChannelBase> lastChannel(); //!< the channel that was added last
+        void join(); //!< wait for all worker threads
+        void rethrow(); //!< rethrow the first exception that was thrown by a stage
+        bool isCancelled() const {return m_cancelled.load();}
+
+        const std::size_t capacity; //!< capacity of each channel
+        std::vector<std::thread> threads; //!< only accessed by the thread building and finishing the pipeline
+
+    private:
+        // workers of earlier stages might cancel the pipeline while stages are added, so these are protected by m_mtx
+        std::vector<std::shared_ptr<PipelineChannelBase>> m_channels;
+        std::vector<std::shared_ptr<PipelineOrderGate>> m_gates;
+
+        std::atomic<bool> m_cancelled{false};
+        std::exception_ptr m_exception;
+        std::mutex m_mtx;
+    };
+}
+
+//-------------------------------------------------------------------
+/**
+ * class Pipeline
+ *
+ * Processes a stream of items through a series of stages which are connected by bounded queues.
+ * Each stage has its own worker threads. When a queue is full the stage in front of it blocks, so no matter how
+ * many items are pushed, only a limited amount of them is in memory at any time (backpressure).
+ * Stages can be serial, parallel, or parallel while preserving the order of items.
+ *
+ * usage:
+ * Create a Pipeline<In> with the capacity of the queues, then add stages with then(). Each stage function
+ * takes the output of the previous stage and returns the input for the next one. A stage returning void is a sink
+ * and ends the pipeline. Workers start immediately. Feed items with push(), which blocks while the first queue
+ * is full. Call finish() when all items are pushed, it waits until everything is processed.
+ * If the last stage is not a sink, read the results with pop() until it returns false, then call finish().
+ *
+ * eg:
+ * auto pipeline = Pipeline<std::string>(8)
+ *          .then(StageMode::parallel, [](std::string file){ return std::make_pair(file, Image8(file)); }, 4)
+ *          .then(StageMode::parallel, [](auto img){ return std::make_pair(img.first, filter(Image32(img.second))); }, 4)
+ *          .then(StageMode::serial, [](auto img){ img.second.storePNG(img.first + ".out.png"); });
+ * for(auto& file : files)
+ *      pipeline.push(file);
+ * pipeline.finish();
+ *
+ * Item types need to be default constructible and movable. If a stage throws, the pipeline is cancelled,
+ * remaining items are dropped and finish() rethrows the exception. Destroying a pipeline that is not finished
+ * cancels it and waits for the workers to stop.
+ *
+ */
+template <typename In, typename Out>
+class Pipeline
+{
+public:
+    explicit Pipeline(std::size_t capacity = 16); //!< create an empty pipeline, capacity is the size of each queue
+    Pipeline(Pipeline&& other) noexcept = default;
+    Pipeline& operator=(Pipeline&& other) noexcept = default;
+    Pipeline(const Pipeline&) = delete;
+    Pipeline& operator=(const Pipeline&) = delete;
+
+    /**
+     * @brief Adds a stage which calls f for every item. The returned pipeline replaces this one.
+     * @param mode how items are processed
+     * @param f function called for each item, returning void makes the stage a sink
+     * @param numWorkers number of worker threads, ignored for serial stages
+     */
+    template <typename F>
+    Pipeline<In, detail::StageResult_t<F, Out>> then(StageMode mode, F f, std::size_t numWorkers = 1);
+
+    bool push(In item); //!< adds an item, blocks while the first queue is full, returns false if the pipeline was cancelled
+    template <typename T = Out, std::enable_if_t<!std::is_void<T>::value, int> = 0>
+    bool pop(T& item); //!< get a result of the last stage, blocks until one is available, returns false once all items are done
+    void closeInput(); //!< signals that no more items will be pushed
+    void finish(); //!< closes the input, waits until all items are processed and rethrows exceptions from stages
+    void cancel(); //!< drops all items and stops the workers
+
+private:
+    template <typename, typename> friend class Pipeline;
+    Pipeline(std::unique_ptr<detail::PipelineState> state, std::shared_ptr<detail::PipelineChannel<In>> input,
+             std::shared_ptr<detail::PipelineChannel<Out>> output);
+
+    std::unique_ptr<detail::PipelineState> m_state;
+    std::shared_ptr<detail::PipelineChannel<In>> m_input;
+    std::shared_ptr<detail::PipelineChannel<Out>> m_output; //!< nullptr once the pipeline ends in a sink
+};
+
+// helper functions
+//-------------------------------------------------------------------
+namespace detail {
+
+    // create the output channel of a stage
+    template <typename T, std::enable_if_t<!std::is_void<T>::value, int> = 0>
+    std::shared_ptr<PipelineChannel<T>> makeChannel(PipelineState& state)
+    {
+        auto channel = std::make_shared<PipelineChannel<T>>(state.capacity);
+        state.addChannel(channel);
+        return channel;
+    }
+
+    // a sink has no output channel, closing the input channel again does no harm
+    template <typename T, std::enable_if_t<std::is_void<T>::value, int> = 0>
+    std::shared_ptr<PipelineChannel<T>> makeChannel(PipelineState&)
+    {
+        return nullptr;
+    }
+
+    // pass the result of f to the next stage
+    template <typename Out, typename F, typename T>
+    bool runStage(F& f, T&& item, PipelineChannel<Out>* output, PipelineOrderGate* gate, uint64_t sequence)
+    {
+        Out result = f(std::forward<T>(item));
+        if(gate && !gate->waitForTurn(sequence))
+            return false;
+        bool ok = output->push(std::move(result));
+        if(gate)
+            gate->done();
+        return ok;
+    }
+
+    // sink stage without output
+    template <typename Out, typename F, typename T, std::enable_if_t<std::is_void<Out>::value, int> = 0>
+    bool runSink(F& f, T&& item, PipelineOrderGate* gate, uint64_t sequence)
+    {
+        if(gate && !gate->waitForTurn(sequence))
+            return false;
+        f(std::forward<T>(item));
+        if(gate)
+            gate->done();
+        return true;
+    }
+
+    template <typename Out, typename F, typename T>
+    std::enable_if_t<!std::is_void<Out>::value, bool> processItem(F& f, T&& item, PipelineChannel<Out>* output,
+                                                                   PipelineOrderGate* gate, uint64_t sequence)
+    {
+        return runStage<Out>(f, std::forward<T>(item), output, gate, sequence);
+    }
+
+    template <typename Out, typename F, typename T>
+    std::enable_if_t<std::is_void<Out>::value, bool> processItem(F& f, T&& item, PipelineChannel<Out>*,
+                                                                  PipelineOrderGate* gate, uint64_t sequence)
+    {
+        return runSink<Out>(f, std::forward<T>(item), gate, sequence);
+    }
+}
+
+// template function definition
+//-------------------------------------------------------------------
+
+template <typename In, typename Out>
+Pipeline<In, Out>::Pipeline(std::size_t capacity)
+    : m_state(std::make_unique<detail::PipelineState>(capacity)),
+      m_input(std::make_shared<detail::PipelineChannel<In>>(capacity)),
+      m_output(m_input)
+{
+    m_state->addChannel(m_input);
+}
+
+template <typename In, typename Out>
+Pipeline<In, Out>::Pipeline(std::unique_ptr<detail::PipelineState> state,
+                            std::shared_ptr<detail::PipelineChannel<In>> input,
+                            std::shared_ptr<detail::PipelineChannel<Out>> output)
+    : m_state(std::move(state)), m_input(std::move(input)), m_output(std::move(output))
+{
+}
+
+template <typename In, typename Out>
+template <typename F>
+Pipeline<In, detail::StageResult_t<F, Out>> Pipeline<In, Out>::then(StageMode mode, F f, std::size_t numWorkers)
+{
+    using Result = detail::StageResult_t<F, Out>;
+    static_assert(!std::is_void<Out>::value, "Can not add a stage after a sink.");
+
+    if(mode == StageMode::serial || numWorkers == 0)
+        numWorkers = 1;
+
+    std::shared_ptr<detail::PipelineChannel<Result>> output = detail::makeChannel<Result>(*m_state);
+    std::shared_ptr<detail::PipelineChannelBase> outputBase = m_state->lastChannel();
+
+    std::shared_ptr<detail::PipelineOrderGate> gate;
+    if(mode == StageMode::parallelOrdered && numWorkers > 1)
+    {
+        gate = std::make_shared<detail::PipelineOrderGate>();
+        m_state->addGate(gate);
+    }
+
+    auto func = std::make_shared<F>(std::move(f));
+    auto activeWorkers = std::make_shared<std::atomic<std::size_t>>(numWorkers);
+    auto input = m_output;
+    detail::PipelineState* state = m_state.get();
+
+    for(std::size_t i = 0; i < numWorkers; ++i)
+    {
+        m_state->threads.emplace_back([state, func, input, output, outputBase, gate, activeWorkers]()
+        {
+            Out item;
+            uint64_t sequence;
+            try
+            {
+                while(input->pop(item, sequence))
+                    if(!detail::processItem<Result>(*func, std::move(item), output.get(), gate.get(), sequence))
+                        break;
+            } catch(...)
+            {
+                state->fail(std::current_exception());
+            }
+
+            // the last worker to leave tells the next stage that no more items will come
+            if(activeWorkers->fetch_sub(1) == 1)
+                outputBase->close();
+        });
+    }
+
+    return Pipeline<In, Result>(std::move(m_state), std::move(m_input), std::move(output));
+}
+
+template <typename In, typename Out>
+bool Pipeline<In, Out>::push(In item)
+{
+    return m_input->push(std::move(item));
+}
+
+template <typename In, typename Out>
+template <typename T, std::enable_if_t<!std::is_void<T>::value, int>>
+bool Pipeline<In, Out>::pop(T& item)
+{
+    uint64_t sequence;
+    return m_output->pop(item, sequence);
+}
+
+template <typename In, typename Out>
+void Pipeline<In, Out>::closeInput()
+{
+    m_input->close();
+}
+
+template <typename In, typename Out>
+void Pipeline<In, Out>::finish()
+{
+    closeInput();
+    m_state->join();
+    m_state->rethrow();
+}
+
+template <typename In, typename Out>
+void Pipeline<In, Out>::cancel()
+{
+    m_state->cancel();
+}
+
+}
+#endif //MPUTILS_PIPELINE_H
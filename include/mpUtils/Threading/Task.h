@@ -0,0 +1,351 @@
+/*
+ * mpUtils
+ * Task.h
+ *
+ * @author: Hendrik Schwanekamp
+ * @mail:   hendrik.schwanekamp@gmx.net
+ *
+ * Implements the Task class, a coroutine type that runs on the ThreadPool
+ *
+ * Copyright (c) 2021 Hendrik Schwanekamp
+ *
+ */
+
+#ifndef MPUTILS_TASK_H
+#define MPUTILS_TASK_H
+
+// coroutines need C++20, the rest of the library only needs C++14
+// so the content of this file is only available when compiling with coroutine support
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#define MPU_COROUTINES_AVAILABLE
+
+// includes
+//--------------------
+#include <coroutine>
+#include <optional>
+#include <exception>
+#include <chrono>
+#include "mpUtils/Threading/Future.h"
+#include "mpUtils/Timer/TimerService.h"
+#include "mpUtils/Threading/globalThreadPool.h"
+#include "mpUtils/ResourceManager/AsyncFileReader.h"
+//--------------------
+
+// namespace
+//--------------------
+namespace mpu {
+//--------------------
+
+template <typename T = void> class Task;
+
+// helper classes
+//-------------------------------------------------------------------
+namespace detail {
+
+    /**
+     * @brief when a task finishes, resume the coroutine that awaited it
+     */
+    struct TaskFinalAwaiter
+    {
+        bool await_ready() noexcept {return false;}
+        template <typename P>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept
+        {
+            std::coroutine_handle<> continuation = h.promise().continuation;
+            return continuation ? continuation : std::noop_coroutine();
+        }
+        void await_resume() noexcept {}
+    };
+
+    struct TaskPromiseBase
+    {
+        std::suspend_always initial_suspend() noexcept {return {};}
+        TaskFinalAwaiter final_suspend() noexcept {return {};}
+        void unhandled_exception() noexcept {exception = std::current_exception();}
+
+        std::coroutine_handle<> continuation; //!< the coroutine awaiting this task
+        std::exception_ptr exception;
+    };
+
+    template <typename T>
+    struct TaskPromise : TaskPromiseBase
+    {
+        Task<T> get_return_object() noexcept;
+
+        template <typename U>
+        void return_value(U&& v) {value.emplace(std::forward<U>(v));}
+
+        T result()
+        {
+            if(exception)
+                std::rethrow_exception(exception);
+            return std::move(*value);
+        }
+
+        std::optional<T> value;
+    };
+
+    template <>
+    struct TaskPromise<void> : TaskPromiseBase
+    {
+        Task<void> get_return_object() noexcept;
+        void return_void() noexcept {}
+
+        void result()
+        {
+            if(exception)
+                std::rethrow_exception(exception);
+        }
+    };
+
+    /**
+     * @brief coroutine that starts immediately and destroys itself when done, used to run a Task from normal code
+     */
+    struct DetachedCoroutine
+    {
+        struct promise_type
+        {
+            DetachedCoroutine get_return_object() noexcept {return {};}
+            std::suspend_never initial_suspend() noexcept {return {};}
+            std::suspend_never final_suspend() noexcept {return {};}
+            void return_void() noexcept {}
+            void unhandled_exception() noexcept {std::terminate();}
+        };
+    };
+
+    template <typename T>
+    DetachedCoroutine runDetached(Task<T> task, Promise<T> promise, ThreadPool& pool, TaskPriority priority);
+}
+
+//-------------------------------------------------------------------
+/**
+ * class Task
+ *
+ * A coroutine that produces a value of type T. Only available when compiling with C++20.
+ *
+ * usage:
+ * Write a function returning mpu::Task<T> and use co_await and co_return inside it. A task does not start
+ * when it is created. It starts when it is awaited by another task with co_await, or when it is passed to spawn().
+ * spawn() runs the task on a ThreadPool and returns an mpu::Future for its result, which connects tasks to normal code.
+ *
+ * Inside a task the following can be awaited:
+ *  - another Task, the result is returned and exceptions are rethrown
+ *  - an mpu::Future, the task is resumed on the global thread pool once the value is available
+ *  - resumeOn(pool), continues the task on a different thread pool
+ *  - resumeOn(executor), continues the task on anything with a post(f) function, eg a queue that is
+ *      processed by the main thread once per frame to finish loading of resources which need an OpenGL context
+ *  - sleepFor(duration), continues the task on the global pool after duration, using the globalTimerService()
+ *  - readFileAsync(path), reads a file with the globalFileReader() without blocking any thread, using io_uring if available
+ *
+ * A task is move only. Destroying a task that was started but did not finish is not allowed.
+ *
+ */
+template <typename T>
+class Task
+{
+public:
+    using promise_type = detail::TaskPromise<T>;
+    using HandleType = std::coroutine_handle<promise_type>;
+
+    Task() = default;
+    explicit Task(HandleType h) : m_handle(h) {}
+    Task(Task&& other) noexcept : m_handle(std::exchange(other.m_handle, nullptr)) {}
+    Task& operator=(Task&& other) noexcept
+    {
+        if(this != &other)
+        {
+            if(m_handle)
+                m_handle.destroy();
+            m_handle = std::exchange(other.m_handle, nullptr);
+        }
+        return *this;
+    }
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+    ~Task() { if(m_handle) m_handle.destroy(); }
+
+    bool valid() const {return static_cast<bool>(m_handle);} //!< check if the task refers to a coroutine
+    bool isDone() const {return m_handle && m_handle.done();} //!< check if the task has finished
+
+    auto operator co_await() && noexcept
+    {
+        struct Awaiter
+        {
+            HandleType h;
+            bool await_ready() noexcept {return !h || h.done();}
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) noexcept
+            {
+                h.promise().continuation = caller;
+                return h; // start the task, we are resumed when it finishes
+            }
+            T await_resume() {return h.promise().result();}
+        };
+        return Awaiter{m_handle};
+    }
+
+private:
+    HandleType m_handle;
+};
+
+/**
+ * @brief Starts task on pool and returns a future for its result.
+ */
+template <typename T>
+Future<T> spawn(Task<T> task, ThreadPool& pool = globalThreadPool(), TaskPriority priority = TaskPriority::normal)
+{
+    Promise<T> promise;
+    Future<T> result = promise.getFuture();
+    detail::runDetached(std::move(task), std::move(promise), pool, priority);
+    return result;
+}
+
+/**
+ * @brief co_await resumeOn(executor) continues the current coroutine on executor,
+ *      which can be a ThreadPool or anything else with a post(f) function.
+ */
+template <typename Executor>
+auto resumeOn(Executor& executor)
+{
+    struct Awaiter
+    {
+        Executor& executor;
+        bool await_ready() noexcept {return false;}
+        void await_suspend(std::coroutine_handle<> h) { executor.post([h](){ h.resume(); }); }
+        void await_resume() noexcept {}
+    };
+    return Awaiter{executor};
+}
+
+/**
+ * @brief co_await resumeOn(pool, priority) continues the current coroutine on pool with the given priority
+ */
+inline auto resumeOn(ThreadPool& pool, TaskPriority priority)
+{
+    struct Awaiter
+    {
+        ThreadPool& pool;
+        TaskPriority priority;
+        bool await_ready() noexcept {return false;}
+        void await_suspend(std::coroutine_handle<> h) { pool.post(priority, [h](){ h.resume(); }); }
+        void await_resume() noexcept {}
+    };
+    return Awaiter{pool, priority};
+}
+
+/**
+ * @brief co_await sleepFor(duration) continues the coroutine on pool after duration has passed
+ */
+template <typename Rep, typename Period>
+auto sleepFor(std::chrono::duration<Rep, Period> duration, ThreadPool& pool = globalThreadPool())
+{
+    struct Awaiter
+    {
+        TimerService::clock::time_point deadline;
+        ThreadPool& pool;
+        bool await_ready() noexcept {return deadline <= TimerService::clock::now();}
+        void await_suspend(std::coroutine_handle<> h)
+        {
+            globalTimerService().schedule(deadline, [h](){ h.resume(); }, &pool);
+        }
+        void await_resume() noexcept {}
+    };
+    return Awaiter{TimerService::clock::now()
+                   + std::chrono::duration_cast<TimerService::clock::duration>(duration), pool};
+}
+
+/**
+ * @brief co_await readFileAsync(path) reads the whole file at path using reader and continues the coroutine on pool
+ *      once the data is available. No thread is blocked while reading. Errors are rethrown by co_await.
+ */
+inline auto readFileAsync(std::string path, AsyncFileReader& reader = globalFileReader(), ThreadPool& pool = globalThreadPool())
+{
+    struct Awaiter
+    {
+        std::string path;
+        AsyncFileReader& reader;
+        ThreadPool& pool;
+        std::string data;
+        std::exception_ptr error;
+
+        bool await_ready() noexcept {return false;}
+        void await_suspend(std::coroutine_handle<> h)
+        {
+            // the awaiter lives in the coroutine frame until the coroutine is resumed
+            reader.read(std::move(path), [this, h](std::string d, std::exception_ptr e)
+            {
+                data = std::move(d);
+                error = std::move(e);
+                pool.post([h](){ h.resume(); });
+            });
+        }
+        std::string await_resume()
+        {
+            if(error)
+                std::rethrow_exception(error);
+            return std::move(data);
+        }
+    };
+    return Awaiter{std::move(path), reader, pool, {}, nullptr};
+}
+
+/**
+ * @brief Makes mpu::Future awaitable. The coroutine is resumed on the global thread pool when the value is available.
+ */
+template <typename T>
+auto operator co_await(Future<T>&& future)
+{
+    struct Awaiter
+    {
+        std::shared_ptr<detail::SharedState<T>> state;
+        bool await_ready() {return state->isReady();}
+        void await_suspend(std::coroutine_handle<> h)
+        {
+            state->onReady(UniqueTask([h](){ globalThreadPool().post([h](){ h.resume(); }); }));
+        }
+        T await_resume() {return state->take();}
+    };
+
+    if(!future.valid())
+        throw std::future_error(std::future_errc::no_state);
+    return Awaiter{detail::FutureAccess::state(future)};
+}
+
+// template function definition
+//-------------------------------------------------------------------
+namespace detail {
+
+    template <typename T>
+    Task<T> TaskPromise<T>::get_return_object() noexcept
+    {
+        return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+    }
+
+    inline Task<void> TaskPromise<void>::get_return_object() noexcept
+    {
+        return Task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+    }
+
+    template <typename T>
+    DetachedCoroutine runDetached(Task<T> task, Promise<T> promise, ThreadPool& pool, TaskPriority priority)
+    {
+        try
+        {
+            co_await resumeOn(pool, priority);
+            if constexpr(std::is_void_v<T>)
+            {
+                co_await std::move(task);
+                promise.setValue();
+            }
+            else
+                promise.setValue(co_await std::move(task));
+        } catch(...)
+        {
+            promise.setException(std::current_exception());
+        }
+    }
+}
+
+}
+
+#endif // coroutine support
+#endif //MPUTILS_TASK_H
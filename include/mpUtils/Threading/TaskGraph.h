@@ -0,0 +1,102 @@
+/*
+ * mpUtils
+ * TaskGraph.h
+ *
+ * @author: Hendrik Schwanekamp
+ * @mail:   hendrik.schwanekamp@gmx.net
+ *
+ * Implements the TaskGraph class
+ *
+ * Copyright (c) 2021 Hendrik Schwanekamp
+ *
+ */
+
+#ifndef MPUTILS_TASKGRAPH_H
+#define MPUTILS_TASKGRAPH_H
+
+// includes
+//--------------------
+#include <vector>
+#include <string>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <atomic>
+#include "mpUtils/Misc/CopyMoveAtomic.h"
+#include "mpUtils/Threading/globalThreadPool.h"
+//--------------------
+
+// namespace
+//--------------------
+namespace mpu {
+//--------------------
+
+//-------------------------------------------------------------------
+/**
+ * class TaskGraph
+ *
+ * Executes a set of tasks with explicit dependencies (a directed acyclic graph) on a ThreadPool.
+ *
+ * usage:
+ * Add tasks with addTask() and declare which task has to finish before another one can start using addDependency().
+ * Then call execute() to start all tasks that have no dependencies. execute() returns immediately.
+ * Every task keeps a counter of unfinished dependencies. When a task finishes it decrements the counters of all its
+ * successors. The worker continues directly with one successor that became ready and posts the others to the pool.
+ * No thread ever blocks while waiting on a dependency.
+ * Use wait() to block until the whole graph is done, or register a callback with setOnFinished().
+ * Once finished the graph can be executed again, eg once per frame. The graph can not be modified while running.
+ *
+ * If a task throws, the remaining tasks are skipped and the exception is rethrown by wait().
+ *
+ */
+class TaskGraph
+{
+public:
+    using TaskId = std::size_t;
+
+    TaskGraph() = default;
+    ~TaskGraph(); //!< waits for the graph to finish
+    TaskGraph(const TaskGraph&) = delete;
+    TaskGraph& operator=(const TaskGraph&) = delete;
+
+    TaskId addTask(std::function<void()> task, std::string name = ""); //!< adds a task to the graph, returns its id
+    void addDependency(TaskId before, TaskId after); //!< after will only start once before is finished
+    void clear(); //!< removes all tasks
+
+    void execute(ThreadPool& pool = globalThreadPool()); //!< start executing the graph on pool, returns immediately
+    void wait(); //!< blocks until all tasks are done, rethrows the first exception thrown by a task
+    bool isRunning(); //!< check if the graph is currently executing
+    void setOnFinished(std::function<void()> callback); //!< callback is called from the thread executing the last task, or from execute() if the graph is empty
+
+    std::size_t numTasks() const {return m_nodes.size();} //!< number of tasks in the graph
+    const std::string& getName(TaskId id) const {return m_nodes[id].name;} //!< name of a task (for debugging)
+
+private:
+    struct Node
+    {
+        std::function<void()> work;
+        std::string name;
+        std::vector<TaskId> successors;
+        unsigned int numPredecessors{0};
+        CopyMoveAtomic<unsigned int> pendingPredecessors{0};
+    };
+
+    void runFrom(TaskId id); //!< runs task id and continues with ready successors
+    void checkForCycles(); //!< throws if the graph contains a cycle
+
+    std::vector<Node> m_nodes;
+    bool m_checked{true}; //!< graph was checked for cycles since the last modification
+    ThreadPool* m_pool{nullptr};
+    std::function<void()> m_onFinished;
+
+    std::atomic<std::size_t> m_remaining{0};
+    std::atomic<bool> m_failed{false};
+    std::exception_ptr m_exception;
+    bool m_running{false};
+    std::mutex m_mtx;
+    std::condition_variable m_cv;
+};
+
+}
+#endif //MPUTILS_TASKGRAPH_H
@@ -0,0 +1,195 @@
+/*
+ * mpUtils
+ * UniqueTask.h
+ *
+ * @author: Hendrik Schwanekamp
+ * @mail:   hendrik.schwanekamp@gmx.net
+ *
+ * Implements the UniqueTask class
+ *
+ * Copyright (c) 2021 Hendrik Schwanekamp
+ *
+ */
+
+#ifndef MPUTILS_UNIQUETASK_H
+#define MPUTILS_UNIQUETASK_H
+
+// includes
+//--------------------
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <stdexcept>
+#include <functional>
+//--------------------
+
+// namespace
+//--------------------
+namespace mpu {
+//--------------------
+
+//-------------------------------------------------------------------
+/**
+ * class basic_UniqueTask
+ *
+ * A move only replacement for std::function<void()>, used to store tasks in work queues.
+ * Callables that fit into bufferSize bytes and are nothrow move constructible are stored
+ * inside the object itself, so creating and moving the task does not allocate memory.
+ * Bigger callables are stored on the heap.
+ * Since the task is move only, move only callables (eg std::packaged_task or lambdas capturing a unique_ptr)
+ * can be stored directly without wrapping them into a std::shared_ptr.
+ *
+ * usage:
+ * Construct from any callable with signature void(), call with operator(). A default constructed task is empty,
+ * calling it throws std::bad_function_call.
+ *
+ */
+template <std::size_t bufferSize>
+class basic_UniqueTask
+{
+public:
+    basic_UniqueTask() noexcept = default;
+
+    template <typename F, typename = std::enable_if_t<!std::is_same<std::decay_t<F>, basic_UniqueTask>::value>>
+    basic_UniqueTask(F&& f); //!< construct a task from a callable
+
+    basic_UniqueTask(basic_UniqueTask&& other) noexcept;
+    basic_UniqueTask& operator=(basic_UniqueTask&& other) noexcept;
+    basic_UniqueTask(const basic_UniqueTask& other) = delete;
+    basic_UniqueTask& operator=(const basic_UniqueTask& other) = delete;
+    ~basic_UniqueTask() { reset(); }
+
+    void operator()(); //!< execute the stored callable
+    explicit operator bool() const noexcept {return m_ops != nullptr;} //!< check if a callable is stored
+    void reset() noexcept; //!< destroy the stored callable
+
+    template <typename F>
+    static constexpr bool storedInline() //!< checks if a callable of type F would be stored without heap allocation
+    {
+        return sizeof(F) <= bufferSize && alignof(F) <= alignof(std::max_align_t)
+               && std::is_nothrow_move_constructible<F>::value;
+    }
+
+private:
+    struct Operations
+    {
+        void (*invoke)(void* storage);
+        void (*move)(void* from, void* to); // move from -> to and destroy from
+        void (*destroy)(void* storage);
+    };
+
+    template <typename F> struct InlineOps
+    {
+        static void invoke(void* s) { (*static_cast<F*>(s))(); }
+        static void move(void* from, void* to) noexcept
+        {
+            ::new(to) F(std::move(*static_cast<F*>(from)));
+            static_cast<F*>(from)->~F();
+        }
+        static void destroy(void* s) noexcept { static_cast<F*>(s)->~F(); }
+        static const Operations ops;
+    };
+
+    template <typename F> struct HeapOps
+    {
+        static void invoke(void* s) { (**static_cast<F**>(s))(); }
+        static void move(void* from, void* to) noexcept { *static_cast<F**>(to) = *static_cast<F**>(from); }
+        static void destroy(void* s) noexcept { delete *static_cast<F**>(s); }
+        static const Operations ops;
+    };
+
+    template <typename Fd, typename F> void store(F&& f, std::true_type); //!< store f in the internal buffer
+    template <typename Fd, typename F> void store(F&& f, std::false_type); //!< store f on the heap
+
+    alignas(std::max_align_t) unsigned char m_storage[bufferSize];
+    const Operations* m_ops{nullptr};
+};
+
+// the default task type, a task with its 48 byte buffer fills exactly one cache line
+using UniqueTask = basic_UniqueTask<48>;
+
+// template function definition
+//-------------------------------------------------------------------
+
+template <std::size_t bufferSize>
+template <typename F>
+const typename basic_UniqueTask<bufferSize>::Operations basic_UniqueTask<bufferSize>::InlineOps<F>::ops =
+        {&InlineOps<F>::invoke, &InlineOps<F>::move, &InlineOps<F>::destroy};
+
+template <std::size_t bufferSize>
+template <typename F>
+const typename basic_UniqueTask<bufferSize>::Operations basic_UniqueTask<bufferSize>::HeapOps<F>::ops =
+        {&HeapOps<F>::invoke, &HeapOps<F>::move, &HeapOps<F>::destroy};
+
+template <std::size_t bufferSize>
+template <typename F, typename>
+basic_UniqueTask<bufferSize>::basic_UniqueTask(F&& f)
+{
+    using Fd = std::decay_t<F>;
+    store<Fd>(std::forward<F>(f), std::integral_constant<bool, storedInline<Fd>()>());
+}
+
+template <std::size_t bufferSize>
+template <typename Fd, typename F>
+void basic_UniqueTask<bufferSize>::store(F&& f, std::true_type)
+{
+    ::new(static_cast<void*>(m_storage)) Fd(std::forward<F>(f));
+    m_ops = &InlineOps<Fd>::ops;
+}
+
+template <std::size_t bufferSize>
+template <typename Fd, typename F>
+void basic_UniqueTask<bufferSize>::store(F&& f, std::false_type)
+{
+    *reinterpret_cast<Fd**>(m_storage) = new Fd(std::forward<F>(f));
+    m_ops = &HeapOps<Fd>::ops;
+}
+
+template <std::size_t bufferSize>
+basic_UniqueTask<bufferSize>::basic_UniqueTask(basic_UniqueTask&& other) noexcept
+{
+    if(other.m_ops)
+    {
+        other.m_ops->move(other.m_storage, m_storage);
+        m_ops = other.m_ops;
+        other.m_ops = nullptr;
+    }
+}
+
+template <std::size_t bufferSize>
+basic_UniqueTask<bufferSize>& basic_UniqueTask<bufferSize>::operator=(basic_UniqueTask&& other) noexcept
+{
+    if(this != &other)
+    {
+        reset();
+        if(other.m_ops)
+        {
+            other.m_ops->move(other.m_storage, m_storage);
+            m_ops = other.m_ops;
+            other.m_ops = nullptr;
+        }
+    }
+    return *this;
+}
+
+template <std::size_t bufferSize>
+void basic_UniqueTask<bufferSize>::operator()()
+{
+    if(!m_ops)
+        throw std::bad_function_call();
+    m_ops->invoke(m_storage);
+}
+
+template <std::size_t bufferSize>
+void basic_UniqueTask<bufferSize>::reset() noexcept
+{
+    if(m_ops)
+    {
+        m_ops->destroy(m_storage);
+        m_ops = nullptr;
+    }
+}
+
+}
+#endif //MPUTILS_UNIQUETASK_H
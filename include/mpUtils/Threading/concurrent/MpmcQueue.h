@@ -0,0 +1,193 @@
+/*
+ * mpUtils
+ * MpmcQueue.h
+ *
+ * @author: Hendrik Schwanekamp
+ * @mail:   hendrik.schwanekamp@gmx.net
+ *
+ * Implements the MpmcQueue class
+ *
+ * Copyright (c) 2021 Hendrik Schwanekamp
+ *
+ */
+
+#ifndef MPUTILS_MPMCQUEUE_H
+#define MPUTILS_MPMCQUEUE_H
+
+// includes
+//--------------------
+#include <atomic>
+#include <memory>
+#include <new>
+#include <utility>
+#include <type_traits>
+#include "mpUtils/Threading/concurrent/SpinLock.h"
+#include "mpUtils/Threading/concurrent/SpscQueue.h"
+//--------------------
+
+// namespace
+//--------------------
+namespace mpu {
+namespace concurrent {
+//--------------------
+
+//-------------------------------------------------------------------
+/**
+ * class MpmcQueue
+ *
+ * A bounded lock free fifo queue for any number of producer and consumer threads (after Dmitry Vyukov).
+ * Every slot has a sequence number that tells whether it is ready to be written or read in the current lap
+ * of the ring. Producers and consumers claim a slot with a single compare and swap on the tail or head index,
+ * then construct or move the element without any further contention.
+ * The capacity is rounded up to a power of two. Push and pop never block or allocate, they return false
+ * if the queue is full or empty. Bulk operations stop at the first element that could not be transferred.
+ *
+ */
+template <typename T>
+class MpmcQueue
+{
+public:
+    explicit MpmcQueue(std::size_t capacity);
+    ~MpmcQueue();
+    MpmcQueue(const MpmcQueue&) = delete;
+    MpmcQueue& operator=(const MpmcQueue&) = delete;
+
+    template <typename... Args>
+    bool tryEmplace(Args&&... args); //!< construct an element in place, returns false if the queue is full
+    bool tryPush(const T& v) {return tryEmplace(v);} //!< add an element, returns false if the queue is full
+    bool tryPush(T&& v) {return tryEmplace(std::move(v));} //!< add an element, returns false if the queue is full
+    template <typename InputIt>
+    std::size_t tryPushBulk(InputIt first, std::size_t count); //!< moves up to count elements into the queue, returns the number of elements pushed
+
+    bool tryPop(T& out); //!< moves the oldest element to out, returns false if the queue is empty
+    template <typename OutputIt>
+    std::size_t tryPopBulk(OutputIt out, std::size_t maxCount); //!< moves up to maxCount elements to out, returns the number of elements popped
+
+    std::size_t sizeApprox() const; //!< number of elements, only exact if no other thread is active
+    std::size_t capacity() const {return m_mask + 1;} //!< maximum number of elements
+
+private:
+    struct Cell
+    {
+        std::atomic<std::size_t> sequence;
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+        T* element() {return reinterpret_cast<T*>(&storage);}
+    };
+
+    const std::size_t m_mask;
+    std::unique_ptr<Cell[]> m_cells;
+
+    alignas(cacheLineSize) std::atomic<std::size_t> m_tail{0}; //!< next position to write
+    alignas(cacheLineSize) std::atomic<std::size_t> m_head{0}; //!< next position to read
+    char m_padding[cacheLineSize - sizeof(std::size_t)];
+};
+
+// template function definition
+//-------------------------------------------------------------------
+
+template <typename T>
+MpmcQueue<T>::MpmcQueue(std::size_t capacity)
+    : m_mask(nextPowerOfTwo(std::max(capacity, std::size_t(2))) - 1),
+      m_cells(new Cell[m_mask + 1])
+{
+    for(std::size_t i = 0; i <= m_mask; ++i)
+        m_cells[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+template <typename T>
+MpmcQueue<T>::~MpmcQueue()
+{
+    for(std::size_t i = m_head.load(std::memory_order_relaxed); i != m_tail.load(std::memory_order_relaxed); ++i)
+        m_cells[i & m_mask].element()->~T();
+}
+
+template <typename T>
+template <typename... Args>
+bool MpmcQueue<T>::tryEmplace(Args&&... args)
+{
+    std::size_t pos = m_tail.load(std::memory_order_relaxed);
+    Cell* cell;
+    for(;;)
+    {
+        cell = &m_cells[pos & m_mask];
+        const std::size_t sequence = cell->sequence.load(std::memory_order_acquire);
+        const auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos);
+        if(diff == 0)
+        {
+            if(m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if(diff < 0)
+            return false; // the cell still holds an element from the previous lap, queue is full
+        else
+            pos = m_tail.load(std::memory_order_relaxed);
+    }
+
+    ::new(static_cast<void*>(cell->element())) T(std::forward<Args>(args)...);
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+template <typename T>
+bool MpmcQueue<T>::tryPop(T& out)
+{
+    std::size_t pos = m_head.load(std::memory_order_relaxed);
+    Cell* cell;
+    for(;;)
+    {
+        cell = &m_cells[pos & m_mask];
+        const std::size_t sequence = cell->sequence.load(std::memory_order_acquire);
+        const auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos + 1);
+        if(diff == 0)
+        {
+            if(m_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if(diff < 0)
+            return false; // nothing was written to the cell in this lap, queue is empty
+        else
+            pos = m_head.load(std::memory_order_relaxed);
+    }
+
+    out = std::move(*cell->element());
+    cell->element()->~T();
+    cell->sequence.store(pos + m_mask + 1, std::memory_order_release);
+    return true;
+}
+
+template <typename T>
+template <typename InputIt>
+std::size_t MpmcQueue<T>::tryPushBulk(InputIt first, std::size_t count)
+{
+    std::size_t n = 0;
+    for(; n < count; ++n, ++first)
+        if(!tryEmplace(std::move(*first)))
+            break;
+    return n;
+}
+
+template <typename T>
+template <typename OutputIt>
+std::size_t MpmcQueue<T>::tryPopBulk(OutputIt out, std::size_t maxCount)
+{
+    std::size_t n = 0;
+    T element;
+    for(; n < maxCount; ++n, ++out)
+    {
+        if(!tryPop(element))
+            break;
+        *out = std::move(element);
+    }
+    return n;
+}
+
+template <typename T>
+std::size_t MpmcQueue<T>::sizeApprox() const
+{
+    const std::size_t head = m_head.load(std::memory_order_acquire);
+    const std::size_t tail = m_tail.load(std::memory_order_acquire);
+    return (tail >= head) ? tail - head : 0;
+}
+
+}}
+#endif //MPUTILS_MPMCQUEUE_H
@@ -0,0 +1,135 @@
+/*
+ * mpUtils
+ * SegmentedVector.h
+ *
+ * @author: Hendrik Schwanekamp
+ * @mail:   hendrik.schwanekamp@gmx.net
+ *
+ * Implements the SegmentedVector class
+ *
+ * Copyright (c) 2021 Hendrik Schwanekamp
+ *
+ */
+
+#ifndef MPUTILS_SEGMENTEDVECTOR_H
+#define MPUTILS_SEGMENTEDVECTOR_H
+
+// includes
+//--------------------
+#include <atomic>
+#include <mutex>
+#include <cstddef>
+//--------------------
+
+// namespace
+//--------------------
+namespace mpu {
+namespace concurrent {
+//--------------------
+
+namespace detail {
+    inline unsigned int floorLog2(std::size_t x) //!< position of the highest set bit, x must not be 0
+    {
+#if defined(__GNUC__)
+        return static_cast<unsigned int>(sizeof(unsigned long long) * 8 - 1 - __builtin_clzll(x));
+#else
+        unsigned int r = 0;
+        while(x >>= 1)
+            ++r;
+        return r;
+#endif
+    }
+}
+
+//-------------------------------------------------------------------
+/**
+ * class SegmentedVector
+ *
+ * An array that can grow while other threads access its elements. Elements are stored in segments of
+ * increasing size (firstSegmentSize, 2*firstSegmentSize, 4*firstSegmentSize, ...) which are never moved or freed,
+ * so references to elements stay valid and elements can be accessed without any lock.
+ * firstSegmentSize needs to be a power of two. T needs to be default constructible.
+ *
+ * usage:
+ * grow() appends a default constructed element and returns its index, it can be called from many threads.
+ * Growing is serialized with a mutex, accessing elements with operator[] is lock free. Synchronizing access
+ * to the elements themselves is up to the user, make sure another thread only learns about a new index after
+ * the element was initialized, eg by publishing the index in a map or an atomic.
+ *
+ */
+template <typename T, std::size_t firstSegmentSize = 64>
+class SegmentedVector
+{
+    static_assert(firstSegmentSize > 0 && (firstSegmentSize & (firstSegmentSize - 1)) == 0,
+                  "First segment size needs to be a power of two.");
+public:
+    SegmentedVector() = default;
+    ~SegmentedVector();
+    SegmentedVector(const SegmentedVector&) = delete;
+    SegmentedVector& operator=(const SegmentedVector&) = delete;
+
+    std::size_t grow(); //!< appends a default constructed element, returns its index
+    T& operator[](std::size_t i); //!< access element i, i must be smaller than size()
+    const T& operator[](std::size_t i) const; //!< access element i, i must be smaller than size()
+    std::size_t size() const {return m_size.load(std::memory_order_acquire);} //!< number of elements
+
+private:
+    static constexpr unsigned int maxSegments = sizeof(std::size_t) * 8 - 1;
+    static unsigned int segmentOf(std::size_t i, std::size_t& offset); //!< returns the segment of element i and its position inside
+
+    std::atomic<T*> m_segments[maxSegments] = {};
+    std::atomic<std::size_t> m_size{0};
+    std::mutex m_growMtx; //!< serializes grow()
+};
+
+// template function definition
+//-------------------------------------------------------------------
+
+template <typename T, std::size_t firstSegmentSize>
+SegmentedVector<T, firstSegmentSize>::~SegmentedVector()
+{
+    for(auto& segment : m_segments)
+        delete[] segment.load(std::memory_order_relaxed);
+}
+
+template <typename T, std::size_t firstSegmentSize>
+unsigned int SegmentedVector<T, firstSegmentSize>::segmentOf(std::size_t i, std::size_t& offset)
+{
+    // segment s starts at firstSegmentSize * (2^s - 1), so i + firstSegmentSize has its highest bit at s + log2(firstSegmentSize)
+    const std::size_t k = i + firstSegmentSize;
+    const unsigned int segment = detail::floorLog2(k) - detail::floorLog2(firstSegmentSize);
+    offset = k - (firstSegmentSize << segment);
+    return segment;
+}
+
+template <typename T, std::size_t firstSegmentSize>
+std::size_t SegmentedVector<T, firstSegmentSize>::grow()
+{
+    std::lock_guard<std::mutex> lck(m_growMtx);
+    const std::size_t i = m_size.load(std::memory_order_relaxed);
+    std::size_t offset;
+    const unsigned int segment = segmentOf(i, offset);
+    if(offset == 0 && !m_segments[segment].load(std::memory_order_relaxed))
+        m_segments[segment].store(new T[firstSegmentSize << segment], std::memory_order_release);
+    m_size.store(i + 1, std::memory_order_release);
+    return i;
+}
+
+template <typename T, std::size_t firstSegmentSize>
+T& SegmentedVector<T, firstSegmentSize>::operator[](std::size_t i)
+{
+    std::size_t offset;
+    const unsigned int segment = segmentOf(i, offset);
+    return m_segments[segment].load(std::memory_order_acquire)[offset];
+}
+
+template <typename T, std::size_t firstSegmentSize>
+const T& SegmentedVector<T, firstSegmentSize>::operator[](std::size_t i) const
+{
+    std::size_t offset;
+    const unsigned int segment = segmentOf(i, offset);
+    return m_segments[segment].load(std::memory_order_acquire)[offset];
+}
+
+}}
+#endif //MPUTILS_SEGMENTEDVECTOR_H
@@ -0,0 +1,192 @@
+/*
+ * mpUtils
+ * Semaphore.h
+ *
+ * @author: Hendrik Schwanekamp
+ * @mail:   hendrik.schwanekamp@gmx.net
+ *
+ * Implements the Semaphore, Latch and Barrier classes
+ *
+ * Copyright (c) 2021 Hendrik Schwanekamp
+ *
+ */
+
+#ifndef MPUTILS_SEMAPHORE_H
+#define MPUTILS_SEMAPHORE_H
+
+// includes
+//--------------------
+#include <atomic>
+#include <cstdint>
+#include "mpUtils/Threading/concurrent/SpinLock.h"
+#include "mpUtils/Threading/concurrent/futex.h"
+//--------------------
+
+// namespace
+//--------------------
+namespace mpu {
+namespace concurrent {
+//--------------------
+
+//-------------------------------------------------------------------
+/**
+ * class Semaphore
+ *
+ * A counting semaphore. acquire() takes one unit from the counter and blocks while it is zero,
+ * release() adds units and wakes up waiting threads. Waiting threads spin for a short time
+ * and then sleep on a futex, no system call is made as long as nobody needs to sleep.
+ *
+ */
+class Semaphore
+{
+public:
+    explicit Semaphore(uint32_t initialCount = 0) : m_count(initialCount) {}
+    Semaphore(const Semaphore&) = delete;
+    Semaphore& operator=(const Semaphore&) = delete;
+
+    bool tryAcquire() noexcept; //!< takes one unit if available, returns false otherwise
+    void acquire(); //!< takes one unit, blocks until one is available
+    void release(uint32_t n = 1); //!< adds n units, wakes up to n threads
+    uint32_t count() const noexcept {return m_count.load(std::memory_order_relaxed);} //!< current value of the counter
+
+private:
+    static constexpr int spinCount = 64;
+    std::atomic<uint32_t> m_count;
+    std::atomic<uint32_t> m_waiters{0};
+};
+
+//-------------------------------------------------------------------
+/**
+ * class Latch
+ *
+ * A single use counter. Threads can wait until it was counted down to zero.
+ * Use it to wait for a known number of events, eg until all workers finished their initialization.
+ *
+ */
+class Latch
+{
+public:
+    explicit Latch(uint32_t count) : m_count(count) {}
+    Latch(const Latch&) = delete;
+    Latch& operator=(const Latch&) = delete;
+
+    void countDown(uint32_t n = 1); //!< decrease the counter by n, wakes all waiting threads when it reaches zero
+    bool tryWait() const noexcept {return m_count.load(std::memory_order_acquire) == 0;} //!< check if the counter reached zero
+    void wait() const; //!< block until the counter reaches zero
+    void arriveAndWait(uint32_t n = 1) {countDown(n); wait();} //!< count down and then wait
+
+private:
+    mutable std::atomic<uint32_t> m_count;
+};
+
+//-------------------------------------------------------------------
+/**
+ * class Barrier
+ *
+ * A reusable synchronization point for a fixed number of threads. Every thread calls arriveAndWait(),
+ * which blocks until all threads arrived. Then all are released and the barrier can be used again.
+ *
+ */
+class Barrier
+{
+public:
+    explicit Barrier(uint32_t numThreads) : m_numThreads(numThreads) {}
+    Barrier(const Barrier&) = delete;
+    Barrier& operator=(const Barrier&) = delete;
+
+    bool arriveAndWait(); //!< blocks until all threads arrived, returns true for exactly one thread of each phase
+    uint32_t phase() const noexcept {return m_phase.load(std::memory_order_acquire);} //!< number of completed phases
+
+private:
+    static constexpr int spinCount = 64;
+    const uint32_t m_numThreads;
+    std::atomic<uint32_t> m_arrived{0};
+    std::atomic<uint32_t> m_phase{0};
+};
+
+// function definitions
+//-------------------------------------------------------------------
+
+inline bool Semaphore::tryAcquire() noexcept
+{
+    // the decrement only needs acquire, it reads the value of the increment in release() (or a later one of its
+    // release sequence), so everything written before release() is visible once we took the unit
+    uint32_t c = m_count.load(std::memory_order_relaxed);
+    while(c > 0)
+        if(m_count.compare_exchange_weak(c, c - 1, std::memory_order_acquire, std::memory_order_relaxed))
+            return true;
+    return false;
+}
+
+inline void Semaphore::acquire()
+{
+    for(int i = 0; i < spinCount; ++i)
+    {
+        if(tryAcquire())
+            return;
+        cpuRelax();
+    }
+
+    // registering as waiter and loading the count are seq_cst, as well as the increment of the count and loading
+    // the waiters in release(). So either release() sees us waiting and wakes us, or we see its increment.
+    // A relaxed load here could still return 0 after release() skipped the wakeup.
+    m_waiters.fetch_add(1, std::memory_order_seq_cst);
+    uint32_t c = m_count.load(std::memory_order_seq_cst);
+    for(;;)
+    {
+        if(c == 0)
+        {
+            futexWait(&m_count, 0);
+            c = m_count.load(std::memory_order_seq_cst);
+        }
+        else if(m_count.compare_exchange_weak(c, c - 1, std::memory_order_acquire, std::memory_order_relaxed))
+            break;
+    }
+    m_waiters.fetch_sub(1, std::memory_order_relaxed);
+}
+
+inline void Semaphore::release(uint32_t n)
+{
+    m_count.fetch_add(n, std::memory_order_seq_cst);
+    if(m_waiters.load(std::memory_order_seq_cst) > 0)
+        futexWake(&m_count, static_cast<int>(n));
+}
+
+inline void Latch::countDown(uint32_t n)
+{
+    if(m_count.fetch_sub(n, std::memory_order_acq_rel) == n)
+        futexWakeAll(&m_count);
+}
+
+inline void Latch::wait() const
+{
+    uint32_t c;
+    while((c = m_count.load(std::memory_order_acquire)) != 0)
+        futexWait(&m_count, c);
+}
+
+inline bool Barrier::arriveAndWait()
+{
+    const uint32_t phase = m_phase.load(std::memory_order_acquire);
+    if(m_arrived.fetch_add(1, std::memory_order_acq_rel) + 1 == m_numThreads)
+    {
+        // reset before the phase changes, released threads might arrive again right away
+        m_arrived.store(0, std::memory_order_relaxed);
+        m_phase.fetch_add(1, std::memory_order_release);
+        futexWakeAll(&m_phase);
+        return true;
+    }
+
+    for(int i = 0; i < spinCount; ++i)
+    {
+        if(m_phase.load(std::memory_order_acquire) != phase)
+            return false;
+        cpuRelax();
+    }
+    while(m_phase.load(std::memory_order_acquire) == phase)
+        futexWait(&m_phase, phase);
+    return false;
+}
+
+}}
+#endif //MPUTILS_SEMAPHORE_H
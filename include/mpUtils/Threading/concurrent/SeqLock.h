@@ -0,0 +1,123 @@
+/*
+ * mpUtils
+ * SeqLock.h
+ *
+ * @author: Hendrik Schwanekamp
+ * @mail:   hendrik.schwanekamp@gmx.net
+ *
+ * Implements the SeqLock class
+ *
+ * Copyright (c) 2021 Hendrik Schwanekamp
+ *
+ */
+
+#ifndef MPUTILS_SEQLOCK_H
+#define MPUTILS_SEQLOCK_H
+
+// includes
+//--------------------
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include "mpUtils/Threading/concurrent/SpinLock.h"
+//--------------------
+
+// namespace
+//--------------------
+namespace mpu {
+namespace concurrent {
+//--------------------
+
+//-------------------------------------------------------------------
+/**
+ * class SeqLock
+ *
+ * Protects a value that is read often and written rarely, eg the camera state or simulation parameters.
+ * Readers never block writers and never write to shared memory, so many readers scale perfectly.
+ * A reader retries if a write happened while it was reading. Writers are serialized with each other.
+ * T needs to be trivially copyable. The value is stored as an array of atomic words, so concurrent
+ * reading and writing is free of data races.
+ *
+ */
+template <typename T>
+class SeqLock
+{
+    static_assert(std::is_trivially_copyable<T>::value, "SeqLock can only store trivially copyable types.");
+public:
+    SeqLock() : SeqLock(T()) {}
+    explicit SeqLock(const T& value) { writeWords(value); }
+    SeqLock(const SeqLock&) = delete;
+    SeqLock& operator=(const SeqLock&) = delete;
+
+    T load() const; //!< returns a consistent copy of the value
+    void store(const T& value); //!< replaces the value
+
+private:
+    static constexpr std::size_t numWords = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    void writeWords(const T& value);
+
+    alignas(cacheLineSize) std::atomic<uint32_t> m_sequence{0}; //!< odd while a write is in progress
+    std::atomic<uint64_t> m_words[numWords];
+};
+
+// template function definition
+//-------------------------------------------------------------------
+
+template <typename T>
+T SeqLock<T>::load() const
+{
+    uint64_t buffer[numWords];
+    for(;;)
+    {
+        const uint32_t before = m_sequence.load(std::memory_order_acquire);
+        if(before & 1u)
+        {
+            cpuRelax();
+            continue;
+        }
+
+        for(std::size_t i = 0; i < numWords; ++i)
+            buffer[i] = m_words[i].load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if(m_sequence.load(std::memory_order_relaxed) == before)
+            break;
+    }
+
+    T result;
+    std::memcpy(&result, buffer, sizeof(T));
+    return result;
+}
+
+template <typename T>
+void SeqLock<T>::store(const T& value)
+{
+    // take the write lock by making the sequence odd
+    uint32_t sequence = m_sequence.load(std::memory_order_relaxed);
+    for(;;)
+    {
+        if(!(sequence & 1u) && m_sequence.compare_exchange_weak(sequence, sequence + 1, std::memory_order_relaxed))
+            break;
+        cpuRelax();
+        sequence = m_sequence.load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+
+    writeWords(value);
+
+    m_sequence.store(sequence + 2, std::memory_order_release);
+}
+
+template <typename T>
+void SeqLock<T>::writeWords(const T& value)
+{
+    uint64_t buffer[numWords] = {};
+    std::memcpy(buffer, &value, sizeof(T));
+    for(std::size_t i = 0; i < numWords; ++i)
+        m_words[i].store(buffer[i], std::memory_order_relaxed);
+}
+
+}}
+#endif //MPUTILS_SEQLOCK_H
@@ -0,0 +1,178 @@
+/*
+ * mpUtils
+ * ShardedMap.h
+ *
+ * @author: Hendrik Schwanekamp
+ * @mail:   hendrik.schwanekamp@gmx.net
+ *
+ * Implements the ShardedMap class
+ *
+ * Copyright (c) 2021 Hendrik Schwanekamp
+ *
+ */
+
+#ifndef MPUTILS_SHARDEDMAP_H
+#define MPUTILS_SHARDEDMAP_H
+
+// includes
+//--------------------
+#include <unordered_map>
+#include <shared_mutex>
+#include <mutex>
+#include <cstdint>
+#include <functional>
+#include "mpUtils/Threading/concurrent/SpinLock.h"
+//--------------------
+
+// namespace
+//--------------------
+namespace mpu {
+namespace concurrent {
+//--------------------
+
+//-------------------------------------------------------------------
+/**
+ * class ShardedMap
+ *
+ * A hash map that can be used from many threads at the same time. Keys are distributed over numShards
+ * independent unordered_maps, each protected by its own reader writer lock and placed on its own cache line.
+ * Threads working on different keys rarely touch the same lock, and lookups of the same key only take a shared lock.
+ * numShards needs to be a power of two.
+ *
+ * usage:
+ * Use find() to look up a value, findOrInsert() to atomically insert a value if the key is missing.
+ * The function passed to findOrInsert() is called while the shard is locked, so it is called exactly once per key.
+ * forEach() visits one shard after the other, it does not see a consistent snapshot of the whole map.
+ *
+ */
+template <typename Key, typename Value, typename Hash = std::hash<Key>, std::size_t numShards = 32>
+class ShardedMap
+{
+    static_assert(numShards > 0 && (numShards & (numShards - 1)) == 0, "Number of shards needs to be a power of two.");
+public:
+    ShardedMap() = default;
+    ShardedMap(const ShardedMap&) = delete;
+    ShardedMap& operator=(const ShardedMap&) = delete;
+
+    bool find(const Key& key, Value& value) const; //!< copies the value of key to value, returns false if key is not in the map
+    bool contains(const Key& key) const; //!< check if key is in the map
+    template <typename F>
+    Value findOrInsert(const Key& key, F&& makeValue); //!< returns the value of key, inserts the result of makeValue() if key is missing
+    bool insert(const Key& key, Value value); //!< inserts value, returns false if the key already exists
+    bool erase(const Key& key); //!< removes key, returns false if it was not in the map
+    template <typename F>
+    void forEach(F&& f) const; //!< calls f(key, value) for every element, shards are locked one after the other
+    std::size_t size() const; //!< number of elements, only a snapshot while other threads modify the map
+
+private:
+    struct alignas(cacheLineSize) Shard
+    {
+        mutable std::shared_timed_mutex mtx;
+        std::unordered_map<Key, Value, Hash> map;
+    };
+
+    Shard& shardFor(const Key& key);
+    const Shard& shardFor(const Key& key) const;
+
+    Shard m_shards[numShards];
+};
+
+// template function definition
+//-------------------------------------------------------------------
+
+template <typename Key, typename Value, typename Hash, std::size_t numShards>
+typename ShardedMap<Key, Value, Hash, numShards>::Shard& ShardedMap<Key, Value, Hash, numShards>::shardFor(const Key& key)
+{
+    // fibonacci hashing, so hash functions with poor low bits (eg the identity for integers) still spread over all shards
+    const uint64_t h = static_cast<uint64_t>(Hash()(key)) * 11400714819323198485ull;
+    return m_shards[(h >> 32) & (numShards - 1)];
+}
+
+template <typename Key, typename Value, typename Hash, std::size_t numShards>
+const typename ShardedMap<Key, Value, Hash, numShards>::Shard& ShardedMap<Key, Value, Hash, numShards>::shardFor(const Key& key) const
+{
+    return const_cast<ShardedMap*>(this)->shardFor(key);
+}
+
+template <typename Key, typename Value, typename Hash, std::size_t numShards>
+bool ShardedMap<Key, Value, Hash, numShards>::find(const Key& key, Value& value) const
+{
+    const Shard& shard = shardFor(key);
+    std::shared_lock<std::shared_timed_mutex> lck(shard.mtx);
+    auto it = shard.map.find(key);
+    if(it == shard.map.end())
+        return false;
+    value = it->second;
+    return true;
+}
+
+template <typename Key, typename Value, typename Hash, std::size_t numShards>
+bool ShardedMap<Key, Value, Hash, numShards>::contains(const Key& key) const
+{
+    const Shard& shard = shardFor(key);
+    std::shared_lock<std::shared_timed_mutex> lck(shard.mtx);
+    return shard.map.find(key) != shard.map.end();
+}
+
+template <typename Key, typename Value, typename Hash, std::size_t numShards>
+template <typename F>
+Value ShardedMap<Key, Value, Hash, numShards>::findOrInsert(const Key& key, F&& makeValue)
+{
+    Shard& shard = shardFor(key);
+    {
+        std::shared_lock<std::shared_timed_mutex> lck(shard.mtx);
+        auto it = shard.map.find(key);
+        if(it != shard.map.end())
+            return it->second;
+    }
+
+    // check again, another thread might have inserted the key while we did not hold the lock
+    std::unique_lock<std::shared_timed_mutex> lck(shard.mtx);
+    auto it = shard.map.find(key);
+    if(it != shard.map.end())
+        return it->second;
+    return shard.map.emplace(key, makeValue()).first->second;
+}
+
+template <typename Key, typename Value, typename Hash, std::size_t numShards>
+bool ShardedMap<Key, Value, Hash, numShards>::insert(const Key& key, Value value)
+{
+    Shard& shard = shardFor(key);
+    std::unique_lock<std::shared_timed_mutex> lck(shard.mtx);
+    return shard.map.emplace(key, std::move(value)).second;
+}
+
+template <typename Key, typename Value, typename Hash, std::size_t numShards>
+bool ShardedMap<Key, Value, Hash, numShards>::erase(const Key& key)
+{
+    Shard& shard = shardFor(key);
+    std::unique_lock<std::shared_timed_mutex> lck(shard.mtx);
+    return shard.map.erase(key) > 0;
+}
+
+template <typename Key, typename Value, typename Hash, std::size_t numShards>
+template <typename F>
+void ShardedMap<Key, Value, Hash, numShards>::forEach(F&& f) const
+{
+    for(const Shard& shard : m_shards)
+    {
+        std::shared_lock<std::shared_timed_mutex> lck(shard.mtx);
+        for(const auto& element : shard.map)
+            f(element.first, element.second);
+    }
+}
+
+template <typename Key, typename Value, typename Hash, std::size_t numShards>
+std::size_t ShardedMap<Key, Value, Hash, numShards>::size() const
+{
+    std::size_t s = 0;
+    for(const Shard& shard : m_shards)
+    {
+        std::shared_lock<std::shared_timed_mutex> lck(shard.mtx);
+        s += shard.map.size();
+    }
+    return s;
+}
+
+}}
+#endif //MPUTILS_SHARDEDMAP_H
@@ -0,0 +1,100 @@
+/*
+ * mpUtils
+ * SpinLock.h
+ *
+ * @author: Hendrik Schwanekamp
+ * @mail:   hendrik.schwanekamp@gmx.net
+ *
+ * Implements the SpinLock class
+ *
+ * Copyright (c) 2021 Hendrik Schwanekamp
+ *
+ */
+
+#ifndef MPUTILS_SPINLOCK_H
+#define MPUTILS_SPINLOCK_H
+
+// includes
+//--------------------
+#include <atomic>
+#include <thread>
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+    #include <immintrin.h>
+#endif
+//--------------------
+
+// namespace
+//--------------------
+namespace mpu {
+namespace concurrent {
+//--------------------
+
+/**
+ * @brief size of a cache line, used to keep independently modified variables apart
+ */
+constexpr std::size_t cacheLineSize = 64;
+
+/**
+ * @brief tells the cpu that we are in a spin loop, saves power and frees resources for the other hyperthread
+ */
+inline void cpuRelax() noexcept
+{
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+    _mm_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    asm volatile("yield" ::: "memory");
+#endif
+}
+
+//-------------------------------------------------------------------
+/**
+ * class SpinLock
+ *
+ * A lock that busy waits instead of putting the thread to sleep. Only use it to protect very short critical sections.
+ * While waiting, only reads are performed (test and test-and-set), and the time between attempts grows
+ * exponentially to reduce contention. After the maximum backoff is reached the thread yields.
+ * Can be used with std::lock_guard and std::unique_lock.
+ *
+ */
+class SpinLock
+{
+public:
+    SpinLock() = default;
+    SpinLock(const SpinLock&) = delete;
+    SpinLock& operator=(const SpinLock&) = delete;
+
+    void lock() noexcept //!< acquire the lock, spins until it is available
+    {
+        unsigned int backoff = 1;
+        while(m_locked.exchange(true, std::memory_order_acquire))
+        {
+            while(m_locked.load(std::memory_order_relaxed))
+            {
+                if(backoff <= maxBackoff)
+                {
+                    for(unsigned int i = 0; i < backoff; ++i)
+                        cpuRelax();
+                    backoff *= 2;
+                } else
+                    std::this_thread::yield();
+            }
+        }
+    }
+
+    bool try_lock() noexcept //!< acquire the lock if it is available, returns false otherwise
+    {
+        return !m_locked.load(std::memory_order_relaxed) && !m_locked.exchange(true, std::memory_order_acquire);
+    }
+
+    void unlock() noexcept //!< release the lock
+    {
+        m_locked.store(false, std::memory_order_release);
+    }
+
+private:
+    static constexpr unsigned int maxBackoff = 1024; //!< maximum number of pause instructions between attempts
+    std::atomic<bool> m_locked{false};
+};
+
+}}
+#endif //MPUTILS_SPINLOCK_H
@@ -0,0 +1,200 @@
+/*
+ * mpUtils
+ * SpscQueue.h
+ *
+ * @author: Hendrik Schwanekamp
+ * @mail:   hendrik.schwanekamp@gmx.net
+ *
+ * Implements the SpscQueue class
+ *
+ * Copyright (c) 2021 Hendrik Schwanekamp
+ *
+ */
+
+#ifndef MPUTILS_SPSCQUEUE_H
+#define MPUTILS_SPSCQUEUE_H
+
+// includes
+//--------------------
+#include <atomic>
+#include <memory>
+#include <new>
+#include <utility>
+#include <algorithm>
+#include <type_traits>
+#include "mpUtils/Threading/concurrent/SpinLock.h"
+//--------------------
+
+// namespace
+//--------------------
+namespace mpu {
+namespace concurrent {
+//--------------------
+
+/**
+ * @brief returns the smallest power of two that is >= n
+ */
+inline std::size_t nextPowerOfTwo(std::size_t n)
+{
+    std::size_t p = 1;
+    while(p < n)
+        p *= 2;
+    return p;
+}
+
+//-------------------------------------------------------------------
+/**
+ * class SpscQueue
+ *
+ * A bounded lock free fifo queue for exactly one producer thread and one consumer thread.
+ * The capacity is rounded up to a power of two. Push and pop never block or allocate, they return false
+ * if the queue is full or empty. Bulk operations transfer as many elements as possible with a single
+ * synchronization and are much faster than pushing elements one by one.
+ * Producer and consumer each keep a cached copy of the other sides index, so they only touch the
+ * others cache line when the cached value says the queue is full or empty.
+ *
+ */
+template <typename T>
+class SpscQueue
+{
+public:
+    explicit SpscQueue(std::size_t capacity);
+    ~SpscQueue();
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    // producer side
+    template <typename... Args>
+    bool tryEmplace(Args&&... args); //!< construct an element in place, returns false if the queue is full
+    bool tryPush(const T& v) {return tryEmplace(v);} //!< add an element, returns false if the queue is full
+    bool tryPush(T&& v) {return tryEmplace(std::move(v));} //!< add an element, returns false if the queue is full
+    template <typename InputIt>
+    std::size_t tryPushBulk(InputIt first, std::size_t count); //!< moves up to count elements into the queue, returns the number of elements pushed
+
+    // consumer side
+    bool tryPop(T& out); //!< moves the oldest element to out, returns false if the queue is empty
+    template <typename OutputIt>
+    std::size_t tryPopBulk(OutputIt out, std::size_t maxCount); //!< moves up to maxCount elements to out, returns the number of elements popped
+
+    std::size_t sizeApprox() const; //!< number of elements, only exact if neither side is active
+    std::size_t capacity() const {return m_mask + 1;} //!< maximum number of elements
+
+private:
+    T* slot(std::size_t i) {return reinterpret_cast<T*>(&m_storage[i & m_mask]);}
+
+    using Storage = typename std::aligned_storage<sizeof(T), alignof(T)>::type;
+    const std::size_t m_mask;
+    std::unique_ptr<Storage[]> m_storage;
+
+    alignas(cacheLineSize) std::atomic<std::size_t> m_head{0}; //!< next element to pop, written by the consumer
+    std::size_t m_cachedTail{0}; //!< consumers copy of m_tail
+
+    alignas(cacheLineSize) std::atomic<std::size_t> m_tail{0}; //!< next free slot, written by the producer
+    std::size_t m_cachedHead{0}; //!< producers copy of m_head
+    char m_padding[cacheLineSize - sizeof(std::size_t)*2];
+};
+
+// template function definition
+//-------------------------------------------------------------------
+
+template <typename T>
+SpscQueue<T>::SpscQueue(std::size_t capacity)
+    : m_mask(nextPowerOfTwo(std::max(capacity, std::size_t(2))) - 1),
+      m_storage(new Storage[m_mask + 1])
+{
+}
+
+template <typename T>
+SpscQueue<T>::~SpscQueue()
+{
+    for(std::size_t i = m_head.load(std::memory_order_relaxed); i != m_tail.load(std::memory_order_relaxed); ++i)
+        slot(i)->~T();
+}
+
+template <typename T>
+template <typename... Args>
+bool SpscQueue<T>::tryEmplace(Args&&... args)
+{
+    const std::size_t tail = m_tail.load(std::memory_order_relaxed);
+    if(tail - m_cachedHead > m_mask)
+    {
+        m_cachedHead = m_head.load(std::memory_order_acquire);
+        if(tail - m_cachedHead > m_mask)
+            return false;
+    }
+
+    ::new(static_cast<void*>(slot(tail))) T(std::forward<Args>(args)...);
+    m_tail.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+template <typename T>
+template <typename InputIt>
+std::size_t SpscQueue<T>::tryPushBulk(InputIt first, std::size_t count)
+{
+    const std::size_t tail = m_tail.load(std::memory_order_relaxed);
+    std::size_t space = capacity() - (tail - m_cachedHead);
+    if(space < count)
+    {
+        m_cachedHead = m_head.load(std::memory_order_acquire);
+        space = capacity() - (tail - m_cachedHead);
+    }
+
+    const std::size_t n = std::min(space, count);
+    for(std::size_t i = 0; i < n; ++i, ++first)
+        ::new(static_cast<void*>(slot(tail + i))) T(std::move(*first));
+    m_tail.store(tail + n, std::memory_order_release);
+    return n;
+}
+
+template <typename T>
+bool SpscQueue<T>::tryPop(T& out)
+{
+    const std::size_t head = m_head.load(std::memory_order_relaxed);
+    if(head == m_cachedTail)
+    {
+        m_cachedTail = m_tail.load(std::memory_order_acquire);
+        if(head == m_cachedTail)
+            return false;
+    }
+
+    T* element = slot(head);
+    out = std::move(*element);
+    element->~T();
+    m_head.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+template <typename T>
+template <typename OutputIt>
+std::size_t SpscQueue<T>::tryPopBulk(OutputIt out, std::size_t maxCount)
+{
+    const std::size_t head = m_head.load(std::memory_order_relaxed);
+    std::size_t available = m_cachedTail - head;
+    if(available < maxCount)
+    {
+        m_cachedTail = m_tail.load(std::memory_order_acquire);
+        available = m_cachedTail - head;
+    }
+
+    const std::size_t n = std::min(available, maxCount);
+    for(std::size_t i = 0; i < n; ++i, ++out)
+    {
+        T* element = slot(head + i);
+        *out = std::move(*element);
+        element->~T();
+    }
+    m_head.store(head + n, std::memory_order_release);
+    return n;
+}
+
+template <typename T>
+std::size_t SpscQueue<T>::sizeApprox() const
+{
+    const std::size_t head = m_head.load(std::memory_order_acquire);
+    const std::size_t tail = m_tail.load(std::memory_order_acquire);
+    return (tail >= head) ? tail - head : 0;
+}
+
+}}
+#endif //MPUTILS_SPSCQUEUE_H
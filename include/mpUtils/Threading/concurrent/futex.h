@@ -0,0 +1,48 @@
+/*
+ * mpUtils
+ * futex.h
+ *
+ * @author: Hendrik Schwanekamp
+ * @mail:   hendrik.schwanekamp@gmx.net
+ *
+ * Declares functions to put threads to sleep on an atomic variable
+ *
+ * Copyright (c) 2021 Hendrik Schwanekamp
+ *
+ */
+
+#ifndef MPUTILS_FUTEX_H
+#define MPUTILS_FUTEX_H
+
+// includes
+//--------------------
+#include <atomic>
+#include <cstdint>
+//--------------------
+
+// namespace
+//--------------------
+namespace mpu {
+namespace concurrent {
+//--------------------
+
+/**
+ * @brief Blocks the calling thread as long as *address == expected, or until another thread calls futexWake()
+ *      on the same address. Might return spuriously, so always check the condition again.
+ *      On linux this is the futex system call, which costs nothing as long as there is no contention.
+ *      Other platforms use a hashed table of mutexes and condition variables.
+ */
+void futexWait(std::atomic<uint32_t>* address, uint32_t expected);
+
+/**
+ * @brief Wakes up to count threads waiting in futexWait() on address.
+ */
+void futexWake(std::atomic<uint32_t>* address, int count);
+
+/**
+ * @brief Wakes all threads waiting in futexWait() on address.
+ */
+void futexWakeAll(std::atomic<uint32_t>* address);
+
+}}
+#endif //MPUTILS_FUTEX_H
@@ -0,0 +1,74 @@
+/*
+ * mpUtils
+ * cpuAffinity.h
+ *
+ * @author: Hendrik Schwanekamp
+ * @mail:   hendrik.schwanekamp@gmx.net
+ *
+ * Copyright (c) 2021 Hendrik Schwanekamp
+ *
+ */
+#ifndef MPUTILS_CPUAFFINITY_H
+#define MPUTILS_CPUAFFINITY_H
+
+// includes
+//--------------------
+#include <vector>
+#include <thread>
+//--------------------
+
+// namespace
+//--------------------
+namespace mpu {
+//--------------------
+
+/**
+ * @brief how threads are placed on the available cores
+ */
+enum class AffinityPolicy
+{
+    none,       //!< keep the cores in the order they were given
+    compact,    //!< fill one numa node after the other, threads that work together share caches
+    scatter     //!< distribute threads evenly over all numa nodes, maximizes the available memory bandwidth
+};
+
+/**
+ * @brief Returns the ids of all logical cores the process is allowed to run on.
+ */
+std::vector<int> availableCores();
+
+/**
+ * @brief Returns the number of numa nodes of the system, 1 if the numa topology is unknown.
+ */
+int numNumaNodes();
+
+/**
+ * @brief Returns all cores from availableCores() that belong to numa node node.
+ */
+std::vector<int> coresOfNumaNode(int node);
+
+/**
+ * @brief Returns the numa node of core, 0 if the numa topology is unknown.
+ */
+int numaNodeOfCore(int core);
+
+/**
+ * @brief Sorts cores according to policy. Assigning the i-th thread to the i-th core
+ *      of the result places threads as described in AffinityPolicy.
+ */
+std::vector<int> orderCores(AffinityPolicy policy, std::vector<int> cores = availableCores());
+
+/**
+ * @brief Restricts thread to run only on the given cores. An empty list allows all available cores.
+ * @return false if the affinity could not be set or is not supported on this platform
+ */
+bool setThreadAffinity(std::thread& thread, const std::vector<int>& cores);
+
+/**
+ * @brief Restricts the calling thread to run only on the given cores. An empty list allows all available cores.
+ * @return false if the affinity could not be set or is not supported on this platform
+ */
+bool setCurrentThreadAffinity(const std::vector<int>& cores);
+
+}
+#endif //MPUTILS_CPUAFFINITY_H
@@ -0,0 +1,31 @@
+/*
+ * mpUtils
+ * globalThreadPool.h
+ *
+ * @author: Hendrik Schwanekamp
+ * @mail:   hendrik.schwanekamp@gmx.net
+ *
+ * Copyright (c) 2021 Hendrik Schwanekamp
+ *
+ */
+#ifndef MPUTILS_GLOBALTHREADPOOL_H
+#define MPUTILS_GLOBALTHREADPOOL_H
+
+// includes
+//--------------------
+#include "mpUtils/external/threadPool/ThreadPool.h"
+//--------------------
+
+// namespace
+//--------------------
+namespace mpu {
+//--------------------
+
+/**
+ * @brief Returns a thread pool shared by the whole application. It is created on first use with one thread per core.
+ *      The parallel algorithms of mpUtils run on this pool unless a different pool is specified.
+ */
+ThreadPool& globalThreadPool();
+
+}
+#endif //MPUTILS_GLOBALTHREADPOOL_H
@@ -0,0 +1,76 @@
+/*
+ * mpUtils
+ * numa.h
+ *
+ * @author: Hendrik Schwanekamp
+ * @mail:   hendrik.schwanekamp@gmx.net
+ *
+ * Copyright (c) 2021 Hendrik Schwanekamp
+ *
+ */
+#ifndef MPUTILS_NUMA_H
+#define MPUTILS_NUMA_H
+
+// includes
+//--------------------
+#include <memory>
+#include <vector>
+#include <type_traits>
+#include "mpUtils/Threading/cpuAffinity.h"
+#include "mpUtils/Threading/parallelFor.h"
+//--------------------
+
+// namespace
+//--------------------
+namespace mpu {
+//--------------------
+
+/**
+ * @brief Creates one ThreadPool per numa node. The workers of each pool are pinned to the cores of their node,
+ *      so data allocated with makeFirstTouchArray() on a pool stays in memory local to that node.
+ * @param threadsPerNode number of workers per pool, 0 creates one worker per core of the node
+ * @return the pools, index i belongs to numa node i
+ */
+std::vector<std::unique_ptr<ThreadPool>> makeNumaThreadPools(std::size_t threadsPerNode = 0);
+
+/**
+ * @brief Allocates an array of n elements and initializes it to value using the workers of pool.
+ *      The operating system places a memory page on the numa node of the thread that first writes to it.
+ *      Allocating with new or std::vector writes all elements from the calling thread, which puts everything on one node.
+ *      Initializing the memory from the pool instead puts the pages close to the threads that will use them later.
+ *      On a pool created by makeNumaThreadPools() all memory ends up on that pools node.
+ * @param n number of elements
+ * @param pool the pool whose workers initialize the memory
+ * @param value initial value of all elements
+ * @return the initialized array
+ */
+template <typename T>
+std::unique_ptr<T[]> makeFirstTouchArray(std::size_t n, ThreadPool& pool, const T& value = T());
+
+// template function definition
+//-------------------------------------------------------------------
+
+template <typename T>
+std::unique_ptr<T[]> makeFirstTouchArray(std::size_t n, ThreadPool& pool, const T& value)
+{
+    static_assert(std::is_trivially_default_constructible<T>::value,
+                  "makeFirstTouchArray needs a type that does not initialize memory when default constructed.");
+
+    // default initialization of trivial types leaves the memory untouched
+    std::unique_ptr<T[]> data(new T[n]);
+    T* ptr = data.get();
+
+    // run the loop from inside the pool, so the calling thread does not touch any memory itself
+    ParallelSettings settings;
+    settings.schedule = Schedule::staticChunks;
+    settings.pool = &pool;
+    pool.enqueue([&]()
+    {
+        parallel_for(Range<std::size_t>(n), [&](std::size_t i){ ptr[i] = value; }, settings);
+    }).get();
+
+    return data;
+}
+
+}
+#endif //MPUTILS_NUMA_H
@@ -0,0 +1,538 @@
+/*
+ * mpUtils
+ * parallelAlgorithms.h
+ *
+ * @author: Hendrik Schwanekamp
+ * @mail:   hendrik.schwanekamp@gmx.net
+ *
+ * Copyright (c) 2021 Hendrik Schwanekamp
+ *
+ */
+#ifndef MPUTILS_PARALLELALGORITHMS_H
+#define MPUTILS_PARALLELALGORITHMS_H
+
+// includes
+//--------------------
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <type_traits>
+#include <vector>
+#include "mpUtils/Threading/parallelFor.h"
+//--------------------
+
+// namespace
+//--------------------
+namespace mpu {
+//--------------------
+
+/**
+ * @brief Sorts the keys in [keysFirst,keysLast) in ascending order using a parallel LSD radix sort.
+ *      The values starting at valuesFirst are reordered together with their keys. The sort is stable.
+ *      Supported keys are all integer types as well as float and double. NaN is sorted according to its sign bit.
+ *      Radix sort needs O(n) additional memory and is usually much faster than comparison based sorting for large arrays.
+ * @param keysFirst random access iterator to the first key
+ * @param keysLast random access iterator behind the last key
+ * @param valuesFirst random access iterator to the first value
+ * @param settings pool and grain size to use, schedule is ignored
+ */
+template <typename KeyIt, typename ValueIt>
+void parallel_radix_sort(KeyIt keysFirst, KeyIt keysLast, ValueIt valuesFirst, const ParallelSettings& settings = {});
+
+/**
+ * @brief Sorts the keys in [keysFirst,keysLast) in ascending order using a parallel LSD radix sort.
+ *      See the overload with values for details.
+ */
+template <typename KeyIt>
+void parallel_radix_sort(KeyIt keysFirst, KeyIt keysLast, const ParallelSettings& settings = {});
+
+/**
+ * @brief Sorts [first,last) according to comp using a parallel merge sort. Sorting is stable.
+ *      The value type needs to be default constructible and move assignable. Needs O(n) additional memory.
+ * @param first random access iterator to the first element
+ * @param last random access iterator behind the last element
+ * @param comp comparison function object returning true if the first argument is less than the second
+ * @param settings pool and grain size to use, schedule is ignored
+ */
+template <typename RandomIt, typename Compare = std::less<>>
+void parallel_merge_sort(RandomIt first, RandomIt last, Compare comp = Compare(), const ParallelSettings& settings = {});
+
+/**
+ * @brief Computes the inclusive prefix scan out[i] = in[0] op in[1] op ... op in[i] in parallel.
+ *      op needs to be associative. Output may be the same as the input.
+ * @return iterator behind the last element written
+ */
+template <typename InputIt, typename OutputIt, typename BinaryOp = std::plus<>>
+OutputIt parallel_inclusive_scan(InputIt first, InputIt last, OutputIt out, BinaryOp op = BinaryOp(),
+                                 const ParallelSettings& settings = {});
+
+/**
+ * @brief Computes the exclusive prefix scan out[i] = init op in[0] op ... op in[i-1] in parallel.
+ *      op needs to be associative. Output may be the same as the input.
+ * @return iterator behind the last element written
+ */
+template <typename InputIt, typename OutputIt, typename T, typename BinaryOp = std::plus<>>
+OutputIt parallel_exclusive_scan(InputIt first, InputIt last, OutputIt out, T init, BinaryOp op = BinaryOp(),
+                                 const ParallelSettings& settings = {});
+
+/**
+ * @brief Reorders [first,last) in parallel, so that all elements for which pred returns true come before the others.
+ *      The relative order of elements within each group is preserved. pred is called exactly once per element.
+ *      The value type needs to be default constructible and move assignable. Needs O(n) additional memory.
+ * @return iterator to the first element of the second group
+ */
+template <typename RandomIt, typename Predicate>
+RandomIt parallel_stable_partition(RandomIt first, RandomIt last, Predicate pred, const ParallelSettings& settings = {});
+
+// helper functions
+//-------------------------------------------------------------------
+namespace detail {
+
+    //!< number of blocks an array of n elements is split into for parallel processing, every block of size (n + numBlocks - 1) / numBlocks contains at least one element
+    inline std::size_t numParallelBlocks(std::size_t n, const ParallelSettings& settings, const ThreadPool& pool)
+    {
+        const std::size_t minBlockSize = settings.grainSize > 0 ? settings.grainSize : 4096;
+        const std::size_t numBlocks = std::max( std::min(pool.getPoolSize() + 1, n / minBlockSize), std::size_t(1));
+        // rounding up the block size can leave trailing blocks empty, eg n=7 and 5 blocks gives blocks of 2 and only 4 are needed
+        const std::size_t blockSize = (n + numBlocks - 1) / numBlocks;
+        return blockSize > 0 ? (n + blockSize - 1) / blockSize : 1;
+    }
+
+    //!< maps keys to unsigned integers with the same ordering
+    template <typename K, typename Enable = void> struct RadixTraits;
+
+    template <typename K>
+    struct RadixTraits<K, std::enable_if_t<std::is_integral<K>::value>>
+    {
+        using BitsType = std::make_unsigned_t<K>;
+        static BitsType toBits(K k)
+        {
+            BitsType bits = static_cast<BitsType>(k);
+            if(std::is_signed<K>::value)
+                bits ^= BitsType(1) << (sizeof(K)*8-1);
+            return bits;
+        }
+    };
+
+    template <typename K>
+    struct RadixTraits<K, std::enable_if_t<std::is_floating_point<K>::value>>
+    {
+        using BitsType = std::conditional_t< sizeof(K) == 4, uint32_t, uint64_t>;
+        static BitsType toBits(K k)
+        {
+            static_assert(sizeof(K) == sizeof(BitsType), "Unsupported floating point type.");
+            BitsType bits;
+            std::memcpy(&bits, &k, sizeof(K));
+            const BitsType signBit = BitsType(1) << (sizeof(K)*8-1);
+            return (bits & signBit) ? ~bits : (bits | signBit);
+        }
+    };
+
+    //!< used as value iterator when sorting keys without payload
+    struct NoPayloadIt
+    {
+        struct Empty {};
+        using value_type = Empty;
+        Empty operator[](std::size_t) const {return {};}
+    };
+
+    //!< temporary buffer for the payload during radix sort
+    template <typename ValueIt>
+    struct PayloadBuffer
+    {
+        using ValueT = typename std::iterator_traits<ValueIt>::value_type;
+        explicit PayloadBuffer(std::size_t n) : data(n) {}
+        typename std::vector<ValueT>::iterator begin() {return data.begin();}
+        std::vector<ValueT> data;
+    };
+
+    template <>
+    struct PayloadBuffer<NoPayloadIt>
+    {
+        explicit PayloadBuffer(std::size_t) {}
+        NoPayloadIt begin() {return {};}
+    };
+
+    template <typename KeyIt, typename ValueIt>
+    void radixSortImpl(KeyIt keys, ValueIt values, std::size_t n, const ParallelSettings& settings)
+    {
+        using KeyT = typename std::iterator_traits<KeyIt>::value_type;
+        using Traits = RadixTraits<KeyT>;
+        constexpr int radixBits = 8;
+        constexpr std::size_t numBuckets = 1 << radixBits;
+        constexpr int numPasses = sizeof(KeyT);
+        using Histogram = std::array<std::size_t, numBuckets>;
+
+        if(n < 2)
+            return;
+
+        ThreadPool& pool = settings.pool ? *settings.pool : globalThreadPool();
+        const std::size_t numBlocks = numParallelBlocks(n, settings, pool);
+        const std::size_t blockSize = (n + numBlocks - 1) / numBlocks;
+        const ParallelSettings blockSettings{Schedule::dynamicChunks, 1, &pool};
+
+        // compute histograms of all passes at once, so passes where all keys share the same digit can be skipped
+        std::vector<std::array<Histogram, numPasses>> blockHistograms(numBlocks);
+        parallel_for(Range<std::size_t>(numBlocks), [&](std::size_t b)
+        {
+            auto& hist = blockHistograms[b];
+            for(auto& h : hist)
+                h.fill(0);
+            const std::size_t end = std::min(n, (b+1) * blockSize);
+            for(std::size_t i = b * blockSize; i < end; ++i)
+            {
+                auto bits = Traits::toBits(keys[i]);
+                for(int p = 0; p < numPasses; ++p)
+                    ++hist[p][(bits >> (p * radixBits)) & (numBuckets-1)];
+            }
+        }, blockSettings);
+
+        std::vector<KeyT> tmpKeys(n);
+        PayloadBuffer<ValueIt> tmpValues(n);
+        bool dataInTemp = false;
+        bool dataMoved = false;
+        std::vector<Histogram> offsets(numBlocks);
+
+        for(int p = 0; p < numPasses; ++p)
+        {
+            // skip pass if all keys share the same digit, the totals do not depend on the current order
+            bool trivialPass = false;
+            for(std::size_t d = 0; d < numBuckets && !trivialPass; ++d)
+            {
+                std::size_t digitTotal = 0;
+                for(std::size_t b = 0; b < numBlocks; ++b)
+                    digitTotal += blockHistograms[b][p][d];
+                trivialPass = (digitTotal == n);
+            }
+            if(trivialPass)
+                continue;
+
+            auto digit = [p](const KeyT& k){ return (Traits::toBits(k) >> (p * radixBits)) & (numBuckets-1); };
+
+            // after the first scatter blocks contain different keys, so their histograms need to be recomputed
+            if(dataMoved)
+            {
+                auto recount = [&](auto srcKeys)
+                {
+                    parallel_for(Range<std::size_t>(numBlocks), [&](std::size_t b)
+                    {
+                        Histogram& hist = blockHistograms[b][p];
+                        hist.fill(0);
+                        const std::size_t end = std::min(n, (b+1) * blockSize);
+                        for(std::size_t i = b * blockSize; i < end; ++i)
+                            ++hist[digit(srcKeys[i])];
+                    }, blockSettings);
+                };
+                if(dataInTemp)
+                    recount(tmpKeys.begin());
+                else
+                    recount(keys);
+            }
+
+            // compute the starting position of each digit in each block
+            std::size_t sum = 0;
+            for(std::size_t d = 0; d < numBuckets; ++d)
+                for(std::size_t b = 0; b < numBlocks; ++b)
+                {
+                    offsets[b][d] = sum;
+                    sum += blockHistograms[b][p][d];
+                }
+
+            // scatter every block stable into its place
+            auto scatter = [&](auto srcKeys, auto srcValues, auto dstKeys, auto dstValues)
+            {
+                parallel_for(Range<std::size_t>(numBlocks), [&](std::size_t b)
+                {
+                    Histogram& offset = offsets[b];
+                    const std::size_t end = std::min(n, (b+1) * blockSize);
+                    for(std::size_t i = b * blockSize; i < end; ++i)
+                    {
+                        const std::size_t dst = offset[digit(srcKeys[i])]++;
+                        dstKeys[dst] = std::move(srcKeys[i]);
+                        dstValues[dst] = std::move(srcValues[i]);
+                    }
+                }, blockSettings);
+            };
+
+            if(dataInTemp)
+                scatter(tmpKeys.begin(), tmpValues.begin(), keys, values);
+            else
+                scatter(keys, values, tmpKeys.begin(), tmpValues.begin());
+            dataInTemp = !dataInTemp;
+            dataMoved = true;
+        }
+
+        if(dataInTemp)
+        {
+            auto tk = tmpKeys.begin();
+            auto tv = tmpValues.begin();
+            parallel_for(Range<std::size_t>(n), [&](std::size_t i)
+            {
+                keys[i] = std::move(tk[i]);
+                values[i] = std::move(tv[i]);
+            }, ParallelSettings{Schedule::dynamicChunks, blockSize, &pool});
+        }
+    }
+
+    //!< stable merge of the sorted ranges [a,a+na) and [b,b+nb) into out, using multiple threads for big inputs
+    template <typename InIt, typename OutIt, typename Compare>
+    void parallelMerge(InIt a, std::size_t na, InIt b, std::size_t nb, OutIt out, Compare& comp,
+                       std::size_t numPieces, ThreadPool& pool)
+    {
+        numPieces = std::max(std::min(numPieces, na), std::size_t(1));
+
+        // split a into pieces and find the matching split points in b
+        std::vector<std::size_t> splitA(numPieces+1);
+        std::vector<std::size_t> splitB(numPieces+1);
+        for(std::size_t i = 0; i < numPieces; ++i)
+        {
+            splitA[i] = i * na / numPieces;
+            splitB[i] = (i == 0) ? 0 : std::lower_bound(b, b+nb, a[splitA[i]], comp) - b;
+        }
+        splitA[numPieces] = na;
+        splitB[numPieces] = nb;
+
+        parallel_for(Range<std::size_t>(numPieces), [&](std::size_t i)
+        {
+            InIt ia = a + splitA[i];
+            InIt ea = a + splitA[i+1];
+            InIt ib = b + splitB[i];
+            InIt eb = b + splitB[i+1];
+            OutIt o = out + (splitA[i] + splitB[i]);
+            while(ia != ea && ib != eb)
+                *o++ = comp(*ib, *ia) ? std::move(*ib++) : std::move(*ia++);
+            o = std::move(ia, ea, o);
+            std::move(ib, eb, o);
+        }, ParallelSettings{Schedule::dynamicChunks, 1, &pool});
+    }
+}
+
+// template function definition
+//-------------------------------------------------------------------
+
+template <typename KeyIt, typename ValueIt>
+void parallel_radix_sort(KeyIt keysFirst, KeyIt keysLast, ValueIt valuesFirst, const ParallelSettings& settings)
+{
+    detail::radixSortImpl(keysFirst, valuesFirst, std::distance(keysFirst,keysLast), settings);
+}
+
+template <typename KeyIt>
+void parallel_radix_sort(KeyIt keysFirst, KeyIt keysLast, const ParallelSettings& settings)
+{
+    detail::radixSortImpl(keysFirst, detail::NoPayloadIt(), std::distance(keysFirst,keysLast), settings);
+}
+
+template <typename RandomIt, typename Compare>
+void parallel_merge_sort(RandomIt first, RandomIt last, Compare comp, const ParallelSettings& settings)
+{
+    using T = typename std::iterator_traits<RandomIt>::value_type;
+    ThreadPool& pool = settings.pool ? *settings.pool : globalThreadPool();
+    const std::size_t n = std::distance(first, last);
+    const std::size_t numBlocks = detail::numParallelBlocks(n, settings, pool);
+    if(numBlocks == 1)
+    {
+        std::stable_sort(first, last, comp);
+        return;
+    }
+
+    // sort blocks independently
+    std::vector<std::size_t> runStart(numBlocks+1);
+    for(std::size_t b = 0; b <= numBlocks; ++b)
+        runStart[b] = b * n / numBlocks;
+    parallel_for(Range<std::size_t>(numBlocks), [&](std::size_t b)
+    {
+        std::stable_sort(first + runStart[b], first + runStart[b+1], comp);
+    }, ParallelSettings{Schedule::dynamicChunks, 1, &pool});
+
+    // merge pairs of runs until only one is left, alternating between the input and a buffer
+    std::vector<T> buffer(n);
+    bool dataInBuffer = false;
+    while(runStart.size() > 2)
+    {
+        const std::size_t numRuns = runStart.size()-1;
+        const std::size_t piecesPerMerge = std::max( (pool.getPoolSize()+1) / (numRuns/2), std::size_t(1));
+        std::vector<std::size_t> newRunStart;
+        for(std::size_t r = 0; r < numRuns; r += 2)
+            newRunStart.push_back(runStart[r]);
+        newRunStart.push_back(n);
+
+        auto mergeRuns = [&](auto src, auto dst)
+        {
+            parallel_for(Range<std::size_t>(0, numRuns, 2), [&](std::size_t r)
+            {
+                const std::size_t s = runStart[r];
+                const std::size_t m = runStart[r+1];
+                if(r+1 == numRuns)
+                    std::move(src + s, src + m, dst + s); // odd run out is just copied
+                else
+                    detail::parallelMerge(src + s, m-s, src + m, runStart[r+2]-m, dst + s, comp, piecesPerMerge, pool);
+            }, ParallelSettings{Schedule::dynamicChunks, 1, &pool});
+        };
+
+        if(dataInBuffer)
+            mergeRuns(buffer.begin(), first);
+        else
+            mergeRuns(first, buffer.begin());
+        dataInBuffer = !dataInBuffer;
+        runStart = std::move(newRunStart);
+    }
+
+    if(dataInBuffer)
+    {
+        auto bufferIt = buffer.begin();
+        parallel_for(Range<std::size_t>(n), [&](std::size_t i){ first[i] = std::move(bufferIt[i]); },
+                     ParallelSettings{Schedule::staticChunks, 0, &pool});
+    }
+}
+
+template <typename InputIt, typename OutputIt, typename BinaryOp>
+OutputIt parallel_inclusive_scan(InputIt first, InputIt last, OutputIt out, BinaryOp op, const ParallelSettings& settings)
+{
+    using T = typename std::iterator_traits<InputIt>::value_type;
+    ThreadPool& pool = settings.pool ? *settings.pool : globalThreadPool();
+    const std::size_t n = std::distance(first, last);
+    if(n == 0)
+        return out;
+    const std::size_t numBlocks = detail::numParallelBlocks(n, settings, pool);
+    const std::size_t blockSize = (n + numBlocks - 1) / numBlocks;
+    const ParallelSettings blockSettings{Schedule::dynamicChunks, 1, &pool};
+
+    // reduce every block
+    std::vector<T> blockSums(numBlocks);
+    parallel_for(Range<std::size_t>(numBlocks), [&](std::size_t b)
+    {
+        const std::size_t end = std::min(n, (b+1) * blockSize);
+        T sum = first[b*blockSize];
+        for(std::size_t i = b*blockSize+1; i < end; ++i)
+            sum = op(sum, first[i]);
+        blockSums[b] = sum;
+    }, blockSettings);
+
+    // scan the block sums serially
+    for(std::size_t b = 1; b < numBlocks; ++b)
+        blockSums[b] = op(blockSums[b-1], blockSums[b]);
+
+    // scan every block, starting with the sum of all previous blocks
+    parallel_for(Range<std::size_t>(numBlocks), [&](std::size_t b)
+    {
+        const std::size_t end = std::min(n, (b+1) * blockSize);
+        std::size_t i = b*blockSize;
+        T sum = (b == 0) ? T(first[i]) : op(blockSums[b-1], first[i]);
+        out[i] = sum;
+        for(++i; i < end; ++i)
+        {
+            sum = op(sum, first[i]);
+            out[i] = sum;
+        }
+    }, blockSettings);
+
+    return out + n;
+}
+
+template <typename InputIt, typename OutputIt, typename T, typename BinaryOp>
+OutputIt parallel_exclusive_scan(InputIt first, InputIt last, OutputIt out, T init, BinaryOp op, const ParallelSettings& settings)
+{
+    ThreadPool& pool = settings.pool ? *settings.pool : globalThreadPool();
+    const std::size_t n = std::distance(first, last);
+    if(n == 0)
+        return out;
+    const std::size_t numBlocks = detail::numParallelBlocks(n, settings, pool);
+    const std::size_t blockSize = (n + numBlocks - 1) / numBlocks;
+    const ParallelSettings blockSettings{Schedule::dynamicChunks, 1, &pool};
+
+    // reduce every block
+    std::vector<T> blockSums(numBlocks);
+    parallel_for(Range<std::size_t>(numBlocks), [&](std::size_t b)
+    {
+        const std::size_t end = std::min(n, (b+1) * blockSize);
+        T sum = first[b*blockSize];
+        for(std::size_t i = b*blockSize+1; i < end; ++i)
+            sum = op(sum, first[i]);
+        blockSums[b] = sum;
+    }, blockSettings);
+
+    // exclusive scan of the block sums
+    T sum = init;
+    for(std::size_t b = 0; b < numBlocks; ++b)
+    {
+        T blockSum = std::move(blockSums[b]);
+        blockSums[b] = sum;
+        sum = op(sum, blockSum);
+    }
+
+    // scan every block, read the input before writing, so in place scanning works
+    parallel_for(Range<std::size_t>(numBlocks), [&](std::size_t b)
+    {
+        const std::size_t end = std::min(n, (b+1) * blockSize);
+        T blockSum = blockSums[b];
+        for(std::size_t i = b*blockSize; i < end; ++i)
+        {
+            T value = first[i];
+            out[i] = blockSum;
+            blockSum = op(blockSum, value);
+        }
+    }, blockSettings);
+
+    return out + n;
+}
+
+template <typename RandomIt, typename Predicate>
+RandomIt parallel_stable_partition(RandomIt first, RandomIt last, Predicate pred, const ParallelSettings& settings)
+{
+    using T = typename std::iterator_traits<RandomIt>::value_type;
+    ThreadPool& pool = settings.pool ? *settings.pool : globalThreadPool();
+    const std::size_t n = std::distance(first, last);
+    const std::size_t numBlocks = detail::numParallelBlocks(n, settings, pool);
+    const std::size_t blockSize = (n + numBlocks - 1) / numBlocks;
+    const ParallelSettings blockSettings{Schedule::dynamicChunks, 1, &pool};
+    if(n == 0)
+        return first;
+
+    // evaluate predicate and count per block
+    std::vector<char> flags(n);
+    std::vector<std::size_t> trueOffset(numBlocks);
+    parallel_for(Range<std::size_t>(numBlocks), [&](std::size_t b)
+    {
+        const std::size_t end = std::min(n, (b+1) * blockSize);
+        std::size_t count = 0;
+        for(std::size_t i = b*blockSize; i < end; ++i)
+        {
+            flags[i] = pred(first[i]) ? 1 : 0;
+            count += flags[i];
+        }
+        trueOffset[b] = count;
+    }, blockSettings);
+
+    // compute where every block writes its elements
+    std::size_t numTrue = 0;
+    for(std::size_t b = 0; b < numBlocks; ++b)
+    {
+        std::size_t count = trueOffset[b];
+        trueOffset[b] = numTrue;
+        numTrue += count;
+    }
+
+    // move to the buffer and back
+    std::vector<T> buffer(n);
+    parallel_for(Range<std::size_t>(numBlocks), [&](std::size_t b)
+    {
+        const std::size_t begin = b*blockSize;
+        const std::size_t end = std::min(n, (b+1) * blockSize);
+        std::size_t t = trueOffset[b];
+        std::size_t f = numTrue + (begin - trueOffset[b]);
+        for(std::size_t i = begin; i < end; ++i)
+            buffer[flags[i] ? t++ : f++] = std::move(first[i]);
+    }, blockSettings);
+
+    auto bufferIt = buffer.begin();
+    parallel_for(Range<std::size_t>(n), [&](std::size_t i){ first[i] = std::move(bufferIt[i]); },
+                 ParallelSettings{Schedule::staticChunks, 0, &pool});
+
+    return first + numTrue;
+}
+
+}
+#endif //MPUTILS_PARALLELALGORITHMS_H
@@ -0,0 +1,248 @@
+/*
+ * mpUtils
+ * parallelFor.h
+ *
+ * @author: Hendrik Schwanekamp
+ * @mail:   hendrik.schwanekamp@gmx.net
+ *
+ * Copyright (c) 2021 Hendrik Schwanekamp
+ *
+ */
+#ifndef MPUTILS_PARALLELFOR_H
+#define MPUTILS_PARALLELFOR_H
+
+// includes
+//--------------------
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include "mpUtils/Misc/Range.h"
+#include "mpUtils/Threading/globalThreadPool.h"
+//--------------------
+
+// namespace
+//--------------------
+namespace mpu {
+//--------------------
+
+/**
+ * @brief how the iterations of a parallel loop are distributed over the threads
+ */
+enum class Schedule
+{
+    automatic,      //!< dynamic scheduling with an automatically selected grain size
+    staticChunks,   //!< the range is split into one equally sized chunk per thread
+    dynamicChunks   //!< the range is split into chunks of grainSize elements, threads grab new chunks when they are done
+};
+
+/**
+ * @brief settings for parallel_for, parallel_reduce and parallel_transform
+ */
+struct ParallelSettings
+{
+    Schedule schedule = Schedule::automatic; //!< how work is distributed
+    std::size_t grainSize = 0; //!< minimum number of iterations per chunk, 0 selects automatically
+    ThreadPool* pool = nullptr; //!< the pool to run on, nullptr uses the globalThreadPool()
+};
+
+/**
+ * @brief Calls f(i) for every i in range, using the threads of a ThreadPool. This is the cpu analogue of the
+ *      gridStrideRange. The calling thread works on the loop as well and only waits for chunks which are
+ *      already being processed by another thread. That makes it safe to nest parallel loops or to call them from
+ *      inside a task running on the same pool. If f throws, remaining chunks are skipped and the first exception
+ *      is rethrown in the calling thread.
+ * @param range the range to iterate over
+ * @param f function to be called for each element of range
+ * @param settings scheduling policy, grain size and pool to use
+ */
+template <typename T, typename F>
+void parallel_for(const Range<T>& range, F&& f, const ParallelSettings& settings = {});
+
+/**
+ * @brief Computes reduce(...reduce(reduce(identity, map(range[0])), map(range[1]))..., map(range[n-1])) in parallel.
+ *      reduce needs to be associative. Partial results are combined in order, so it does not need to be commutative.
+ * @param range the range to iterate over
+ * @param identity identity element of reduce (eg 0 for addition)
+ * @param map function called for each element of the range
+ * @param reduce function to combine two results
+ * @param settings scheduling policy, grain size and pool to use
+ * @return the reduced value
+ */
+template <typename T, typename V, typename MapF, typename ReduceF>
+V parallel_reduce(const Range<T>& range, V identity, MapF&& map, ReduceF&& reduce, const ParallelSettings& settings = {});
+
+/**
+ * @brief Writes f(range[i]) to out[i] for every element in range in parallel.
+ * @param range the range to iterate over
+ * @param out random access iterator to the beginning of the output, needs to have at least range.size() elements
+ * @param f function to be called for each element of range
+ * @param settings scheduling policy, grain size and pool to use
+ */
+template <typename T, typename RandomIt, typename F>
+void parallel_transform(const Range<T>& range, RandomIt out, F&& f, const ParallelSettings& settings = {});
+
+// helper functions
+//-------------------------------------------------------------------
+namespace detail {
+
+    /**
+     * @brief state shared between the calling thread and the helper tasks of a parallel loop
+     */
+    class ChunkedWork
+    {
+    public:
+        ChunkedWork(std::size_t chunks, void* func, void (*call)(void*, std::size_t))
+            : m_numChunks(chunks), m_func(func), m_call(call) {}
+
+        void process() //!< claims and processes chunks until there are none left
+        {
+            for(;;)
+            {
+                std::size_t c = m_nextChunk.fetch_add(1, std::memory_order_relaxed);
+                if(c >= m_numChunks)
+                    return;
+
+                if(!m_failed.load(std::memory_order_relaxed))
+                {
+                    try
+                    {
+                        m_call(m_func, c);
+                    } catch(...)
+                    {
+                        std::lock_guard<std::mutex> lck(m_mtx);
+                        if(!m_exception)
+                            m_exception = std::current_exception();
+                        m_failed = true;
+                    }
+                }
+
+                if(m_chunksDone.fetch_add(1, std::memory_order_acq_rel) + 1 == m_numChunks)
+                {
+                    std::lock_guard<std::mutex> lck(m_mtx);
+                    m_cv.notify_all();
+                }
+            }
+        }
+
+        void wait() //!< wait until all chunks are done and rethrow exceptions
+        {
+            std::unique_lock<std::mutex> lck(m_mtx);
+            m_cv.wait(lck, [this]{ return m_chunksDone.load(std::memory_order_acquire) == m_numChunks; });
+            if(m_exception)
+                std::rethrow_exception(m_exception);
+        }
+
+    private:
+        const std::size_t m_numChunks;
+        void* const m_func; // only dereferenced after a chunk was successfully claimed
+        void (* const m_call)(void*, std::size_t);
+        std::atomic<std::size_t> m_nextChunk{0};
+        std::atomic<std::size_t> m_chunksDone{0};
+        std::atomic<bool> m_failed{false};
+        std::exception_ptr m_exception;
+        std::mutex m_mtx;
+        std::condition_variable m_cv;
+    };
+
+    /**
+     * @brief calls chunkFunc(c) for all c in [0,numChunks) using the calling thread and the threads of pool
+     */
+    template <typename ChunkF>
+    void runChunked(std::size_t numChunks, ChunkF& chunkFunc, ThreadPool& pool)
+    {
+        if(numChunks == 0)
+            return;
+        std::size_t helpers = std::min(pool.getPoolSize(), numChunks-1);
+        if(helpers == 0)
+        {
+            for(std::size_t c = 0; c < numChunks; ++c)
+                chunkFunc(c);
+            return;
+        }
+
+        auto work = std::make_shared<ChunkedWork>(numChunks, static_cast<void*>(&chunkFunc),
+                                                  [](void* f, std::size_t c){ (*static_cast<ChunkF*>(f))(c); });
+        for(std::size_t i = 0; i < helpers; ++i)
+            if(!pool.tryPost([work](){ work->process(); }))
+                break;
+
+        work->process();
+        work->wait();
+    }
+
+    /**
+     * @brief selects the chunk size for a range of n elements
+     */
+    inline std::size_t selectChunkSize(std::size_t n, const ParallelSettings& settings, const ThreadPool& pool)
+    {
+        std::size_t participants = pool.getPoolSize() + 1;
+        std::size_t chunk;
+        if(settings.schedule == Schedule::staticChunks)
+            chunk = std::max( (n + participants - 1) / participants, settings.grainSize);
+        else if(settings.grainSize > 0)
+            chunk = settings.grainSize;
+        else
+            chunk = n / (participants * 8); // some chunks per thread allow for load balancing
+        return std::max(chunk, std::size_t(1));
+    }
+}
+
+// template function definition
+//-------------------------------------------------------------------
+
+template <typename T, typename F>
+void parallel_for(const Range<T>& range, F&& f, const ParallelSettings& settings)
+{
+    ThreadPool& pool = settings.pool ? *settings.pool : globalThreadPool();
+    const std::size_t n = range.size();
+    const std::size_t chunkSize = detail::selectChunkSize(n, settings, pool);
+    const std::size_t numChunks = (n + chunkSize - 1) / chunkSize;
+
+    auto chunkFunc = [&](std::size_t c)
+    {
+        const std::size_t end = std::min(n, (c+1) * chunkSize);
+        for(std::size_t i = c * chunkSize; i < end; ++i)
+            f(range[i]);
+    };
+    detail::runChunked(numChunks, chunkFunc, pool);
+}
+
+template <typename T, typename V, typename MapF, typename ReduceF>
+V parallel_reduce(const Range<T>& range, V identity, MapF&& map, ReduceF&& reduce, const ParallelSettings& settings)
+{
+    ThreadPool& pool = settings.pool ? *settings.pool : globalThreadPool();
+    const std::size_t n = range.size();
+    const std::size_t chunkSize = detail::selectChunkSize(n, settings, pool);
+    const std::size_t numChunks = (n + chunkSize - 1) / chunkSize;
+
+    struct Partial { V value; }; // avoids the std::vector<bool> specialization
+    std::vector<Partial> partials(numChunks, Partial{identity});
+
+    auto chunkFunc = [&](std::size_t c)
+    {
+        V result = identity;
+        const std::size_t end = std::min(n, (c+1) * chunkSize);
+        for(std::size_t i = c * chunkSize; i < end; ++i)
+            result = reduce(std::move(result), map(range[i]));
+        partials[c].value = std::move(result);
+    };
+    detail::runChunked(numChunks, chunkFunc, pool);
+
+    V result = std::move(identity);
+    for(auto& p : partials)
+        result = reduce(std::move(result), std::move(p.value));
+    return result;
+}
+
+template <typename T, typename RandomIt, typename F>
+void parallel_transform(const Range<T>& range, RandomIt out, F&& f, const ParallelSettings& settings)
+{
+    parallel_for(Range<std::size_t>(range.size()), [&](std::size_t i){ out[i] = f(range[i]); }, settings);
+}
+
+}
+#endif //MPUTILS_PARALLELFOR_H
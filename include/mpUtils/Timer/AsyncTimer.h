@@ -25,6 +25,7 @@
 #include "Cpu_Clock.h"
 #include "mpUtils/Log/Log.h"
 #include "mpUtils/Misc/timeUtils.h"
+#include "mpUtils/Timer/TimerService.h"
 //--------------------
 
 // namespace
@@ -44,19 +45,25 @@ namespace mpu {
  * For easy use there are typedefs in mpUtils.h eg setDuration(seconds(1)).
  * If you want you can register a function to be called when the timer finishes or set the timer to looping which will make it
  * restart automatically.
- * Start the timer with start(). The timer checks if it is finished in a new thread it manages itself and therefore works
- * asynchronously. You can also stop the timer manually which prevents the registered function from being called.
+ * Start the timer with start(). The timer is managed by a TimerService (by default the globalTimerService()),
+ * which uses one thread for all timers. Starting and stopping a timer does not create or join any threads.
+ * You can also stop the timer manually which prevents the registered function from being called.
  * pause(), resume() and togglePause() can be used to pause the timer.
  *
- * Keep in mind that the registered function is also called in the other thread so make sure that all memory operations
- * this function does are thread safe.
+ * Keep in mind that the registered function is called in a thread of the thread pool used by the timer service,
+ * so make sure that all memory operations this function does are thread safe. Calls of the function of one timer
+ * never overlap.
  *
  * thread safety:
  * This class is totally thread safe and the same object can be modified from different threads
  * without causing data races.
+ * stop() waits for the function if it is currently being called. When called from a thread of the pool the
+ * timer service dispatches to, it does not wait for wakeups that are still queued in that pool, as they might
+ * only run once the calling task returns. They are discarded when they run. The destructor always waits for them,
+ * so when destroying a timer from a task of that pool, make sure the pool has another thread to run them.
  *
  * exceptions:
- * No Exceptions are thrown. If your registered function throws a exception it is caught and ignored.
+ * No Exceptions are thrown. If your registered function throws a exception it is caught and logged.
  * Note that throwing exceptions from the registered function is not recommended.
  *
  */
@@ -81,9 +88,10 @@ public:
     void setDuration(std::chrono::duration<rep, periode> newDuration); // sets the time after which the timer finishes
     void setFunction(std::function<void()> func); // sets the function to be called when the timer finishes
     void setLooping(bool shouldLoop); // sets if the timer should be looped
+    void setTimerService(TimerService& service); // sets the timer service used to run the timer, stops the timer
 
     inline void start(); // start (restart if already running) the timer
-    inline void stop(); // stop the timer
+    inline void stop(); // stop the timer, waits if the function is currently being called
 
     inline void pause(); // pause the timer
     inline void resume(); // resume the timer
@@ -100,11 +108,39 @@ private:
     std::function<void()> finishFunction; // function to call when timer finishes
     duration_type timerDuration; // the duration the timer is going to run
 
-    void update(); // the main function of the update thread
-    std::thread timerThread;
-    std::condition_variable cv;
+    TimerService* service; // the service used to wait for the timer
+    TimerService::TimerId timerId; // id of the currently scheduled wakeup
+    unsigned int wakeupSeq; // incremented whenever a wakeup is scheduled or cancelled, to ignore outdated wakeups
+    unsigned int pendingWakeups; // wakeups that were scheduled and not yet destroyed, protected by wakeupMtx
+    std::thread::id callbackThread; // thread currently calling finishFunction
+
+    /**
+     * @brief the task posted to the timer service, counts as pending until it is destroyed
+     *          so wakeups that are cancelled or discarded without being run are accounted for as well
+     */
+    class Wakeup
+    {
+    public:
+        Wakeup(basic_AsyncTimer* t, unsigned int s) : timer(t), seq(s) {}
+        Wakeup(Wakeup&& other) noexcept : timer(other.timer), seq(other.seq) {other.timer = nullptr;}
+        Wakeup(const Wakeup& other) = delete;
+        ~Wakeup() { if(timer) timer->wakeupDestroyed(); }
+        void operator()() { timer->onWakeup(seq); }
+    private:
+        basic_AsyncTimer* timer;
+        unsigned int seq;
+    };
+
+    void scheduleWakeup(); // schedule a wakeup when the remaining time is over, mtx needs to be locked
+    void cancelWakeup(); // cancel a scheduled wakeup, mtx needs to be locked
+    void onWakeup(unsigned int seq); // called by the timer service
+    void wakeupDestroyed(); // called when a wakeup was destroyed, after it was run, cancelled or discarded
+    void waitForWakeups(); // wait until all wakeups were destroyed, unless called by the timer function
+    std::condition_variable cv; // signaled when the timer function returns
     std::mutex mtx;
     std::mutex funcMtx;
+    std::condition_variable wakeupCv; // signaled when the last pending wakeup is destroyed
+    std::mutex wakeupMtx; // never locked before mtx, so wakeups can be destroyed while mtx is locked
 };
 
 // define all the of the basic_AsyncTimer class
@@ -112,29 +148,22 @@ private:
 
 template <typename clock>
 basic_AsyncTimer<clock>::basic_AsyncTimer()
+    : basic_AsyncTimer(duration_type(0), false, nullptr)
 {
-    bLooping = false;
-    bRunning = false;
-    timerDuration = duration_type(0);
 }
 
 template <typename clock>
 template <typename rep, typename periode>
 basic_AsyncTimer<clock>::basic_AsyncTimer(std::chrono::duration<rep, periode> newDuration)
+    : basic_AsyncTimer(newDuration, false, nullptr)
 {
-    bLooping = false;
-    bRunning = false;
-    timerDuration = std::chrono::duration_cast<duration_type>(newDuration);
 }
 
 template <typename clock>
 template <typename rep, typename periode>
 basic_AsyncTimer<clock>::basic_AsyncTimer(std::chrono::duration<rep, periode> newDuration, std::function<void()> func)
+    : basic_AsyncTimer(newDuration, false, std::move(func))
 {
-    bLooping = false;
-    bRunning = false;
-    timerDuration = std::chrono::duration_cast<duration_type>(newDuration);
-    finishFunction = func;
 }
 
 template <typename clock>
@@ -145,13 +174,19 @@ basic_AsyncTimer<clock>::basic_AsyncTimer(std::chrono::duration<rep, periode> ne
     bLooping = shouldLoop;
     bRunning = false;
     timerDuration = std::chrono::duration_cast<duration_type>(newDuration);
-    finishFunction = func;
+    finishFunction = std::move(func);
+    service = nullptr;
+    timerId = TimerService::invalidId;
+    wakeupSeq = 0;
+    pendingWakeups = 0;
 }
 
 template <typename clock>
 basic_AsyncTimer<clock>::~basic_AsyncTimer()
 {
     stop();
+    // stop() might not have waited for queued wakeups, but they still reference this object
+    waitForWakeups();
 }
 
 template <typename clock>
@@ -167,6 +202,11 @@ void basic_AsyncTimer<clock>::setDuration(std::chrono::duration<rep, periode> ne
 {
     std::unique_lock<std::mutex> lck(mtx);
     timerDuration = std::chrono::duration_cast<duration_type>(newDuration);
+    if(bRunning && !sw.isPaused())
+    {
+        cancelWakeup();
+        scheduleWakeup();
+    }
 }
 
 template <typename clock>
@@ -176,38 +216,46 @@ void basic_AsyncTimer<clock>::setLooping(bool shouldLoop)
     bLooping = shouldLoop;
 }
 
+template <typename clock>
+void basic_AsyncTimer<clock>::setTimerService(TimerService& newService)
+{
+    stop();
+    std::unique_lock<std::mutex> lck(mtx);
+    service = &newService;
+}
+
 template <typename clock>
 void basic_AsyncTimer<clock>::start()
 {
     std::unique_lock<std::mutex> lck(mtx);
-    if(bRunning)
-    {
-        bRunning = false;
-        cv.notify_one();
-    }
-    lck.unlock();
-    if(timerThread.joinable())
-        timerThread.join();
-    lck.lock();
+    cancelWakeup();
 
     // now start the timer again
     bRunning = true;
     sw.reset();
-    timerThread = std::thread( &basic_AsyncTimer<clock>::update, this);
+    scheduleWakeup();
 }
 
 template <typename clock>
 void basic_AsyncTimer<clock>::stop()
 {
     std::unique_lock<std::mutex> lck(mtx);
-    if(bRunning)
+    bRunning = false;
+    cancelWakeup();
+
+    // waiting from inside the timer function would deadlock
+    if(callbackThread == std::this_thread::get_id())
+        return;
+
+    // on the dispatch pool, queued wakeups might only run after this task, they are outdated now anyway
+    if(service && service->defaultPool().isWorkerThread())
     {
-        bRunning = false;
-        cv.notify_one();
+        cv.wait(lck, [this]{ return callbackThread == std::thread::id(); });
+        return;
     }
-    lck.unlock(); // not sure if needed
-    if(timerThread.joinable())
-        timerThread.join();
+
+    lck.unlock();
+    waitForWakeups();
 }
 
 template <typename clock>
@@ -215,20 +263,35 @@ void basic_AsyncTimer<clock>::pause()
 {
     std::lock_guard<std::mutex> lck(mtx);
     sw.pause();
+    cancelWakeup();
 }
 
 template <typename clock>
 void basic_AsyncTimer<clock>::resume()
 {
     std::lock_guard<std::mutex> lck(mtx);
+    if(!sw.isPaused())
+        return;
     sw.resume();
+    if(bRunning)
+        scheduleWakeup();
 }
 
 template <typename clock>
 void basic_AsyncTimer<clock>::togglePause()
 {
     std::lock_guard<std::mutex> lck(mtx);
-    sw.togglePause();
+    if(sw.isPaused())
+    {
+        sw.resume();
+        if(bRunning)
+            scheduleWakeup();
+    }
+    else
+    {
+        sw.pause();
+        cancelWakeup();
+    }
 }
 
 template <typename clock>
@@ -239,42 +302,100 @@ bool basic_AsyncTimer<clock>::isRunning()
 }
 
 template <typename clock>
-void basic_AsyncTimer<clock>::update()
+void basic_AsyncTimer<clock>::scheduleWakeup()
 {
-    std::unique_lock<std::mutex> lck(mtx);
+    if(!service)
+        service = &globalTimerService();
+
+    // for clocks other than the steady clock this is only an estimate, onWakeup checks again
+    duration_type remaining = timerDuration - sw.getDuration();
+    if(remaining < duration_type(0))
+        remaining = duration_type(0);
 
-    while(bRunning) // if timer stops leave
     {
-        cv.wait_for(lck, timerDuration-sw.getDuration()-microseconds(40)); // -40 us because timer seems more accurate this way
+        std::lock_guard<std::mutex> wakeupLck(wakeupMtx);
+        pendingWakeups++;
+    }
+    wakeupSeq++;
+    timerId = service->scheduleAfter(remaining, Wakeup(this, wakeupSeq));
+}
 
-        if( !bRunning) // check if we were waken to stop the timer
+template <typename clock>
+void basic_AsyncTimer<clock>::cancelWakeup()
+{
+    // if the wakeup was already dispatched it is ignored when it runs, as the sequence number changed
+    if(timerId != TimerService::invalidId)
+        service->cancel(timerId);
+    timerId = TimerService::invalidId;
+    wakeupSeq++;
+}
+
+template <typename clock>
+void basic_AsyncTimer<clock>::wakeupDestroyed()
+{
+    // notify while locked, otherwise the timer could be destroyed before notify_all() is called
+    std::lock_guard<std::mutex> wakeupLck(wakeupMtx);
+    if(--pendingWakeups == 0)
+        wakeupCv.notify_all();
+}
+
+template <typename clock>
+void basic_AsyncTimer<clock>::waitForWakeups()
+{
+    {
+        std::lock_guard<std::mutex> lck(mtx);
+        if(callbackThread == std::this_thread::get_id())
             return;
+    }
+    std::unique_lock<std::mutex> wakeupLck(wakeupMtx);
+    wakeupCv.wait(wakeupLck, [this]{ return pendingWakeups == 0; });
+}
+
+template <typename clock>
+void basic_AsyncTimer<clock>::onWakeup(unsigned int seq)
+{
+    std::unique_lock<std::mutex> lck(mtx);
+    if(seq != wakeupSeq)
+        return; // cancelled or replaced after it was dispatched
+    timerId = TimerService::invalidId;
 
-        if(sw.getDuration() >= timerDuration) // check if the the wait is over
+    if(bRunning && !sw.isPaused())
+    {
+        if(sw.getDuration() < timerDuration)
+        {
+            // woke up too early, eg because the clock is not the steady clock
+            scheduleWakeup();
+        }
+        else
         {
             if(bLooping)
                 sw.reset();
             else
                 bRunning = false;
 
+            callbackThread = std::this_thread::get_id();
             lck.unlock(); // dont block while callback is running
-            std::unique_lock<std::mutex> funcLck(funcMtx);
-            try
             {
-                if (finishFunction)
-                    finishFunction();
+                std::lock_guard<std::mutex> funcLck(funcMtx);
+                try
+                {
+                    if (finishFunction)
+                        finishFunction();
+                }
+                catch (std::exception &e)
+                {
+                    logERROR("AsyncTimer") << "Exception in the timer function: "<<e.what();
+                }
             }
-            catch (std::exception &e)
-            {
-                // log and rethrow
-                logFATAL_ERROR("AsyncTimer") << "Exception in the timer function: "<<e.what();
-                throw;
-            }
-            funcLck.unlock();
             lck.lock();
+            callbackThread = std::thread::id();
+            cv.notify_all();
+
+            // the next loop starts once the function returned, so calls never overlap
+            if(bLooping && bRunning && seq == wakeupSeq && !sw.isPaused())
+                scheduleWakeup();
         }
     }
-    return;
 }
 //--------------------
 
@@ -59,6 +59,7 @@ public:
     inline void pause(); // pauses the timer
     inline void resume(); // resumes the timer
     inline void togglePause(); // toggles the pause state
+    inline bool isPaused() const {return bPaused;} // check if the stopwatch is currently paused
 
     inline double getSeconds(); // returnes the time from start() to now as a double in seconds
     inline duration_type getDuration(); // returns the time start() to now as a std::chrono::duration
@@ -0,0 +1,117 @@
+/*
+ * mpUtils
+ * TimerService.h
+ *
+ * @author: Hendrik Schwanekamp
+ * @mail:   hendrik.schwanekamp@gmx.net
+ *
+ * Implements the TimerService class
+ *
+ * Copyright (c) 2021 Hendrik Schwanekamp
+ *
+ */
+
+#ifndef MPUTILS_TIMERSERVICE_H
+#define MPUTILS_TIMERSERVICE_H
+
+// includes
+//--------------------
+#include <chrono>
+#include <cstdint>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "mpUtils/Threading/UniqueTask.h"
+#include "mpUtils/Threading/globalThreadPool.h"
+//--------------------
+
+// namespace
+//--------------------
+namespace mpu {
+//--------------------
+
+//-------------------------------------------------------------------
+/**
+ * class TimerService
+ *
+ * Runs functions at a given point in time. All timers of the service are managed by a single thread,
+ * which posts the functions to a ThreadPool once they are due. That avoids one sleeping thread per timer.
+ *
+ * usage:
+ * Use schedule() or scheduleAfter() to add a function, they return an id that can be passed to cancel().
+ * Cancelling is O(1), scheduling is O(log n) in the number of pending timers. Timers are kept in a min-heap,
+ * so deadlines are met with the precision of the system clock instead of being rounded to a tick.
+ * Functions are posted to the pool given at construction, or to the pool passed to schedule().
+ * Pending timers are discarded when the service is destroyed, their functions are destroyed without being called.
+ * Use globalTimerService() for a service shared by the whole application, which dispatches to the globalThreadPool().
+ *
+ */
+class TimerService
+{
+public:
+    using clock = std::chrono::steady_clock;
+    using TimerId = uint64_t;
+    static constexpr TimerId invalidId = 0;
+
+    explicit TimerService(ThreadPool& pool = globalThreadPool());
+    ~TimerService(); //!< pending timers are discarded
+    TimerService(const TimerService&) = delete;
+    TimerService& operator=(const TimerService&) = delete;
+
+    TimerId schedule(clock::time_point deadline, UniqueTask f, ThreadPool* pool = nullptr); //!< post f to pool at deadline, nullptr uses the default pool of the service
+    template <typename Rep, typename Period>
+    TimerId scheduleAfter(std::chrono::duration<Rep,Period> delay, UniqueTask f, ThreadPool* pool = nullptr); //!< post f to pool after delay
+
+    bool cancel(TimerId id); //!< cancel a timer, returns false if the timer was already dispatched or cancelled
+    std::size_t numPending(); //!< number of timers waiting to be dispatched
+    ThreadPool& defaultPool() {return m_defaultPool;} //!< the pool functions are posted to when schedule() is called without a pool
+
+private:
+    struct Slot
+    {
+        UniqueTask task;
+        ThreadPool* pool{nullptr};
+        uint32_t generation{1}; //!< incremented whenever the slot is freed, so old ids become invalid
+    };
+
+    struct HeapEntry
+    {
+        clock::time_point deadline;
+        uint32_t slot;
+        uint32_t generation;
+        bool operator>(const HeapEntry& other) const {return deadline > other.deadline;}
+    };
+
+    void run(); //!< main function of the timer thread
+    void freeSlot(uint32_t slot); //!< invalidates the slot and puts it on the free list
+    void removeCancelled(); //!< rebuilds the heap without cancelled entries
+
+    ThreadPool& m_defaultPool;
+    std::vector<Slot> m_slots;
+    std::vector<uint32_t> m_freeSlots;
+    std::vector<HeapEntry> m_heap; //!< min-heap ordered by deadline, might contain entries of cancelled timers
+    std::size_t m_numCancelled{0}; //!< number of cancelled entries still in the heap
+
+    bool m_stop{false};
+    std::mutex m_mtx;
+    std::condition_variable m_cv;
+    std::thread m_thread;
+};
+
+/**
+ * @brief Returns a timer service shared by the whole application, which dispatches to the globalThreadPool().
+ */
+TimerService& globalTimerService();
+
+// template function definition
+//-------------------------------------------------------------------
+
+template <typename Rep, typename Period>
+TimerService::TimerId TimerService::scheduleAfter(std::chrono::duration<Rep,Period> delay, UniqueTask f, ThreadPool* pool)
+{
+    return schedule(clock::now() + std::chrono::duration_cast<clock::duration>(delay), std::move(f), pool);
+}
+
+}
+#endif //MPUTILS_TIMERSERVICE_H
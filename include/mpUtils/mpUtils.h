@@ -43,6 +43,12 @@
 
 // resource management
 #include "mpUtils/ResourceManager/readData.h"
+#include "mpUtils/ResourceManager/MappedFile.h"
+#include "mpUtils/ResourceManager/AsyncFileReader.h"
+#include "mpUtils/ResourceManager/ResourceArchive.h"
+#include "mpUtils/ResourceManager/ResourceKey.h"
+#include "mpUtils/ResourceManager/FileWatcher.h"
+#include "mpUtils/ResourceManager/DecodedImageCache.h"
 #include "mpUtils/ResourceManager/ResourceCache.h"
 #include "mpUtils/ResourceManager/ResourceManager.h"
 #include "mpUtils/ResourceManager/mpUtilsResources.h"
@@ -61,6 +67,7 @@
 #include "Timer/DeltaTimer.h"
 #include "Timer/Stopwatch.h"
 #include "Timer/Timer.h"
+#include "Timer/TimerService.h"
 
 // compiletime math
 #include "mpUtils/external/gcem/gcem.hpp"
@@ -74,6 +81,28 @@
 // Jakob Progsch thread pool
 #include "mpUtils/external/threadPool/ThreadPool.h"
 
+// multithreading
+#include "mpUtils/Threading/UniqueTask.h"
+#include "mpUtils/Threading/CancellationToken.h"
+#include "mpUtils/Threading/globalThreadPool.h"
+#include "mpUtils/Threading/parallelFor.h"
+#include "mpUtils/Threading/parallelAlgorithms.h"
+#include "mpUtils/Threading/TaskGraph.h"
+#include "mpUtils/Threading/Future.h"
+#include "mpUtils/Threading/Task.h"
+#include "mpUtils/Threading/cpuAffinity.h"
+#include "mpUtils/Threading/numa.h"
+#include "mpUtils/Threading/JobSystem.h"
+#include "mpUtils/Threading/Pipeline.h"
+#include "mpUtils/Threading/concurrent/SpinLock.h"
+#include "mpUtils/Threading/concurrent/SeqLock.h"
+#include "mpUtils/Threading/concurrent/SpscQueue.h"
+#include "mpUtils/Threading/concurrent/MpmcQueue.h"
+#include "mpUtils/Threading/concurrent/ShardedMap.h"
+#include "mpUtils/Threading/concurrent/SegmentedVector.h"
+#include "mpUtils/Threading/concurrent/futex.h"
+#include "mpUtils/Threading/concurrent/Semaphore.h"
+
 // matrix type might be useful without cuda
 #include "Cuda/Matrix.h"
 #include "Cuda/MatrixMath.h"
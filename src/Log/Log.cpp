@@ -14,6 +14,7 @@
 // includes
 //--------------------
 #include <mpUtils/Log/Log.h>
+#include "mpUtils/Threading/cpuAffinity.h"
 #include "mpUtils/version.h"
 //--------------------
 
@@ -87,10 +88,23 @@ void Log::flush()
     // restart the logger
     logLvl = oldLvl;
     if(!bShouldLoggerRun)
-    {
-        bShouldLoggerRun = true;
-        loggerMainThread = std::thread(&Log::loggerMainfunc, this);
-    }
+        startLoggerThread();
+}
+
+void Log::setThreadAffinity(std::vector<int> cores)
+{
+    std::lock_guard<std::mutex> lck(loggerMtx);
+    loggerCores = std::move(cores);
+    if(bShouldLoggerRun)
+        mpu::setThreadAffinity(loggerMainThread, loggerCores);
+}
+
+void Log::startLoggerThread()
+{
+    bShouldLoggerRun = true;
+    loggerMainThread = std::thread(&Log::loggerMainfunc, this);
+    if(!loggerCores.empty())
+        mpu::setThreadAffinity(loggerMainThread, loggerCores);
 }
 
 LogStream Log::print(const LogLvl lvl)
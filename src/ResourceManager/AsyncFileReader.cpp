@@ -0,0 +1,526 @@
+/*
+ * mpUtils
+ * AsyncFileReader.cpp
+ *
+ * @author: Hendrik Schwanekamp
+ * @mail:   hendrik.schwanekamp@gmx.net
+ *
+ * Copyright (c) 2021 Hendrik Schwanekamp
+ *
+ */
+
+// includes
+//--------------------
+#include "mpUtils/ResourceManager/AsyncFileReader.h"
+#include "mpUtils/ResourceManager/readData.h"
+#include "mpUtils/Threading/globalThreadPool.h"
+#include "mpUtils/Log/Log.h"
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <cerrno>
+#include <stdexcept>
+#include <unordered_set>
+#if defined(__linux__) && defined(__has_include)
+    #if __has_include(<linux/io_uring.h>)
+        #include <linux/io_uring.h>
+        #include <sys/syscall.h>
+        #include <sys/mman.h>
+        #include <sys/stat.h>
+        #include <sys/eventfd.h>
+        #include <sys/uio.h>
+        #include <fcntl.h>
+        #include <unistd.h>
+        #include <poll.h>
+        #if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+            #define MPU_HAS_IO_URING
+        #endif
+    #endif
+#endif
+//--------------------
+
+// namespace
+//--------------------
+namespace mpu {
+//--------------------
+
+#ifdef MPU_HAS_IO_URING
+namespace detail {
+
+    /**
+     * @brief minimal io_uring wrapper, owns the ring buffers shared with the kernel and an eventfd to wake the reactor
+     *      Only the reactor thread accesses it, except for the eventfd.
+     */
+    struct IoUring
+    {
+        struct Read //!< a file that is being read
+        {
+            std::string path;
+            AsyncFileReader::Callback onComplete;
+            int fd;
+            std::string data;
+            std::size_t offset;
+            iovec iov;
+        };
+
+        static constexpr std::uint64_t wakeupTag = 0; //!< user data of the poll on the eventfd
+
+        explicit IoUring(unsigned int entries);
+        ~IoUring() {release();}
+        void release();
+
+        unsigned int freeReadSlots() const {return capacity - readsInFlight;}
+        void prepRead(Read* r); //!< queue a read of the remaining part of r
+        void prepWakeupPoll(); //!< queue a poll on the eventfd
+        int submitAndWait(); //!< submit all queued entries and wait for at least one completion, returns -errno on error
+        template <typename F> void reap(F&& f); //!< calls f(userData, result) for every completion
+
+        int ringFd{-1};
+        int wakeFd{-1};
+        unsigned int capacity{0}; //!< maximum number of reads in flight, one entry is reserved for the wakeup poll
+        unsigned int readsInFlight{0};
+        unsigned int toSubmit{0};
+
+    private:
+        io_uring_sqe* nextSqe(); //!< the next free submission queue entry, zeroed
+        void publishSqe(); //!< make the entry returned by nextSqe visible to the kernel
+
+        void* sqRing{MAP_FAILED};
+        void* cqRing{MAP_FAILED};
+        io_uring_sqe* sqes{static_cast<io_uring_sqe*>(MAP_FAILED)};
+        std::size_t sqRingSize{0};
+        std::size_t cqRingSize{0};
+        std::size_t sqesSize{0};
+
+        unsigned* sqTail{nullptr};
+        unsigned sqMask{0};
+        unsigned* sqArray{nullptr};
+        unsigned sqLocalTail{0};
+        unsigned* cqHead{nullptr};
+        unsigned* cqTail{nullptr};
+        unsigned cqMask{0};
+        io_uring_cqe* cqes{nullptr};
+    };
+
+    IoUring::IoUring(unsigned int entries)
+    {
+        io_uring_params p;
+        std::memset(&p, 0, sizeof(p));
+        ringFd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &p));
+        if(ringFd < 0)
+            throw std::runtime_error(std::string("io_uring_setup failed: ") + std::strerror(errno));
+
+        sqRingSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cqRingSize = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        const bool singleMap = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if(singleMap)
+            sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+
+        sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+        if(sqRing != MAP_FAILED)
+            cqRing = singleMap ? sqRing : mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE,
+                                               MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+        if(cqRing != MAP_FAILED)
+        {
+            sqesSize = p.sq_entries * sizeof(io_uring_sqe);
+            sqes = static_cast<io_uring_sqe*>(mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE,
+                                                   MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES));
+        }
+        wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if(sqes == MAP_FAILED || wakeFd < 0)
+        {
+            int err = errno;
+            release();
+            throw std::runtime_error(std::string("io_uring setup failed: ") + std::strerror(err));
+        }
+
+        char* sq = static_cast<char*>(sqRing);
+        sqTail = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+        sqMask = *reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+        sqArray = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+        sqLocalTail = *sqTail;
+
+        char* cq = static_cast<char*>(cqRing);
+        cqHead = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+        cqTail = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+        cqMask = *reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+
+        // the completion queue is at least as big as the submission queue, so it can not overflow
+        capacity = p.sq_entries - 1;
+    }
+
+    void IoUring::release()
+    {
+        if(sqes != MAP_FAILED)
+            munmap(sqes, sqesSize);
+        if(cqRing != MAP_FAILED && cqRing != sqRing)
+            munmap(cqRing, cqRingSize);
+        if(sqRing != MAP_FAILED)
+            munmap(sqRing, sqRingSize);
+        if(wakeFd >= 0)
+            close(wakeFd);
+        if(ringFd >= 0)
+            close(ringFd);
+        sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+        sqRing = cqRing = MAP_FAILED;
+        wakeFd = ringFd = -1;
+    }
+
+    io_uring_sqe* IoUring::nextSqe()
+    {
+        io_uring_sqe* sqe = &sqes[sqLocalTail & sqMask];
+        std::memset(sqe, 0, sizeof(io_uring_sqe));
+        return sqe;
+    }
+
+    void IoUring::publishSqe()
+    {
+        sqArray[sqLocalTail & sqMask] = sqLocalTail & sqMask;
+        ++sqLocalTail;
+        __atomic_store_n(sqTail, sqLocalTail, __ATOMIC_RELEASE);
+        ++toSubmit;
+    }
+
+    void IoUring::prepRead(Read* r)
+    {
+        r->iov.iov_base = &r->data[r->offset];
+        r->iov.iov_len = r->data.size() - r->offset;
+
+        io_uring_sqe* sqe = nextSqe();
+        sqe->opcode = IORING_OP_READV;
+        sqe->fd = r->fd;
+        sqe->addr = reinterpret_cast<std::uint64_t>(&r->iov);
+        sqe->len = 1;
+        sqe->off = r->offset;
+        sqe->user_data = reinterpret_cast<std::uint64_t>(r);
+        publishSqe();
+    }
+
+    void IoUring::prepWakeupPoll()
+    {
+        io_uring_sqe* sqe = nextSqe();
+        sqe->opcode = IORING_OP_POLL_ADD;
+        sqe->fd = wakeFd;
+        sqe->poll_events = POLLIN;
+        sqe->user_data = wakeupTag;
+        publishSqe();
+    }
+
+    int IoUring::submitAndWait()
+    {
+        int r = static_cast<int>(syscall(__NR_io_uring_enter, ringFd, toSubmit, 1, IORING_ENTER_GETEVENTS, nullptr, 0));
+        if(r < 0)
+            return -errno;
+        toSubmit -= std::min<unsigned int>(toSubmit, r);
+        return r;
+    }
+
+    template <typename F>
+    void IoUring::reap(F&& f)
+    {
+        unsigned head = *cqHead;
+        while(head != __atomic_load_n(cqTail, __ATOMIC_ACQUIRE))
+        {
+            const io_uring_cqe& cqe = cqes[head & cqMask];
+            const std::uint64_t userData = cqe.user_data;
+            const int res = cqe.res;
+            ++head;
+            __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+            f(userData, res);
+        }
+    }
+}
+#else
+namespace detail {
+    struct IoUring {}; // not available on this platform
+}
+#endif
+
+// function definitions of the AsyncFileReader class
+//-------------------------------------------------------------------
+AsyncFileReader::AsyncFileReader(unsigned int queueDepth, std::size_t fallbackThreads, bool useIoUring)
+    : m_fallbackThreads(std::max<std::size_t>(fallbackThreads, 1))
+{
+    initRing(queueDepth, useIoUring);
+}
+
+AsyncFileReader::AsyncFileReader(ThreadPool& fallbackPool, unsigned int queueDepth, bool useIoUring)
+    : m_fallbackPool(&fallbackPool)
+{
+    initRing(queueDepth, useIoUring);
+}
+
+void AsyncFileReader::initRing(unsigned int queueDepth, bool useIoUring)
+{
+#ifdef MPU_HAS_IO_URING
+    if(useIoUring)
+    {
+        try
+        {
+            m_ring = std::make_unique<detail::IoUring>(std::max(queueDepth, 2u));
+        } catch(const std::exception& e)
+        {
+            logINFO("AsyncFileReader") << "io_uring is not available, using a thread pool for reading. " << e.what();
+        }
+    }
+#else
+    (void)queueDepth;
+    (void)useIoUring;
+#endif
+
+    if(m_ring)
+    {
+        m_ringActive = true;
+        m_reactor = std::thread(&AsyncFileReader::reactorLoop, this);
+    }
+}
+
+AsyncFileReader::~AsyncFileReader()
+{
+    waitUntilIdle();
+    if(m_reactor.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lck(m_mtx);
+            m_stop = true;
+            if(m_ringActive)
+                wakeReactor();
+        }
+        m_reactor.join();
+    }
+}
+
+void AsyncFileReader::read(std::string path, Callback onComplete)
+{
+    m_pending.fetch_add(1, std::memory_order_relaxed);
+
+    {
+        std::lock_guard<std::mutex> lck(m_mtx);
+        if(m_ringActive)
+        {
+            // if the queue was not empty the reactor was already woken up and did not take the requests yet
+            if(m_requests.empty())
+                wakeReactor();
+            m_requests.push_back({std::move(path), std::move(onComplete)});
+            return;
+        }
+    }
+    readWithFallback(std::move(path), std::move(onComplete));
+}
+
+void AsyncFileReader::readWithFallback(std::string path, Callback onComplete)
+{
+    ThreadPool* pool;
+    {
+        std::lock_guard<std::mutex> lck(m_mtx);
+        if(!m_fallbackPool)
+        {
+            m_ownedFallbackPool = std::make_unique<ThreadPool>(m_fallbackThreads);
+            m_fallbackPool = m_ownedFallbackPool.get();
+        }
+        pool = m_fallbackPool;
+    }
+
+    pool->post([this, path = std::move(path), onComplete = std::move(onComplete)]() mutable
+    {
+        std::string data;
+        std::exception_ptr error;
+        try
+        {
+            data = readFile(path);
+        } catch(...)
+        {
+            error = std::current_exception();
+        }
+        complete(onComplete, std::move(data), error);
+    });
+}
+
+void AsyncFileReader::waitUntilIdle()
+{
+    std::unique_lock<std::mutex> lck(m_idleMtx);
+    m_idleCv.wait(lck, [this](){ return m_pending.load() == 0; });
+}
+
+void AsyncFileReader::complete(Callback& onComplete, std::string data, std::exception_ptr error)
+{
+    try
+    {
+        onComplete(std::move(data), error);
+    } catch(const std::exception& e)
+    {
+        logERROR("AsyncFileReader") << "Exception in read callback: " << e.what();
+    }
+
+    if(m_pending.fetch_sub(1) == 1)
+    {
+        std::lock_guard<std::mutex> lck(m_idleMtx);
+        m_idleCv.notify_all();
+    }
+}
+
+#ifdef MPU_HAS_IO_URING
+
+void AsyncFileReader::wakeReactor()
+{
+    std::uint64_t one = 1;
+    ssize_t r = write(m_ring->wakeFd, &one, sizeof(one));
+    (void)r; // can only fail if the counter overflows, in which case the reactor is woken up anyway
+}
+
+void AsyncFileReader::reactorLoop()
+{
+    using Read = detail::IoUring::Read;
+    detail::IoUring& ring = *m_ring;
+
+    auto fail = [this](Read* r, int err)
+    {
+        std::unique_ptr<Read> owner(r);
+        if(r->fd >= 0)
+            close(r->fd);
+        complete(r->onComplete, std::string(), std::make_exception_ptr(
+                std::runtime_error("Could not read file " + r->path + ": " + std::strerror(err))));
+    };
+    auto finish = [this](Read* r)
+    {
+        std::unique_ptr<Read> owner(r);
+        close(r->fd);
+        complete(r->onComplete, std::move(r->data), nullptr);
+    };
+
+    std::vector<Request> batch;
+    std::unordered_set<Read*> inFlight; //!< reads submitted to the kernel
+    ring.prepWakeupPoll();
+    for(;;)
+    {
+        // take as many requests as there is room for in the ring
+        batch.clear();
+        {
+            std::lock_guard<std::mutex> lck(m_mtx);
+            while(!m_requests.empty() && batch.size() < ring.freeReadSlots())
+            {
+                batch.push_back(std::move(m_requests.front()));
+                m_requests.pop_front();
+            }
+            if(m_stop && batch.empty() && m_requests.empty() && ring.readsInFlight == 0)
+                break;
+        }
+
+        // opening a file and reading its size are cheap when the metadata is cached, so they are done directly
+        for(Request& request : batch)
+        {
+            Read* r = new Read{std::move(request.path), std::move(request.onComplete), -1, std::string(), 0, {}};
+            r->fd = open(r->path.c_str(), O_RDONLY | O_CLOEXEC);
+            if(r->fd < 0)
+            {
+                fail(r, errno);
+                continue;
+            }
+            struct stat st{};
+            if(fstat(r->fd, &st) != 0)
+            {
+                fail(r, errno);
+                continue;
+            }
+            if(!S_ISREG(st.st_mode))
+            {
+                fail(r, EISDIR);
+                continue;
+            }
+            if(st.st_size == 0)
+            {
+                finish(r);
+                continue;
+            }
+            r->data.resize(static_cast<std::size_t>(st.st_size));
+            ring.prepRead(r);
+            ++ring.readsInFlight;
+            inFlight.insert(r);
+        }
+
+        int result = ring.submitAndWait();
+        if(result < 0 && result != -EINTR && result != -EAGAIN && result != -EBUSY)
+        {
+            // the ring is unusable and retrying would only spin, so everything that was requested fails
+            // and later reads use the thread pool
+            std::deque<Request> queued;
+            {
+                std::lock_guard<std::mutex> lck(m_mtx);
+                m_ringActive = false;
+                queued.swap(m_requests);
+            }
+            logERROR("AsyncFileReader") << "io_uring_enter failed: " << std::strerror(-result) << ". Failing "
+                                        << inFlight.size() + queued.size() << " reads and using a thread pool from now on.";
+
+            // closing the ring makes the kernel drop the reads that are still submitted, before their buffers are freed
+            ring.release();
+            for(Read* r : inFlight)
+                fail(r, -result);
+            ring.readsInFlight = 0;
+            for(Request& request : queued)
+                fail(new Read{std::move(request.path), std::move(request.onComplete), -1, std::string(), 0, {}}, -result);
+            return;
+        }
+
+        ring.reap([&](std::uint64_t userData, int res)
+        {
+            if(userData == detail::IoUring::wakeupTag)
+            {
+                std::uint64_t value;
+                ssize_t r = ::read(ring.wakeFd, &value, sizeof(value));
+                (void)r;
+                ring.prepWakeupPoll();
+                return;
+            }
+
+            Read* r = reinterpret_cast<Read*>(userData);
+            if(res == -EINTR || res == -EAGAIN)
+            {
+                ring.prepRead(r);
+            } else if(res < 0)
+            {
+                --ring.readsInFlight;
+                inFlight.erase(r);
+                fail(r, -res);
+            } else
+            {
+                r->offset += static_cast<std::size_t>(res);
+                if(res > 0 && r->offset < r->data.size())
+                {
+                    ring.prepRead(r); // short read, continue where it stopped
+                } else
+                {
+                    // the file might have been truncated since we read its size
+                    r->data.resize(r->offset);
+                    --ring.readsInFlight;
+                    inFlight.erase(r);
+                    finish(r);
+                }
+            }
+        });
+    }
+}
+
+#else
+
+void AsyncFileReader::wakeReactor()
+{
+}
+
+void AsyncFileReader::reactorLoop()
+{
+}
+
+#endif
+
+AsyncFileReader& globalFileReader()
+{
+    // the global pool is created first and therefore destroyed last, callbacks of the reader often post to it
+    globalThreadPool();
+    static AsyncFileReader reader;
+    return reader;
+}
+
+}
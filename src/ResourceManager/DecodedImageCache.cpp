@@ -0,0 +1,223 @@
+/*
+ * mpUtils
+ * DecodedImageCache.cpp
+ *
+ * @author: Hendrik Schwanekamp
+ * @mail:   hendrik.schwanekamp@gmx.net
+ *
+ * Copyright (c) 2021 Hendrik Schwanekamp
+ *
+ */
+
+// includes
+//--------------------
+#include "mpUtils/ResourceManager/DecodedImageCache.h"
+#include "mpUtils/Log/Log.h"
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <vector>
+#include <cerrno>
+#include <stdexcept>
+#include <experimental/filesystem>
+//--------------------
+
+// namespace
+//--------------------
+namespace mpu {
+//--------------------
+
+namespace {
+    constexpr char entryMagic[8] = {'M','P','U','I','M','G',0,0};
+    constexpr std::uint32_t entryFormatVersion = 1;
+    constexpr std::uint64_t entryDataOffset = 4096; //!< pixels start at the first page after the header
+    const char* const entryExtension = ".mpimg";
+
+    constexpr std::uint64_t prime1 = 11400714785074694791ull;
+    constexpr std::uint64_t prime2 = 14029467366897019727ull;
+    constexpr std::uint64_t prime3 = 1609587929392839161ull;
+    constexpr std::uint64_t prime4 = 9650029242287828579ull;
+    constexpr std::uint64_t prime5 = 2870177450012600261ull;
+
+    inline std::uint64_t rotl(std::uint64_t x, int r) {return (x << r) | (x >> (64 - r));}
+    inline std::uint64_t read64(const unsigned char* p) {std::uint64_t v; std::memcpy(&v, p, 8); return v;}
+    inline std::uint32_t read32(const unsigned char* p) {std::uint32_t v; std::memcpy(&v, p, 4); return v;}
+    inline std::uint64_t xxRound(std::uint64_t acc, std::uint64_t input) {return rotl(acc + input * prime2, 31) * prime1;}
+    inline std::uint64_t mergeRound(std::uint64_t acc, std::uint64_t v) {return (acc ^ xxRound(0, v)) * prime1 + prime4;}
+}
+
+std::uint64_t detail::contentHash(const void* data, std::size_t size)
+{
+    // xxHash64 with seed 0, processes 32 bytes per iteration, much faster than hashing byte by byte
+    const auto* p = static_cast<const unsigned char*>(data);
+    const unsigned char* const end = p + size;
+    std::uint64_t h;
+
+    if(size >= 32)
+    {
+        std::uint64_t v1 = prime1 + prime2;
+        std::uint64_t v2 = prime2;
+        std::uint64_t v3 = 0;
+        std::uint64_t v4 = 0 - prime1;
+        const unsigned char* const limit = end - 32;
+        do
+        {
+            v1 = xxRound(v1, read64(p));
+            v2 = xxRound(v2, read64(p + 8));
+            v3 = xxRound(v3, read64(p + 16));
+            v4 = xxRound(v4, read64(p + 24));
+            p += 32;
+        } while(p <= limit);
+
+        h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        h = mergeRound(h, v1);
+        h = mergeRound(h, v2);
+        h = mergeRound(h, v3);
+        h = mergeRound(h, v4);
+    } else
+        h = prime5;
+
+    h += static_cast<std::uint64_t>(size);
+
+    for(; p + 8 <= end; p += 8)
+        h = rotl(h ^ xxRound(0, read64(p)), 27) * prime1 + prime4;
+    if(p + 4 <= end)
+    {
+        h = rotl(h ^ (static_cast<std::uint64_t>(read32(p)) * prime1), 23) * prime2 + prime3;
+        p += 4;
+    }
+    for(; p < end; ++p)
+        h = rotl(h ^ (*p * prime5), 11) * prime1;
+
+    h ^= h >> 33;
+    h *= prime2;
+    h ^= h >> 29;
+    h *= prime3;
+    h ^= h >> 32;
+    return h;
+}
+
+// function definitions of the DecodedImageCache class
+//-------------------------------------------------------------------
+DecodedImageCache::DecodedImageCache(std::string directory, std::uint32_t decoderVersion)
+    : m_directory(std::move(directory)), m_decoderVersion(decoderVersion)
+{
+    namespace fs = std::experimental::filesystem;
+    std::error_code ec;
+    fs::create_directories(m_directory, ec);
+    if(!fs::is_directory(m_directory))
+        throw std::runtime_error("Could not create decoded image cache directory " + m_directory);
+}
+
+std::string DecodedImageCache::entryPath(std::uint64_t sourceHash, std::uint32_t pixelFormat, int forceChannels) const
+{
+    char name[64];
+    std::snprintf(name, sizeof(name), "%016llx_%u_%u_%d", static_cast<unsigned long long>(sourceHash), m_decoderVersion,
+                  pixelFormat, forceChannels);
+    return m_directory + "/" + name + entryExtension;
+}
+
+MappedFile DecodedImageCache::findEntry(std::uint64_t sourceHash, std::size_t sourceSize, std::uint32_t pixelFormat,
+                                        int forceChannels, detail::DecodedImageHeader& header)
+{
+    namespace fs = std::experimental::filesystem;
+    const std::string path = entryPath(sourceHash, pixelFormat, forceChannels);
+    std::error_code ec;
+    if(!fs::is_regular_file(path, ec))
+        return {};
+
+    MappedFile file;
+    try
+    {
+        file = MappedFile(path, FileAccess::sequential);
+    }
+    catch(const std::exception& e)
+    {
+        logWARNING("DecodedImageCache") << "Could not open cached image " << path << ": " << e.what();
+        return {};
+    }
+
+    if(file.size() < sizeof(header))
+        return {};
+    std::memcpy(&header, file.data(), sizeof(header));
+
+    // the name only contains the hash, so check everything else to detect collisions and outdated entries
+    const std::uint64_t pixelBytes = static_cast<std::uint64_t>(header.width) * header.height * header.channels * (pixelFormat & 15u);
+    if(std::memcmp(header.magic, entryMagic, sizeof(entryMagic)) != 0
+        || header.formatVersion != entryFormatVersion
+        || header.decoderVersion != m_decoderVersion
+        || header.sourceHash != sourceHash
+        || header.sourceSize != sourceSize
+        || header.pixelFormat != pixelFormat
+        || header.forceChannels != forceChannels
+        || header.width <= 0 || header.height <= 0 || header.channels <= 0
+        || header.dataOffset < sizeof(header)
+        || file.size() != header.dataOffset + pixelBytes)
+    {
+        logDEBUG("DecodedImageCache") << "Ignoring outdated cached image " << path;
+        return {};
+    }
+
+    return file;
+}
+
+void DecodedImageCache::storeEntry(std::uint64_t sourceHash, std::size_t sourceSize, std::uint32_t pixelFormat,
+                                   int forceChannels, const void* pixels, int width, int height, int channels)
+{
+    detail::DecodedImageHeader header{};
+    std::memcpy(header.magic, entryMagic, sizeof(entryMagic));
+    header.formatVersion = entryFormatVersion;
+    header.decoderVersion = m_decoderVersion;
+    header.sourceHash = sourceHash;
+    header.sourceSize = sourceSize;
+    header.width = width;
+    header.height = height;
+    header.channels = channels;
+    header.forceChannels = forceChannels;
+    header.pixelFormat = pixelFormat;
+    header.dataOffset = entryDataOffset;
+
+    const std::size_t pixelBytes = static_cast<std::size_t>(width) * height * channels * (pixelFormat & 15u);
+    const std::string path = entryPath(sourceHash, pixelFormat, forceChannels);
+
+    // write to a unique temporary file and rename it, so no one can ever map a half written entry
+    static const unsigned int processTag = std::random_device()();
+    static std::atomic<unsigned int> counter{0};
+    const std::string tmpPath = path + "." + std::to_string(processTag)
+                                + "_" + std::to_string(counter.fetch_add(1, std::memory_order_relaxed)) + ".tmp";
+    {
+        std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+        const std::vector<char> padding(entryDataOffset - sizeof(header), 0);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(padding.data(), padding.size());
+        out.write(static_cast<const char*>(pixels), pixelBytes);
+        if(!out)
+        {
+            logWARNING("DecodedImageCache") << "Could not write cached image " << tmpPath;
+            out.close();
+            std::remove(tmpPath.c_str());
+            return;
+        }
+    }
+
+    if(std::rename(tmpPath.c_str(), path.c_str()) != 0)
+    {
+        logWARNING("DecodedImageCache") << "Could not store cached image " << path << ": " << std::strerror(errno);
+        std::remove(tmpPath.c_str());
+    }
+}
+
+void DecodedImageCache::clear()
+{
+    namespace fs = std::experimental::filesystem;
+    std::error_code ec;
+    std::vector<fs::path> entries;
+    for(const auto& item : fs::directory_iterator(m_directory, ec))
+        if(item.path().extension() == entryExtension)
+            entries.push_back(item.path());
+    for(const auto& entry : entries)
+        fs::remove(entry, ec);
+}
+
+}
@@ -0,0 +1,254 @@
+/*
+ * mpUtils
+ * FileWatcher.cpp
+ *
+ * @author: Hendrik Schwanekamp
+ * @mail:   hendrik.schwanekamp@gmx.net
+ *
+ * Copyright (c) 2021 Hendrik Schwanekamp
+ *
+ */
+
+// includes
+//--------------------
+#include "mpUtils/ResourceManager/FileWatcher.h"
+#include "mpUtils/Log/Log.h"
+#include <cstring>
+#include <cerrno>
+#ifdef __linux__
+    #include <sys/inotify.h>
+    #include <unistd.h>
+#endif
+//--------------------
+
+// namespace
+//--------------------
+namespace mpu {
+//--------------------
+
+// function definitions of the FileWatcher class
+//-------------------------------------------------------------------
+#ifdef __linux__
+
+namespace {
+    void splitPath(const std::string& file, std::string& directory, std::string& name)
+    {
+        const std::size_t pos = file.find_last_of('/');
+        if(pos == std::string::npos)
+        {
+            directory = ".";
+            name = file;
+        } else
+        {
+            directory = pos == 0 ? "/" : file.substr(0, pos);
+            name = file.substr(pos + 1);
+        }
+    }
+}
+
+FileWatcher::FileWatcher(std::chrono::milliseconds debounce)
+    : m_debounce(debounce)
+{
+    m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(m_fd < 0)
+        logWARNING("FileWatcher") << "inotify is not available, files are not watched. " << std::strerror(errno);
+}
+
+FileWatcher::~FileWatcher()
+{
+    if(m_fd >= 0)
+        ::close(m_fd); // also removes all watches
+}
+
+void FileWatcher::watch(const std::string& file)
+{
+    if(m_fd < 0)
+        return;
+
+    std::string directory, name;
+    splitPath(file, directory, name);
+
+    std::lock_guard<std::mutex> lck(m_mtx);
+    int wd;
+    auto it = m_watchOfDirectory.find(directory);
+    if(it != m_watchOfDirectory.end())
+    {
+        wd = it->second;
+    } else
+    {
+        // watch the directory, editors often save by replacing the file, which would remove a watch on the file itself
+        wd = inotify_add_watch(m_fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_MODIFY | IN_CREATE);
+        if(wd < 0)
+        {
+            logWARNING("FileWatcher") << "Could not watch directory " << directory << ": " << std::strerror(errno);
+            return;
+        }
+        m_watchOfDirectory.emplace(directory, wd);
+        Directory& dir = m_directories[wd]; // the same directory might already be watched under a different path
+        if(dir.path.empty())
+            dir.path = directory;
+    }
+    m_directories[wd].files[name][file]++;
+}
+
+void FileWatcher::unwatch(const std::string& file)
+{
+    if(m_fd < 0)
+        return;
+
+    std::string directory, name;
+    splitPath(file, directory, name);
+
+    std::lock_guard<std::mutex> lck(m_mtx);
+    auto wdIt = m_watchOfDirectory.find(directory);
+    if(wdIt == m_watchOfDirectory.end())
+        return;
+    const int wd = wdIt->second;
+    Directory& dir = m_directories[wd];
+
+    auto nameIt = dir.files.find(name);
+    if(nameIt == dir.files.end())
+        return;
+    auto fileIt = nameIt->second.find(file);
+    if(fileIt == nameIt->second.end())
+        return;
+    if(--fileIt->second > 0)
+        return;
+
+    nameIt->second.erase(fileIt);
+    m_changed.erase(file);
+    if(!nameIt->second.empty())
+        return;
+    dir.files.erase(nameIt);
+    if(!dir.files.empty())
+        return;
+
+    // nothing left to watch in this directory
+    inotify_rm_watch(m_fd, wd);
+    m_directories.erase(wd);
+    for(auto it = m_watchOfDirectory.begin(); it != m_watchOfDirectory.end(); )
+    {
+        if(it->second == wd)
+            it = m_watchOfDirectory.erase(it);
+        else
+            ++it;
+    }
+}
+
+void FileWatcher::readEvents()
+{
+    alignas(struct inotify_event) char buffer[4096];
+    const Clock::time_point now = Clock::now();
+
+    for(;;)
+    {
+        ssize_t n = ::read(m_fd, buffer, sizeof(buffer));
+        if(n <= 0)
+            break; // EAGAIN, no more events
+
+        for(char* p = buffer; p < buffer + n; )
+        {
+            const auto* event = reinterpret_cast<const struct inotify_event*>(p);
+            p += sizeof(struct inotify_event) + event->len;
+
+            if(event->mask & IN_Q_OVERFLOW)
+            {
+                // events were lost, assume everything changed
+                for(const auto& dir : m_directories)
+                    for(const auto& name : dir.second.files)
+                        for(const auto& file : name.second)
+                            m_changed[file.first] = now;
+                continue;
+            }
+
+            auto dirIt = m_directories.find(event->wd);
+            if(dirIt == m_directories.end())
+                continue;
+
+            if(event->mask & IN_IGNORED)
+            {
+                // the directory was removed, the kernel dropped the watch
+                for(auto it = m_watchOfDirectory.begin(); it != m_watchOfDirectory.end(); )
+                {
+                    if(it->second == event->wd)
+                        it = m_watchOfDirectory.erase(it);
+                    else
+                        ++it;
+                }
+                m_directories.erase(dirIt);
+                continue;
+            }
+
+            if(event->len == 0)
+                continue;
+            auto nameIt = dirIt->second.files.find(event->name);
+            if(nameIt == dirIt->second.files.end())
+                continue;
+            for(const auto& file : nameIt->second)
+                m_changed[file.first] = now;
+        }
+    }
+}
+
+#else
+
+FileWatcher::FileWatcher(std::chrono::milliseconds debounce)
+    : m_debounce(debounce)
+{
+}
+
+FileWatcher::~FileWatcher() = default;
+
+void FileWatcher::watch(const std::string&)
+{
+}
+
+void FileWatcher::unwatch(const std::string&)
+{
+}
+
+void FileWatcher::readEvents()
+{
+}
+
+#endif
+
+std::vector<std::string> FileWatcher::poll()
+{
+    std::vector<std::string> changed;
+    if(m_fd < 0)
+        return changed;
+
+    std::lock_guard<std::mutex> lck(m_mtx);
+    readEvents();
+
+    const Clock::time_point now = Clock::now();
+    for(auto it = m_changed.begin(); it != m_changed.end(); )
+    {
+        if(now - it->second >= m_debounce)
+        {
+            changed.push_back(it->first);
+            it = m_changed.erase(it);
+        } else
+            ++it;
+    }
+    return changed;
+}
+
+void FileWatcher::setDebounce(std::chrono::milliseconds debounce)
+{
+    std::lock_guard<std::mutex> lck(m_mtx);
+    m_debounce = debounce;
+}
+
+std::size_t FileWatcher::numWatched()
+{
+    std::lock_guard<std::mutex> lck(m_mtx);
+    std::size_t n = 0;
+    for(const auto& dir : m_directories)
+        for(const auto& name : dir.second.files)
+            n += name.second.size();
+    return n;
+}
+
+}
@@ -0,0 +1,125 @@
+/*
+ * mpUtils
+ * MappedFile.cpp
+ *
+ * @author: Hendrik Schwanekamp
+ * @mail:   hendrik.schwanekamp@gmx.net
+ *
+ * Copyright (c) 2021 Hendrik Schwanekamp
+ *
+ */
+
+// includes
+//--------------------
+#include "mpUtils/ResourceManager/MappedFile.h"
+#include "mpUtils/ResourceManager/readData.h"
+#include <cstring>
+#include <cerrno>
+#include <utility>
+#ifdef __linux__
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+//--------------------
+
+// namespace
+//--------------------
+namespace mpu {
+//--------------------
+
+// function definitions of the MappedFile class
+//-------------------------------------------------------------------
+#ifdef __linux__
+
+MappedFile::MappedFile(const std::string& path, FileAccess access, bool prefetch)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0)
+        throw std::runtime_error("Could not open file " + path + ": " + std::strerror(errno));
+
+    struct stat st{};
+    if(::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+    {
+        ::close(fd);
+        throw std::runtime_error("Passed path is not a regular file: " + path);
+    }
+
+    m_size = static_cast<std::size_t>(st.st_size);
+    if(m_size == 0)
+    {
+        // mmap does not allow empty mappings
+        ::close(fd);
+        return;
+    }
+
+    void* p = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    int err = errno;
+    ::close(fd); // the mapping keeps a reference to the file
+    if(p == MAP_FAILED)
+    {
+        m_size = 0;
+        throw std::runtime_error("Could not map file " + path + ": " + std::strerror(err));
+    }
+    m_data = static_cast<const unsigned char*>(p);
+
+    // the advice is only a hint, failing to apply it does not matter
+    if(access == FileAccess::sequential)
+        ::madvise(p, m_size, MADV_SEQUENTIAL);
+    else if(access == FileAccess::random)
+        ::madvise(p, m_size, MADV_RANDOM);
+    if(prefetch)
+        ::madvise(p, m_size, MADV_WILLNEED);
+}
+
+void MappedFile::close()
+{
+    if(m_data && m_buffer.empty())
+        ::munmap(const_cast<unsigned char*>(m_data), m_size);
+    m_data = nullptr;
+    m_size = 0;
+    m_buffer.clear();
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& path, FileAccess, bool)
+    : m_buffer(readFile(path))
+{
+    m_data = reinterpret_cast<const unsigned char*>(m_buffer.data());
+    m_size = m_buffer.size();
+}
+
+void MappedFile::close()
+{
+    m_data = nullptr;
+    m_size = 0;
+    m_buffer.clear();
+}
+
+#endif
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+{
+    *this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+    if(this != &other)
+    {
+        close();
+        // moving a short string copies its content, so the data pointer is taken from our own buffer
+        const bool buffered = !other.m_buffer.empty();
+        m_buffer = std::move(other.m_buffer);
+        m_data = buffered ? reinterpret_cast<const unsigned char*>(m_buffer.data()) : other.m_data;
+        m_size = other.m_size;
+        other.m_buffer.clear();
+        other.m_data = nullptr;
+        other.m_size = 0;
+    }
+    return *this;
+}
+
+}
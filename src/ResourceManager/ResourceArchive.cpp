@@ -0,0 +1,288 @@
+/*
+ * mpUtils
+ * ResourceArchive.cpp
+ *
+ * @author: Hendrik Schwanekamp
+ * @mail:   hendrik.schwanekamp@gmx.net
+ *
+ * Copyright (c) 2021 Hendrik Schwanekamp
+ *
+ */
+
+// includes
+//--------------------
+#include "mpUtils/ResourceManager/ResourceArchive.h"
+#include "mpUtils/ResourceManager/readData.h"
+#include "mpUtils/ResourceManager/ResourceKey.h"
+#include "mpUtils/external/stb_image.h"
+#include <algorithm>
+#include <numeric>
+#include <fstream>
+#include <cstring>
+#include <cstdlib>
+#include <limits>
+#include <stdexcept>
+#include <experimental/filesystem>
+//--------------------
+
+// stb_image_write does not declare its zlib compressor in the header, it is compiled into the library
+extern "C" unsigned char* stbi_zlib_compress(unsigned char* data, int data_len, int* out_len, int quality);
+
+// namespace
+//--------------------
+namespace mpu {
+//--------------------
+
+namespace detail {
+    std::uint64_t archivePathHash(const char* path, std::size_t length)
+    {
+        // the same hash as ResourceKey, so keys and archive entries can be matched by hash
+        return resourcePathHash(path, length);
+    }
+}
+
+// function definitions of the ResourceArchive class
+//-------------------------------------------------------------------
+ResourceArchive::ResourceArchive(const std::string& archiveFile)
+    : m_archiveFile(archiveFile), m_file(archiveFile, FileAccess::random, false)
+{
+    const std::size_t fileSize = m_file.size();
+    if(fileSize < sizeof(detail::ArchiveHeader))
+        throw std::runtime_error("File is too small to be a resource archive: " + archiveFile);
+
+    detail::ArchiveHeader header;
+    std::memcpy(&header, m_file.data(), sizeof(header));
+    if(std::memcmp(header.magic, detail::archiveMagic, sizeof(header.magic)) != 0)
+        throw std::runtime_error("File is not a resource archive: " + archiveFile);
+    if(header.version != detail::archiveVersion)
+        throw std::runtime_error("Unsupported resource archive version " + std::to_string(header.version) + " in " + archiveFile);
+
+    if(header.indexOffset % alignof(ArchiveEntry) != 0
+       || header.indexOffset > fileSize || header.entryCount > (fileSize - header.indexOffset) / sizeof(ArchiveEntry)
+       || header.stringsOffset > fileSize || header.stringsSize > fileSize - header.stringsOffset)
+        throw std::runtime_error("Resource archive is corrupted: " + archiveFile);
+
+    m_index = reinterpret_cast<const ArchiveEntry*>(m_file.data() + header.indexOffset);
+    m_numEntries = header.entryCount;
+    m_strings = reinterpret_cast<const char*>(m_file.data() + header.stringsOffset);
+
+    for(std::size_t i = 0; i < m_numEntries; ++i)
+    {
+        const ArchiveEntry& e = m_index[i];
+        if(e.offset > fileSize || e.storedSize > fileSize - e.offset
+           || static_cast<std::uint64_t>(e.pathOffset) + e.pathLength > header.stringsSize
+           || (!e.isCompressed() && e.storedSize != e.size))
+            throw std::runtime_error("Resource archive is corrupted: " + archiveFile);
+    }
+}
+
+const ArchiveEntry* ResourceArchive::find(const std::string& path) const
+{
+    const std::uint64_t hash = detail::archivePathHash(path.data(), path.size());
+    const ArchiveEntry* end = m_index + m_numEntries;
+    const ArchiveEntry* it = std::lower_bound(m_index, end, hash,
+                                              [](const ArchiveEntry& e, std::uint64_t h){ return e.hash < h; });
+
+    // entries with the same hash are next to each other
+    for(; it != end && it->hash == hash; ++it)
+    {
+        if(it->pathLength == path.size() && std::memcmp(m_strings + it->pathOffset, path.data(), path.size()) == 0)
+            return it;
+    }
+    return nullptr;
+}
+
+DataView ResourceArchive::view(const ArchiveEntry& entry) const
+{
+    return {m_file.data() + entry.offset, static_cast<std::size_t>(entry.storedSize)};
+}
+
+std::string ResourceArchive::read(const ArchiveEntry& entry) const
+{
+    DataView stored = view(entry);
+    if(!entry.isCompressed())
+        return stored.toString();
+
+    std::string data(static_cast<std::size_t>(entry.size), '\0');
+    int n = stbi_zlib_decode_buffer(&data[0], static_cast<int>(data.size()),
+                                    stored.chars(), static_cast<int>(stored.size()));
+    if(n < 0 || static_cast<std::size_t>(n) != data.size())
+        throw std::runtime_error("Could not decompress " + path(entry) + " from resource archive " + m_archiveFile);
+    return data;
+}
+
+std::string ResourceArchive::read(const std::string& path) const
+{
+    const ArchiveEntry* e = find(path);
+    if(!e)
+        throw std::runtime_error("File " + path + " is not in resource archive " + m_archiveFile);
+    return read(*e);
+}
+
+std::string ResourceArchive::path(const ArchiveEntry& entry) const
+{
+    return std::string(m_strings + entry.pathOffset, entry.pathLength);
+}
+
+// function definitions of the ResourceArchiveWriter class
+//-------------------------------------------------------------------
+ResourceArchiveWriter::ResourceArchiveWriter(std::size_t alignment)
+    : m_alignment(alignment)
+{
+    if(alignment == 0 || (alignment & (alignment - 1)) != 0 || alignment > std::numeric_limits<std::uint32_t>::max())
+        throw std::invalid_argument("Resource archive alignment needs to be a power of two.");
+}
+
+void ResourceArchiveWriter::add(std::string path, const std::string& data, ArchiveCompression compression)
+{
+    PendingEntry entry{std::move(path), std::string(), data.size(), false};
+
+    // the stb zlib functions use int sizes
+    if(compression != ArchiveCompression::none && !data.empty() && data.size() < std::numeric_limits<int>::max() / 2)
+    {
+        int compressedSize = 0;
+        unsigned char* compressed = stbi_zlib_compress(reinterpret_cast<unsigned char*>(const_cast<char*>(data.data())),
+                                                       static_cast<int>(data.size()), &compressedSize, 8);
+        if(compressed)
+        {
+            const bool worthIt = compression == ArchiveCompression::zlib
+                                 || static_cast<std::size_t>(compressedSize) < data.size() - data.size() / 10;
+            if(worthIt)
+            {
+                entry.data.assign(reinterpret_cast<const char*>(compressed), compressedSize);
+                entry.compressed = true;
+            }
+            std::free(compressed);
+        }
+    }
+
+    if(!entry.compressed)
+        entry.data = data;
+    m_entries.push_back(std::move(entry));
+}
+
+void ResourceArchiveWriter::addFile(std::string path, const std::string& file, ArchiveCompression compression)
+{
+    add(std::move(path), readFile(file), compression);
+}
+
+std::size_t ResourceArchiveWriter::addDirectory(const std::string& directory, ArchiveCompression compression,
+                                                const std::string& prefix)
+{
+    namespace fs = std::experimental::filesystem;
+    const fs::path root(directory);
+    if(!fs::is_directory(root))
+        throw std::runtime_error("Passed path is not a directory: " + directory);
+
+    // sort the files, so the archive does not depend on the order of the directory listing
+    std::vector<fs::path> files;
+    for(const auto& item : fs::recursive_directory_iterator(root))
+        if(fs::is_regular_file(item.path()))
+            files.push_back(item.path());
+    std::sort(files.begin(), files.end());
+
+    const std::string rootString = root.generic_string();
+    for(const fs::path& file : files)
+    {
+        std::string relative = file.generic_string().substr(rootString.size());
+        while(!relative.empty() && relative.front() == '/')
+            relative.erase(0, 1);
+        addFile(prefix + relative, file.string(), compression);
+    }
+    return files.size();
+}
+
+void ResourceArchiveWriter::write(const std::string& archiveFile) const
+{
+    auto alignUp = [](std::uint64_t v, std::uint64_t a){ return (v + a - 1) & ~(a - 1); };
+
+    // sort by hash and path, the reader uses a binary search
+    std::vector<std::uint64_t> hashes(m_entries.size());
+    std::vector<std::size_t> order(m_entries.size());
+    for(std::size_t i = 0; i < m_entries.size(); ++i)
+        hashes[i] = detail::archivePathHash(m_entries[i].path.data(), m_entries[i].path.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b)
+    {
+        return hashes[a] != hashes[b] ? hashes[a] < hashes[b] : m_entries[a].path < m_entries[b].path;
+    });
+    for(std::size_t i = 1; i < order.size(); ++i)
+        if(m_entries[order[i]].path == m_entries[order[i-1]].path)
+            throw std::runtime_error("Path " + m_entries[order[i]].path + " was added to the resource archive twice.");
+
+    // compute the layout
+    detail::ArchiveHeader header{};
+    std::memcpy(header.magic, detail::archiveMagic, sizeof(header.magic));
+    header.version = detail::archiveVersion;
+    header.entryCount = static_cast<std::uint32_t>(m_entries.size());
+    header.indexOffset = sizeof(detail::ArchiveHeader);
+    header.stringsOffset = header.indexOffset + m_entries.size() * sizeof(ArchiveEntry);
+    header.alignment = static_cast<std::uint32_t>(m_alignment);
+
+    std::vector<ArchiveEntry> index(m_entries.size());
+    std::string strings;
+    for(std::size_t i = 0; i < order.size(); ++i)
+    {
+        const PendingEntry& pe = m_entries[order[i]];
+        if(strings.size() + pe.path.size() > std::numeric_limits<std::uint32_t>::max())
+            throw std::runtime_error("Too many paths for one resource archive.");
+        ArchiveEntry& e = index[i];
+        e = ArchiveEntry{};
+        e.hash = hashes[order[i]];
+        e.storedSize = pe.data.size();
+        e.size = pe.size;
+        e.pathOffset = static_cast<std::uint32_t>(strings.size());
+        e.pathLength = static_cast<std::uint32_t>(pe.path.size());
+        e.flags = pe.compressed ? static_cast<std::uint32_t>(ArchiveEntry::compressed) : 0u;
+        strings += pe.path;
+    }
+    header.stringsSize = strings.size();
+
+    // data blocks follow the string table in the order of the index
+    std::uint64_t offset = alignUp(header.stringsOffset + header.stringsSize, m_alignment);
+    for(ArchiveEntry& e : index)
+    {
+        e.offset = offset;
+        offset = alignUp(offset + e.storedSize, m_alignment);
+    }
+
+    // write everything
+    std::ofstream out(archiveFile, std::ios::out | std::ios::binary | std::ios::trunc);
+    if(!out.is_open())
+        throw std::runtime_error("Could not open file " + archiveFile);
+
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(index.data()), index.size() * sizeof(ArchiveEntry));
+    out.write(strings.data(), strings.size());
+
+    std::uint64_t position = header.stringsOffset + header.stringsSize;
+    const std::string padding(m_alignment, '\0');
+    for(std::size_t i = 0; i < order.size(); ++i)
+    {
+        out.write(padding.data(), index[i].offset - position);
+        const std::string& data = m_entries[order[i]].data;
+        out.write(data.data(), data.size());
+        position = index[i].offset + data.size();
+    }
+
+    if(!out)
+        throw std::runtime_error("Error writing resource archive " + archiveFile);
+}
+
+std::size_t ResourceArchiveWriter::storedSize() const
+{
+    std::size_t s = 0;
+    for(const auto& e : m_entries)
+        s += e.data.size();
+    return s;
+}
+
+std::size_t ResourceArchiveWriter::originalSize() const
+{
+    std::size_t s = 0;
+    for(const auto& e : m_entries)
+        s += e.size;
+    return s;
+}
+
+}
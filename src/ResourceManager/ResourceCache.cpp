@@ -10,4 +10,80 @@
  */
 
 #include "mpUtils/ResourceManager/ResourceManager.h"
-thread_local bool mpu::ReloadMode::enabled(false);
\ No newline at end of file
+thread_local bool mpu::ReloadMode::enabled(false);
+thread_local const mpu::detail::ResourceDependent* mpu::ReloadMode::preloading(nullptr);
+
+// namespace
+//--------------------
+namespace mpu {
+//--------------------
+
+// function definitions of the ResourceLoadSummary struct
+//-------------------------------------------------------------------
+double ResourceLoadSummary::wallTime() const
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::duration(lastFinished - firstStarted)).count();
+}
+
+double ResourceLoadSummary::readThroughput() const
+{
+    return total.readTime > 0 ? total.bytesRead / total.readTime / 1.0e6 : 0.0;
+}
+
+double ResourceLoadSummary::throughput() const
+{
+    const double wall = wallTime();
+    return wall > 0 ? total.bytesRead / wall / 1.0e6 : 0.0;
+}
+
+void ResourceLoadSummary::add(ResourceLoadRecord record, int64_t started, int64_t finished, std::size_t slowestN)
+{
+    if(numResources == 0 || started < firstStarted)
+        firstStarted = started;
+    if(numResources == 0 || finished > lastFinished)
+        lastFinished = finished;
+    ++numResources;
+
+    total.bytesRead += record.stats.bytesRead;
+    total.readTime += record.stats.readTime;
+    total.queueTime += record.stats.queueTime;
+    total.preloadTime += record.stats.preloadTime;
+    total.loadTime += record.stats.loadTime;
+    total.residentSize += record.stats.residentSize;
+
+    const double time = record.stats.totalTime();
+    auto pos = std::find_if(slowest.begin(), slowest.end(), [time](const ResourceLoadRecord& r){ return r.stats.totalTime() < time; });
+    if(static_cast<std::size_t>(pos - slowest.begin()) >= slowestN)
+        return;
+    slowest.insert(pos, std::move(record));
+    if(slowest.size() > slowestN)
+        slowest.pop_back();
+}
+
+void ResourceLoadSummary::merge(const ResourceLoadSummary& other, std::size_t slowestN)
+{
+    if(other.numResources == 0)
+        return;
+    if(numResources == 0 || other.firstStarted < firstStarted)
+        firstStarted = other.firstStarted;
+    if(numResources == 0 || other.lastFinished > lastFinished)
+        lastFinished = other.lastFinished;
+    numResources += other.numResources;
+
+    total.bytesRead += other.total.bytesRead;
+    total.readTime += other.total.readTime;
+    total.queueTime += other.total.queueTime;
+    total.preloadTime += other.total.preloadTime;
+    total.loadTime += other.total.loadTime;
+    total.residentSize += other.total.residentSize;
+
+    slowest.insert(slowest.end(), other.slowest.begin(), other.slowest.end());
+    std::stable_sort(slowest.begin(), slowest.end(), [](const ResourceLoadRecord& a, const ResourceLoadRecord& b)
+    {
+        return a.stats.totalTime() > b.stats.totalTime();
+    });
+    if(slowest.size() > slowestN)
+        slowest.resize(slowestN);
+}
+
+}
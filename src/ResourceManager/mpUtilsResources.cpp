@@ -28,6 +28,16 @@ std::unique_ptr<Image8> preloadImage(std::string data)
     return std::make_unique<Image8>(reinterpret_cast<const unsigned char*>(data.data()), data.size());
 }
 
+std::unique_ptr<Image8> preloadImageView(DataView data)
+{
+    return std::make_unique<Image8>(data.data(), data.size());
+}
+
+std::unique_ptr<Image8> preloadImageCached(DecodedImageCache& cache, DataView data)
+{
+    return cache.load<Image8::InternalType>(data);
+}
+
 std::unique_ptr<Image8> finalLoadImage(std::unique_ptr<Image8> img)
 {
     return img;
@@ -43,6 +53,16 @@ std::unique_ptr<Image16> preloadImage16(std::string data)
     return std::make_unique<Image16>(reinterpret_cast<const unsigned char*>(data.data()), data.size());
 }
 
+std::unique_ptr<Image16> preloadImage16View(DataView data)
+{
+    return std::make_unique<Image16>(data.data(), data.size());
+}
+
+std::unique_ptr<Image16> preloadImage16Cached(DecodedImageCache& cache, DataView data)
+{
+    return cache.load<Image16::InternalType>(data);
+}
+
 std::unique_ptr<Image16> finalLoadImage16(std::unique_ptr<Image16> img)
 {
     return img;
@@ -58,6 +78,16 @@ std::unique_ptr<Image32> preloadImage32(std::string data)
     return std::make_unique<Image32>(reinterpret_cast<const unsigned char*>(data.data()), data.size());
 }
 
+std::unique_ptr<Image32> preloadImage32View(DataView data)
+{
+    return std::make_unique<Image32>(data.data(), data.size());
+}
+
+std::unique_ptr<Image32> preloadImage32Cached(DecodedImageCache& cache, DataView data)
+{
+    return cache.load<Image32::InternalType>(data);
+}
+
 std::unique_ptr<Image32> finalLoadImage32(std::unique_ptr<Image32> img)
 {
     return img;
@@ -0,0 +1,140 @@
+/*
+ * mpUtils
+ * JobSystem.cpp
+ *
+ * @author: Hendrik Schwanekamp
+ * @mail:   hendrik.schwanekamp@gmx.net
+ *
+ * Implements the JobSystem class
+ *
+ * Copyright (c) 2021 Hendrik Schwanekamp
+ *
+ */
+
+// includes
+//--------------------
+#include "mpUtils/Threading/JobSystem.h"
+#include "mpUtils/Log/Log.h"
+//--------------------
+
+// namespace
+//--------------------
+namespace mpu {
+//--------------------
+
+// function definitions of the JobSystem class
+//-------------------------------------------------------------------
+JobSystem::JobSystem(std::size_t numThreads, std::size_t queueCapacity)
+    : m_queue(queueCapacity)
+{
+    for(std::size_t i = 0; i < numThreads; ++i)
+        m_workers.emplace_back([this](){ workerLoop(); });
+}
+
+JobSystem::~JobSystem()
+{
+    if(m_detachFromWindow)
+        m_detachFromWindow();
+
+    waitFor(m_frameCounter);
+    m_stop.store(true);
+    m_jobsAvailable.release(static_cast<uint32_t>(m_workers.size()));
+    for(auto& w : m_workers)
+        w.join();
+}
+
+void JobSystem::push(UniqueTask&& task, JobCounter* counter)
+{
+    if(counter)
+        counter->add(1);
+    m_frameCounter.add(1);
+
+    Job job{std::move(task), counter};
+    if(!m_queue.tryPush(std::move(job)))
+    {
+        // the queue is full, so there is plenty of work for the workers and we just run the job ourselves
+        execute(job);
+    }
+}
+
+void JobSystem::submit(UniqueTask&& task, JobCounter* counter)
+{
+    push(std::move(task), counter);
+    m_jobsAvailable.release();
+}
+
+void JobSystem::execute(Job& job)
+{
+    try
+    {
+        job.task();
+    } catch(const std::exception& e)
+    {
+        logERROR("JobSystem") << "Exception in job: " << e.what();
+    } catch(...)
+    {
+        logERROR("JobSystem") << "Unknown exception in job.";
+    }
+
+    // release resources held by the job before anyone is notified
+    job.task.reset();
+    if(job.counter)
+        job.counter->decrement();
+    m_frameCounter.decrement();
+}
+
+bool JobSystem::runOne()
+{
+    Job job;
+    if(!m_queue.tryPop(job))
+        return false;
+    execute(job);
+    return true;
+}
+
+void JobSystem::workerLoop()
+{
+    for(;;)
+    {
+        m_jobsAvailable.acquire();
+        if(m_stop.load())
+            return;
+        while(runOne()) {}
+    }
+}
+
+void JobSystem::waitFor(const JobCounter& counter)
+{
+    int idleRounds = 0;
+    while(!counter.isDone())
+    {
+        if(runOne())
+        {
+            idleRounds = 0;
+            continue;
+        }
+
+        // the remaining jobs are running on other threads, they might still submit more jobs that we could help with
+        if(++idleRounds < 64)
+            concurrent::cpuRelax();
+        else
+        {
+            uint32_t value = counter.m_value.load(std::memory_order_acquire);
+            if(value != 0)
+                concurrent::futexWait(const_cast<std::atomic<uint32_t>*>(&counter.m_value), value);
+        }
+    }
+}
+
+void JobSystem::beginFrame()
+{
+    assert_critical(!m_frameRunning.exchange(true), "JobSystem", "beginFrame() called twice without endFrame().");
+}
+
+void JobSystem::endFrame()
+{
+    waitFor(m_frameCounter);
+    m_frameRunning.store(false);
+}
+
+}
@@ -0,0 +1,112 @@
+/*
+ * mpUtils
+ * Pipeline.cpp
+ *
+ * @author: Hendrik Schwanekamp
+ * @mail:   hendrik.schwanekamp@gmx.net
+ *
+ * Implements the helper classes of the Pipeline class
+ *
+ * Copyright (c) 2021 Hendrik Schwanekamp
+ *
+ */
+
+// includes
+//--------------------
+#include "mpUtils/Threading/Pipeline.h"
+//--------------------
+
+// namespace
+//--------------------
+namespace mpu {
+namespace detail {
+//--------------------
+
+// function definitions of the PipelineOrderGate class
+//-------------------------------------------------------------------
+bool PipelineOrderGate::waitForTurn(uint64_t sequence)
+{
+    std::unique_lock<std::mutex> lck(m_mtx);
+    m_cv.wait(lck, [&]{ return m_next == sequence || m_cancelled; });
+    return !m_cancelled;
+}
+
+void PipelineOrderGate::done()
+{
+    std::lock_guard<std::mutex> lck(m_mtx);
+    ++m_next;
+    m_cv.notify_all();
+}
+
+void PipelineOrderGate::cancel()
+{
+    std::lock_guard<std::mutex> lck(m_mtx);
+    m_cancelled = true;
+    m_cv.notify_all();
+}
+
+// function definitions of the PipelineState class
+//-------------------------------------------------------------------
+PipelineState::~PipelineState()
+{
+    cancel();
+    join();
+}
+
+void PipelineState::fail(std::exception_ptr e)
+{
+    {
+        std::lock_guard<std::mutex> lck(m_mtx);
+        if(!m_exception)
+            m_exception = e;
+    }
+    cancel();
+}
+
+void PipelineState::cancel()
+{
+    std::lock_guard<std::mutex> lck(m_mtx);
+    m_cancelled = true;
+    for(auto& c : m_channels)
+        c->cancel();
+    for(auto& g : m_gates)
+        g->cancel();
+}
+
+void PipelineState::addChannel(std::shared_ptr<PipelineChannelBase> channel)
+{
+    std::lock_guard<std::mutex> lck(m_mtx);
+    if(m_cancelled)
+        channel->cancel(); // a stage added after a failure stops right away
+    m_channels.push_back(std::move(channel));
+}
+
+void PipelineState::addGate(std::shared_ptr<PipelineOrderGate> gate)
+{
+    std::lock_guard<std::mutex> lck(m_mtx);
+    if(m_cancelled)
+        gate->cancel();
+    m_gates.push_back(std::move(gate));
+}
+
+std::shared_ptr<PipelineChannelBase> PipelineState::lastChannel()
+{
+    std::lock_guard<std::mutex> lck(m_mtx);
+    return m_channels.back();
+}
+
+void PipelineState::join()
+{
+    for(auto& t : threads)
+        if(t.joinable())
+            t.join();
+}
+
+void PipelineState::rethrow()
+{
+    std::lock_guard<std::mutex> lck(m_mtx);
+    if(m_exception)
+        std::rethrow_exception(m_exception);
+}
+
+}}
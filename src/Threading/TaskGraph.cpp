@@ -0,0 +1,196 @@
+/*
+ * mpUtils
+ * TaskGraph.cpp
+ *
+ * @author: Hendrik Schwanekamp
+ * @mail:   hendrik.schwanekamp@gmx.net
+ *
+ * Implements the TaskGraph class
+ *
+ * Copyright (c) 2021 Hendrik Schwanekamp
+ *
+ */
+
+// includes
+//--------------------
+#include "mpUtils/Threading/TaskGraph.h"
+#include "mpUtils/Log/Log.h"
+//--------------------
+
+// namespace
+//--------------------
+namespace mpu {
+//--------------------
+
+// function definitions of the TaskGraph class
+//-------------------------------------------------------------------
+TaskGraph::~TaskGraph()
+{
+    std::unique_lock<std::mutex> lck(m_mtx);
+    m_cv.wait(lck, [this]{ return !m_running; });
+}
+
+TaskGraph::TaskId TaskGraph::addTask(std::function<void()> task, std::string name)
+{
+    assert_critical(!isRunning(), "TaskGraph", "Task graph can not be modified while it is running.");
+    m_nodes.emplace_back();
+    m_nodes.back().work = std::move(task);
+    m_nodes.back().name = std::move(name);
+    return m_nodes.size()-1;
+}
+
+void TaskGraph::addDependency(TaskId before, TaskId after)
+{
+    assert_critical(!isRunning(), "TaskGraph", "Task graph can not be modified while it is running.");
+    assert_critical(before < m_nodes.size() && after < m_nodes.size(), "TaskGraph", "Invalid task id.");
+    m_nodes[before].successors.push_back(after);
+    m_nodes[after].numPredecessors++;
+    m_checked = false;
+}
+
+void TaskGraph::clear()
+{
+    assert_critical(!isRunning(), "TaskGraph", "Task graph can not be modified while it is running.");
+    m_nodes.clear();
+    m_checked = true;
+}
+
+void TaskGraph::setOnFinished(std::function<void()> callback)
+{
+    assert_critical(!isRunning(), "TaskGraph", "Task graph can not be modified while it is running.");
+    m_onFinished = std::move(callback);
+}
+
+void TaskGraph::execute(ThreadPool& pool)
+{
+    if(!m_checked)
+        checkForCycles();
+
+    {
+        std::lock_guard<std::mutex> lck(m_mtx);
+        assert_critical(!m_running, "TaskGraph", "Task graph is already running.");
+        if(!m_nodes.empty())
+            m_running = true;
+    }
+
+    // an empty graph is finished right away, the callback still needs to run, eg to schedule the next frame
+    if(m_nodes.empty())
+    {
+        if(m_onFinished)
+            m_onFinished();
+        return;
+    }
+
+    m_pool = &pool;
+    m_failed = false;
+    m_exception = nullptr;
+    m_remaining = m_nodes.size();
+    for(auto& node : m_nodes)
+        node.pendingPredecessors = node.numPredecessors;
+
+    for(TaskId id = 0; id < m_nodes.size(); ++id)
+        if(m_nodes[id].numPredecessors == 0)
+            pool.post([this, id](){ runFrom(id); });
+}
+
+void TaskGraph::wait()
+{
+    std::unique_lock<std::mutex> lck(m_mtx);
+    m_cv.wait(lck, [this]{ return !m_running; });
+    if(m_exception)
+    {
+        auto e = m_exception;
+        m_exception = nullptr;
+        std::rethrow_exception(e);
+    }
+}
+
+bool TaskGraph::isRunning()
+{
+    std::lock_guard<std::mutex> lck(m_mtx);
+    return m_running;
+}
+
+void TaskGraph::runFrom(TaskId id)
+{
+    while(true)
+    {
+        Node& node = m_nodes[id];
+        if(!m_failed.load(std::memory_order_relaxed))
+        {
+            try
+            {
+                node.work();
+            } catch(...)
+            {
+                std::lock_guard<std::mutex> lck(m_mtx);
+                if(!m_exception)
+                    m_exception = std::current_exception();
+                m_failed = true;
+            }
+        }
+
+        // continue with the first successor that became ready, post all others
+        bool hasNext = false;
+        TaskId next = 0;
+        for(TaskId s : node.successors)
+        {
+            if(m_nodes[s].pendingPredecessors.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            {
+                if(!hasNext)
+                {
+                    next = s;
+                    hasNext = true;
+                } else
+                    m_pool->post([this, s](){ runFrom(s); });
+            }
+        }
+
+        if(m_remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            // last task, after notifying the graph might be destroyed by a waiting thread
+            std::function<void()> onFinished = m_onFinished;
+            {
+                std::lock_guard<std::mutex> lck(m_mtx);
+                m_running = false;
+                m_cv.notify_all();
+            }
+            if(onFinished)
+                onFinished();
+            return;
+        }
+
+        if(!hasNext)
+            return;
+        id = next;
+    }
+}
+
+void TaskGraph::checkForCycles()
+{
+    // kahns algorithm, if not all nodes can be visited in topological order there is a cycle
+    std::vector<unsigned int> inDegree(m_nodes.size());
+    std::vector<TaskId> ready;
+    for(TaskId id = 0; id < m_nodes.size(); ++id)
+    {
+        inDegree[id] = m_nodes[id].numPredecessors;
+        if(inDegree[id] == 0)
+            ready.push_back(id);
+    }
+
+    std::size_t visited = 0;
+    while(!ready.empty())
+    {
+        TaskId id = ready.back();
+        ready.pop_back();
+        visited++;
+        for(TaskId s : m_nodes[id].successors)
+            if(--inDegree[s] == 0)
+                ready.push_back(s);
+    }
+
+    assert_critical(visited == m_nodes.size(), "TaskGraph", "Task graph contains a cycle.");
+    m_checked = true;
+}
+
+}
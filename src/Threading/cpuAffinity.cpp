@@ -0,0 +1,184 @@
+/*
+ * mpUtils
+ * cpuAffinity.cpp
+ *
+ * @author: Hendrik Schwanekamp
+ * @mail:   hendrik.schwanekamp@gmx.net
+ *
+ * Copyright (c) 2021 Hendrik Schwanekamp
+ *
+ */
+
+// includes
+//--------------------
+#include "mpUtils/Threading/cpuAffinity.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#ifdef __linux__
+    #include <pthread.h>
+    #include <sched.h>
+    #include <unistd.h>
+#endif
+//--------------------
+
+// namespace
+//--------------------
+namespace mpu {
+//--------------------
+
+namespace {
+
+    /**
+     * @brief parses a linux cpu list like "0-3,8,10-11"
+     */
+    std::vector<int> parseCpuList(const std::string& list)
+    {
+        std::vector<int> cpus;
+        std::stringstream ss(list);
+        std::string range;
+        while(std::getline(ss, range, ','))
+        {
+            if(range.empty() || range == "\n")
+                continue;
+            std::size_t dash = range.find('-');
+            int first = std::stoi(range.substr(0, dash));
+            int last = (dash == std::string::npos) ? first : std::stoi(range.substr(dash+1));
+            for(int c = first; c <= last; ++c)
+                cpus.push_back(c);
+        }
+        return cpus;
+    }
+
+    /**
+     * @brief the cpus of every numa node, read once from sysfs
+     */
+    const std::vector<std::vector<int>>& numaTopology()
+    {
+        static const std::vector<std::vector<int>> topology = []()
+        {
+            std::vector<std::vector<int>> nodes;
+#ifdef __linux__
+            for(int node = 0; ; ++node)
+            {
+                std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+                if(!file.is_open())
+                    break;
+                std::string list;
+                std::getline(file, list);
+                nodes.push_back(parseCpuList(list));
+            }
+#endif
+            return nodes;
+        }();
+        return topology;
+    }
+
+#ifdef __linux__
+    bool setAffinity(pthread_t thread, const std::vector<int>& cores)
+    {
+        const std::vector<int>& allowed = cores.empty() ? availableCores() : cores;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for(int c : allowed)
+            if(c >= 0 && c < CPU_SETSIZE)
+                CPU_SET(c, &set);
+        return pthread_setaffinity_np(thread, sizeof(set), &set) == 0;
+    }
+#endif
+}
+
+std::vector<int> availableCores()
+{
+    std::vector<int> cores;
+#ifdef __linux__
+    // use the mask of the main thread, so the result does not depend on the affinity of the calling thread
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if(sched_getaffinity(getpid(), sizeof(set), &set) == 0)
+    {
+        for(int c = 0; c < CPU_SETSIZE; ++c)
+            if(CPU_ISSET(c, &set))
+                cores.push_back(c);
+        return cores;
+    }
+#endif
+    for(int c = 0; c < static_cast<int>(std::max(1u, std::thread::hardware_concurrency())); ++c)
+        cores.push_back(c);
+    return cores;
+}
+
+int numNumaNodes()
+{
+    return std::max(1, static_cast<int>(numaTopology().size()));
+}
+
+std::vector<int> coresOfNumaNode(int node)
+{
+    std::vector<int> cores = availableCores();
+    if(numaTopology().empty())
+        return (node == 0) ? cores : std::vector<int>();
+
+    cores.erase(std::remove_if(cores.begin(), cores.end(), [node](int c){ return numaNodeOfCore(c) != node; }),
+                cores.end());
+    return cores;
+}
+
+int numaNodeOfCore(int core)
+{
+    const auto& topology = numaTopology();
+    for(std::size_t node = 0; node < topology.size(); ++node)
+        if(std::find(topology[node].begin(), topology[node].end(), core) != topology[node].end())
+            return static_cast<int>(node);
+    return 0;
+}
+
+std::vector<int> orderCores(AffinityPolicy policy, std::vector<int> cores)
+{
+    if(policy == AffinityPolicy::none)
+        return cores;
+
+    std::stable_sort(cores.begin(), cores.end(), [](int a, int b)
+    {
+        int na = numaNodeOfCore(a);
+        int nb = numaNodeOfCore(b);
+        return (na != nb) ? na < nb : a < b;
+    });
+
+    if(policy == AffinityPolicy::compact)
+        return cores;
+
+    // scatter, take one core of each node in turn
+    std::vector<std::vector<int>> perNode(numNumaNodes());
+    for(int c : cores)
+        perNode[numaNodeOfCore(c)].push_back(c);
+
+    std::vector<int> result;
+    result.reserve(cores.size());
+    for(std::size_t i = 0; result.size() < cores.size(); ++i)
+        for(const auto& node : perNode)
+            if(i < node.size())
+                result.push_back(node[i]);
+    return result;
+}
+
+bool setThreadAffinity(std::thread& thread, const std::vector<int>& cores)
+{
+#ifdef __linux__
+    return setAffinity(thread.native_handle(), cores);
+#else
+    return false;
+#endif
+}
+
+bool setCurrentThreadAffinity(const std::vector<int>& cores)
+{
+#ifdef __linux__
+    return setAffinity(pthread_self(), cores);
+#else
+    return false;
+#endif
+}
+
+}
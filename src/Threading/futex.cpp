@@ -0,0 +1,87 @@
+/*
+ * mpUtils
+ * futex.cpp
+ *
+ * @author: Hendrik Schwanekamp
+ * @mail:   hendrik.schwanekamp@gmx.net
+ *
+ * Copyright (c) 2021 Hendrik Schwanekamp
+ *
+ */
+
+// includes
+//--------------------
+#include "mpUtils/Threading/concurrent/futex.h"
+#include <climits>
+#ifdef __linux__
+    #include <linux/futex.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#else
+    #include <mutex>
+    #include <condition_variable>
+    #include <functional>
+#endif
+//--------------------
+
+// namespace
+//--------------------
+namespace mpu {
+namespace concurrent {
+//--------------------
+
+#ifdef __linux__
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex needs a plain 32 bit atomic");
+
+void futexWait(std::atomic<uint32_t>* address, uint32_t expected)
+{
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(address), FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+}
+
+void futexWake(std::atomic<uint32_t>* address, int count)
+{
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(address), FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+}
+
+#else
+
+namespace {
+
+    struct WaitBucket
+    {
+        std::mutex mtx;
+        std::condition_variable cv;
+    };
+
+    WaitBucket& bucketFor(const void* address)
+    {
+        static WaitBucket buckets[64];
+        return buckets[std::hash<const void*>()(address) % 64];
+    }
+}
+
+void futexWait(std::atomic<uint32_t>* address, uint32_t expected)
+{
+    WaitBucket& b = bucketFor(address);
+    std::unique_lock<std::mutex> lck(b.mtx);
+    if(address->load() == expected)
+        b.cv.wait(lck);
+}
+
+void futexWake(std::atomic<uint32_t>* address, int count)
+{
+    // threads waiting on different addresses might share the bucket, so we need to wake all of them
+    WaitBucket& b = bucketFor(address);
+    { std::lock_guard<std::mutex> lck(b.mtx); }
+    b.cv.notify_all();
+}
+
+#endif
+
+void futexWakeAll(std::atomic<uint32_t>* address)
+{
+    futexWake(address, INT_MAX);
+}
+
+}}
@@ -0,0 +1,28 @@
+/*
+ * mpUtils
+ * globalThreadPool.cpp
+ *
+ * @author: Hendrik Schwanekamp
+ * @mail:   hendrik.schwanekamp@gmx.net
+ *
+ * Copyright (c) 2021 Hendrik Schwanekamp
+ *
+ */
+
+// includes
+//--------------------
+#include "mpUtils/Threading/globalThreadPool.h"
+//--------------------
+
+// namespace
+//--------------------
+namespace mpu {
+//--------------------
+
+ThreadPool& globalThreadPool()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+}
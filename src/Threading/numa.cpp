@@ -0,0 +1,42 @@
+/*
+ * mpUtils
+ * numa.cpp
+ *
+ * @author: Hendrik Schwanekamp
+ * @mail:   hendrik.schwanekamp@gmx.net
+ *
+ * Copyright (c) 2021 Hendrik Schwanekamp
+ *
+ */
+
+// includes
+//--------------------
+#include "mpUtils/Threading/numa.h"
+//--------------------
+
+// namespace
+//--------------------
+namespace mpu {
+//--------------------
+
+std::vector<std::unique_ptr<ThreadPool>> makeNumaThreadPools(std::size_t threadsPerNode)
+{
+    std::vector<std::unique_ptr<ThreadPool>> pools;
+    for(int node = 0; node < numNumaNodes(); ++node)
+    {
+        std::vector<int> cores = coresOfNumaNode(node);
+        if(cores.empty())
+        {
+            // keep indices aligned with node numbers, even if we are not allowed to run on this node
+            pools.push_back(nullptr);
+            continue;
+        }
+
+        std::size_t threads = (threadsPerNode > 0) ? threadsPerNode : cores.size();
+        pools.push_back(std::make_unique<ThreadPool>(threads));
+        pools.back()->setAffinity(AffinityPolicy::compact, cores);
+    }
+    return pools;
+}
+
+}
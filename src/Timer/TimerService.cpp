@@ -0,0 +1,168 @@
+/*
+ * mpUtils
+ * TimerService.cpp
+ *
+ * @author: Hendrik Schwanekamp
+ * @mail:   hendrik.schwanekamp@gmx.net
+ *
+ * Implements the TimerService class
+ *
+ * Copyright (c) 2021 Hendrik Schwanekamp
+ *
+ */
+
+// includes
+//--------------------
+#include "mpUtils/Timer/TimerService.h"
+#include <algorithm>
+#include <functional>
+//--------------------
+
+// namespace
+//--------------------
+namespace mpu {
+//--------------------
+
+// function definitions of the TimerService class
+//-------------------------------------------------------------------
+constexpr TimerService::TimerId TimerService::invalidId;
+
+TimerService::TimerService(ThreadPool& pool)
+    : m_defaultPool(pool)
+{
+    m_thread = std::thread(&TimerService::run, this);
+}
+
+TimerService::~TimerService()
+{
+    {
+        std::lock_guard<std::mutex> lck(m_mtx);
+        m_stop = true;
+        m_cv.notify_one();
+    }
+    m_thread.join();
+}
+
+TimerService::TimerId TimerService::schedule(clock::time_point deadline, UniqueTask f, ThreadPool* pool)
+{
+    std::lock_guard<std::mutex> lck(m_mtx);
+
+    uint32_t slot;
+    if(m_freeSlots.empty())
+    {
+        slot = static_cast<uint32_t>(m_slots.size());
+        m_slots.emplace_back();
+    } else
+    {
+        slot = m_freeSlots.back();
+        m_freeSlots.pop_back();
+    }
+
+    m_slots[slot].task = std::move(f);
+    m_slots[slot].pool = pool ? pool : &m_defaultPool;
+    const uint32_t generation = m_slots[slot].generation;
+
+    // only wake the timer thread if the new timer is the next one to expire
+    if(m_heap.empty() || deadline < m_heap.front().deadline)
+        m_cv.notify_one();
+    m_heap.push_back(HeapEntry{deadline, slot, generation});
+    std::push_heap(m_heap.begin(), m_heap.end(), std::greater<HeapEntry>());
+
+    return (static_cast<TimerId>(generation) << 32) | slot;
+}
+
+bool TimerService::cancel(TimerId id)
+{
+    const auto slot = static_cast<uint32_t>(id & 0xffffffff);
+    const auto generation = static_cast<uint32_t>(id >> 32);
+
+    UniqueTask task; // destroy the task after unlocking
+    std::lock_guard<std::mutex> lck(m_mtx);
+    if(slot >= m_slots.size() || m_slots[slot].generation != generation)
+        return false;
+
+    task = std::move(m_slots[slot].task);
+    freeSlot(slot);
+
+    // the heap entry is skipped when it reaches the top, clean up if too many of them accumulate
+    m_numCancelled++;
+    if(m_numCancelled > 64 && m_numCancelled > m_heap.size() / 2)
+        removeCancelled();
+    return true;
+}
+
+std::size_t TimerService::numPending()
+{
+    std::lock_guard<std::mutex> lck(m_mtx);
+    return m_heap.size() - m_numCancelled;
+}
+
+void TimerService::freeSlot(uint32_t slot)
+{
+    m_slots[slot].pool = nullptr;
+    if(++m_slots[slot].generation == 0) // 0 would allow the invalid id
+        m_slots[slot].generation = 1;
+    m_freeSlots.push_back(slot);
+}
+
+void TimerService::removeCancelled()
+{
+    m_heap.erase(std::remove_if(m_heap.begin(), m_heap.end(), [this](const HeapEntry& e)
+                               { return m_slots[e.slot].generation != e.generation; }), m_heap.end());
+    std::make_heap(m_heap.begin(), m_heap.end(), std::greater<HeapEntry>());
+    m_numCancelled = 0;
+}
+
+void TimerService::run()
+{
+    std::unique_lock<std::mutex> lck(m_mtx);
+    while(!m_stop)
+    {
+        if(m_heap.empty())
+        {
+            m_cv.wait(lck);
+            continue;
+        }
+
+        const HeapEntry top = m_heap.front();
+        if(m_slots[top.slot].generation != top.generation)
+        {
+            // cancelled
+            std::pop_heap(m_heap.begin(), m_heap.end(), std::greater<HeapEntry>());
+            m_heap.pop_back();
+            m_numCancelled--;
+            continue;
+        }
+
+        if(top.deadline > clock::now())
+        {
+            m_cv.wait_until(lck, top.deadline);
+            continue;
+        }
+
+        std::pop_heap(m_heap.begin(), m_heap.end(), std::greater<HeapEntry>());
+        m_heap.pop_back();
+        UniqueTask task = std::move(m_slots[top.slot].task);
+        ThreadPool* pool = m_slots[top.slot].pool;
+        freeSlot(top.slot);
+
+        lck.unlock();
+        try
+        {
+            pool->post(std::move(task));
+        } catch(const std::exception& e)
+        {
+            logERROR("TimerService") << "Could not dispatch timer: " << e.what();
+        }
+        lck.lock();
+    }
+}
+
+TimerService& globalTimerService()
+{
+    // the pool is created first, so it is destroyed after the service
+    static TimerService service(globalThreadPool());
+    return service;
+}
+
+}